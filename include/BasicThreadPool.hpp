@@ -0,0 +1,321 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The BasicThreadPool class.
+ * A thread pool whose queue, wait strategy, tasks, and statistics are chosen at compile time, so the worker loop has no virtual calls and the compiler can inline queue operations and tasks into it.
+ * A pool only pays for the features selected by its policies.
+ */
+#pragma once
+
+#include "ThreadSafeMutexQueue.hpp"
+#include "ThreadSafeSpinLockQueue.hpp"
+#include "ThreadSafeLockFreeQueue.hpp"
+#include "ThreadPoolInterface.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace arcana::virgil {
+
+  /*
+   * Queue policies: the queue of the tasks.
+   */
+  struct MutexQueuePolicy {
+    template <typename T>
+    using Queue = ThreadSafeMutexQueue<T>;
+  };
+
+  struct SpinLockQueuePolicy {
+    template <typename T>
+    using Queue = ThreadSafeSpinLockQueue<T>;
+  };
+
+  struct LockFreeQueuePolicy {
+    template <typename T>
+    using Queue = ThreadSafeLockFreeQueue<T>;
+  };
+
+  /*
+   * Wait policies: what an idle worker does until a task arrives.
+   * @keepWaiting returns false when the worker must stop waiting (e.g., the pool is being destroyed or paused).
+   */
+  struct BlockingWait {
+
+    /*
+     * Sleep in the queue (after the spinning the queue does by itself).
+     */
+    template <typename Queue, typename T, typename KeepWaiting>
+    static bool pop (Queue &queue, T &out, KeepWaiting keepWaiting){
+      return queue.waitPop(out);
+    }
+  };
+
+  struct SpinningWait {
+
+    /*
+     * Poll the queue, which gives the lowest latency but keeps a core busy per idle worker.
+     */
+    template <typename Queue, typename T, typename KeepWaiting>
+    static bool pop (Queue &queue, T &out, KeepWaiting keepWaiting){
+      while (!queue.tryPop(out)){
+        if (!keepWaiting()){
+          return false;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#else
+        std::this_thread::yield();
+#endif
+      }
+
+      return true;
+    }
+  };
+
+  struct YieldingWait {
+
+    /*
+     * Poll the queue, and yield the core to other threads between attempts.
+     */
+    template <typename Queue, typename T, typename KeepWaiting>
+    static bool pop (Queue &queue, T &out, KeepWaiting keepWaiting){
+      while (!queue.tryPop(out)){
+        if (!keepWaiting()){
+          return false;
+        }
+        std::this_thread::yield();
+      }
+
+      return true;
+    }
+  };
+
+  /*
+   * Task policies: what the queue holds and how a worker runs it.
+   * Tasks are stored by value, so submitting them does not allocate unless the task does.
+   */
+  struct CFunctionTasks {
+    struct Task {
+      void (*function) (void *args) = nullptr;
+      void *args = nullptr;
+    };
+
+    static void run (Task &task){
+      (*task.function)(task.args);
+    }
+
+    static TaskProfilingKey profilingKey (const Task &task){
+      return TaskProfilingKey::of(task.function);
+    }
+  };
+
+  /*
+   * Tasks of type @Callable, which must be default constructible (e.g., std::function or a function object).
+   * With a function object, the call of the task is inlined into the worker loop.
+   */
+  template <typename Callable = std::function<void (void)>>
+  struct CallableTasks {
+    using Task = Callable;
+
+    static void run (Task &task){
+      task();
+    }
+
+    static TaskProfilingKey profilingKey (const Task &task){
+      return TaskProfilingKey::of(task);
+    }
+  };
+
+  /*
+   * Statistics policies.
+   * NoStatistics compiles out every counter, even if VIRGIL_STATISTICS, VIRGIL_LATENCY_HISTOGRAMS, VIRGIL_PERFORMANCE_COUNTERS, or VIRGIL_TRACING are defined.
+   * PoolStatistics collects what these macros enable, and returns it through stats(), latencies(), and performanceCounters(); tasks are not timestamped, so the time they wait in the queue is not measured.
+   */
+  struct NoStatistics {
+    static constexpr bool enabled = false;
+  };
+
+  struct PoolStatistics {
+    static constexpr bool enabled = true;
+  };
+
+  /*
+   * Thread pool.
+   */
+  template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy = NoStatistics>
+  class BasicThreadPool final : public ThreadPoolInterface {
+    public:
+      using Task = typename TaskPolicy::Task;
+
+      /*
+       * Default constructor.
+       *
+       * By default, the thread pool is not extendible and it creates at least one thread.
+       */
+      BasicThreadPool (void);
+
+      /*
+       * Constructor.
+       */
+      explicit BasicThreadPool (
+        const bool extendible,
+        const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(),
+        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr,
+        const WorkerConfiguration &configuration = WorkerConfiguration{}
+        );
+
+      /*
+       * Submit the task built from @args (e.g., a function and its arguments for CFunctionTasks) and detach it from the caller.
+       */
+      template <typename... Args>
+      void submitAndDetach (Args&&... args);
+
+      /*
+       * Return the number of tasks that did not start executing yet.
+       */
+      std::uint64_t numberOfTasksWaitingToBeProcessed (void) const override ;
+
+      /*
+       * Destructor.
+       */
+      ~BasicThreadPool (void);
+
+      /*
+       * Non-copyable.
+       */
+      BasicThreadPool (const BasicThreadPool& rhs) = delete;
+
+      /*
+       * Non-assignable.
+       */
+      BasicThreadPool& operator= (const BasicThreadPool& rhs) = delete;
+
+    private:
+      typename QueuePolicy::template Queue<Task> queue;
+
+      void workerFunction (std::atomic_bool *availability, std::uint32_t thread) override ;
+  };
+
+  /*
+   * Common configurations.
+   */
+  using FastThreadPoolForC = BasicThreadPool<LockFreeQueuePolicy, BlockingWait, CFunctionTasks, NoStatistics>;
+  using SpinningThreadPoolForC = BasicThreadPool<LockFreeQueuePolicy, SpinningWait, CFunctionTasks, NoStatistics>;
+  using FastThreadPool = BasicThreadPool<MutexQueuePolicy, BlockingWait, CallableTasks<>, NoStatistics>;
+
+}
+
+template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy>
+arcana::virgil::BasicThreadPool<QueuePolicy, WaitPolicy, TaskPolicy, StatsPolicy>::BasicThreadPool (void)
+  : BasicThreadPool{false}
+  {
+  return ;
+}
+
+template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy>
+arcana::virgil::BasicThreadPool<QueuePolicy, WaitPolicy, TaskPolicy, StatsPolicy>::BasicThreadPool (
+  const bool extendible,
+  const std::uint32_t numThreads,
+  std::function <void (void)> codeToExecuteAtDeconstructor,
+  const WorkerConfiguration &configuration)
+  :
+    ThreadPoolInterface{extendible, numThreads, codeToExecuteAtDeconstructor, configuration}
+  , queue{}
+  {
+
+  /*
+   * Start threads.
+   */
+  this->startThreads(numThreads);
+
+  return ;
+}
+
+template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy>
+template <typename... Args>
+void arcana::virgil::BasicThreadPool<QueuePolicy, WaitPolicy, TaskPolicy, StatsPolicy>::submitAndDetach (Args&&... args){
+
+  /*
+   * Submit the task.
+   */
+  this->queue.push(Task{std::forward<Args>(args)...});
+
+  /*
+   * Expand the pool if possible and necessary.
+   */
+  this->expandPool();
+
+  return ;
+}
+
+template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy>
+std::uint64_t arcana::virgil::BasicThreadPool<QueuePolicy, WaitPolicy, TaskPolicy, StatsPolicy>::numberOfTasksWaitingToBeProcessed (void) const {
+  return this->queue.size();
+}
+
+template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy>
+void arcana::virgil::BasicThreadPool<QueuePolicy, WaitPolicy, TaskPolicy, StatsPolicy>::workerFunction (std::atomic_bool *availability, std::uint32_t thread) {
+  auto keepWaiting = [this](void){
+    return !this->m_done.load(std::memory_order_relaxed) && !this->isPaused();
+  };
+
+  while (!this->m_done){
+    this->workerMayPause();
+    (*availability) = true;
+    Task task;
+    if constexpr (StatsPolicy::enabled){
+      this->workerWillWait();
+    }
+    if (WaitPolicy::pop(this->queue, task, keepWaiting)){
+      this->workerDidTakeTask(availability);
+      this->workerMayPause();
+      if constexpr (StatsPolicy::enabled){
+        this->workerDidWakeUp(&task, 0);
+        this->workerWillExecute(&task, 0);
+      }
+      TaskPolicy::run(task);
+      if constexpr (StatsPolicy::enabled){
+        this->workerDidExecute(&task, TaskPolicy::profilingKey(task));
+      }
+    } else if constexpr (StatsPolicy::enabled){
+      this->workerDidWakeUp(nullptr);
+    }
+  }
+
+  return ;
+}
+
+template <typename QueuePolicy, typename WaitPolicy, typename TaskPolicy, typename StatsPolicy>
+arcana::virgil::BasicThreadPool<QueuePolicy, WaitPolicy, TaskPolicy, StatsPolicy>::~BasicThreadPool (void){
+
+  /*
+   * Signal threads to quite.
+   */
+  this->m_done = true;
+  this->resume();
+  this->queue.invalidate();
+
+  /*
+   * Wait for all threads to start or avoid to start.
+   */
+  this->waitAllThreadsToBeUnavailable();
+
+  return ;
+}
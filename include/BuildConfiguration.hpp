@@ -0,0 +1,44 @@
+/*
+ * Copyright 2017 - 2019  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The namespace that identifies the set of build options of a translation unit.
+ *
+ * Some classes change their layout depending on the macros of the build options (see the README).
+ * Those classes are declared in an inline namespace named after the options, so translation units built with different options see different types rather than violating the one definition rule.
+ * Passing such objects between these translation units then fails at link time rather than at run time.
+ */
+#pragma once
+
+#ifdef VIRGIL_STATISTICS
+#define VIRGIL_INTERNAL_STATISTICS_TAG s1
+#else
+#define VIRGIL_INTERNAL_STATISTICS_TAG s0
+#endif
+
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+#define VIRGIL_INTERNAL_HISTOGRAMS_TAG h1
+#else
+#define VIRGIL_INTERNAL_HISTOGRAMS_TAG h0
+#endif
+
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+#define VIRGIL_INTERNAL_COUNTERS_TAG p1
+#else
+#define VIRGIL_INTERNAL_COUNTERS_TAG p0
+#endif
+
+#define VIRGIL_INTERNAL_CONCATENATE(s, h, p) build_ ## s ## _ ## h ## _ ## p
+#define VIRGIL_INTERNAL_NAMESPACE(s, h, p) VIRGIL_INTERNAL_CONCATENATE(s, h, p)
+
+/*
+ * For example, build_s1_h0_p0 when only VIRGIL_STATISTICS is defined.
+ */
+#define VIRGIL_BUILD_NAMESPACE VIRGIL_INTERNAL_NAMESPACE(VIRGIL_INTERNAL_STATISTICS_TAG, VIRGIL_INTERNAL_HISTOGRAMS_TAG, VIRGIL_INTERNAL_COUNTERS_TAG)
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The CPUBudget class.
+ * Detects how many CPUs the process can actually use, which is what the default number of workers of a thread pool is derived from.
+ *
+ * The budget is the smallest of the CPUs in the affinity mask of the process, the CPUs of its cpuset, and the CPU quota of its cgroup (cpu.max for cgroup v2, cpu.cfs_quota_us for cgroup v1).
+ * In a container limited to 4 CPUs on a 128-core host, hardware_concurrency() returns 128 while the budget is 4.
+ */
+#pragma once
+
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace arcana::virgil {
+
+  class CPUBudget {
+    public:
+
+      /*
+       * CPUs in the affinity mask of the process.
+       */
+      std::uint32_t affinity = 0;
+
+      /*
+       * CPUs of the cpuset of the cgroup of the process, or 0 if unknown.
+       */
+      std::uint32_t cpuset = 0;
+
+      /*
+       * CPUs granted by the CPU quota of the cgroup of the process (e.g., 2.5), or 0 if there is no quota.
+       */
+      double quota = 0;
+
+      /*
+       * CPUs the process can use: the smallest of the limits above, with the quota rounded up, and at least 1.
+       */
+      std::uint32_t cpus = 1;
+
+      /*
+       * Read the limits of the process now.
+       */
+      static CPUBudget detect (void);
+
+      /*
+       * Return the CPUs the process can use.
+       * The limits are read the first time, and then whenever refresh is invoked.
+       */
+      static std::uint32_t available (void);
+
+      /*
+       * Read the limits of the process again, and return the CPUs the process can use.
+       */
+      static std::uint32_t refresh (void);
+
+      /*
+       * Return the number of workers a thread pool creates by default: one less than the CPUs available, as the thread that submits tasks uses a CPU too, and at least one.
+       */
+      static std::uint32_t defaultNumberOfThreads (void);
+
+    private:
+      inline static std::atomic<std::uint32_t> cachedCPUs{0};
+
+      /*
+       * Return the number of CPUs of a list like "0-3,8,10-11".
+       */
+      static std::uint32_t internal_countCPUs (const std::string &list);
+
+      /*
+       * Return the path of the cgroup of the process for @controller ("" for cgroup v2), or "" if there is none.
+       */
+      static std::string internal_cgroupPath (const std::string &controller, bool &found);
+
+      /*
+       * Read the first line of @file into @line.
+       */
+      static bool internal_readLine (const std::string &file, std::string &line);
+  };
+
+  /*
+   * Monitors the CPU budget of the process, e.g., to resize a thread pool when the quota of its container changes.
+   */
+  class CPUBudgetMonitor {
+    public:
+
+      /*
+       * Constructor.
+       * The budget is read every @period, and @onChange is invoked with the new budget whenever it changes.
+       */
+      CPUBudgetMonitor (std::chrono::milliseconds period, std::function<void (std::uint32_t cpus)> onChange);
+
+      /*
+       * Destructor.
+       */
+      ~CPUBudgetMonitor (void);
+
+      /*
+       * Not copyable.
+       */
+      CPUBudgetMonitor (const CPUBudgetMonitor & other) = delete;
+      CPUBudgetMonitor & operator= (const CPUBudgetMonitor & other) = delete;
+
+    private:
+      std::chrono::milliseconds period;
+      std::function<void (std::uint32_t cpus)> onChange;
+      std::mutex lock;
+      std::condition_variable stopped;
+      bool stop = false;
+      std::thread monitor;
+
+      void monitorFunction (void);
+  };
+
+}
+
+arcana::virgil::CPUBudget arcana::virgil::CPUBudget::detect (void){
+  CPUBudget budget;
+
+  /*
+   * Affinity mask.
+   */
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (sched_getaffinity(0, sizeof(mask), &mask) == 0){
+    budget.affinity = CPU_COUNT(&mask);
+  }
+  if (budget.affinity == 0){
+    budget.affinity = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  std::uint32_t cpus = budget.affinity;
+
+  /*
+   * Cgroup v2: the quota of every ancestor of the cgroup applies.
+   * The cgroup of the process might not be visible in the mounted hierarchy (e.g., within containers), so the closest ancestor that exists is used.
+   */
+  std::string line;
+  auto found = false;
+  auto path = internal_cgroupPath("", found);
+  if (found){
+    auto directory = "/sys/fs/cgroup" + path;
+    if (internal_readLine(directory + "/cpuset.cpus.effective", line)){
+      budget.cpuset = internal_countCPUs(line);
+    }
+    while (true){
+      if (internal_readLine(directory + "/cpu.max", line)){
+        std::istringstream fields{line};
+        std::string quota;
+        double period = 0;
+        fields >> quota >> period;
+        if (  (quota != "max")
+              && (period > 0)
+           ){
+          auto cpusOfQuota = std::stod(quota) / period;
+          if (  (budget.quota == 0)
+                || (cpusOfQuota < budget.quota)
+             ){
+            budget.quota = cpusOfQuota;
+          }
+        }
+      }
+      auto parent = directory.find_last_of('/');
+      if (  (parent == std::string::npos)
+            || (directory == "/sys/fs/cgroup")
+         ){
+        break ;
+      }
+      directory = directory.substr(0, parent);
+    }
+  }
+
+  /*
+   * Cgroup v1.
+   */
+  path = internal_cgroupPath("cpu", found);
+  if (found){
+    for (auto mount : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"}){
+      std::string directory = mount + path;
+      while (true){
+        std::string period;
+        if (  internal_readLine(directory + "/cpu.cfs_quota_us", line)
+              && internal_readLine(directory + "/cpu.cfs_period_us", period)
+              && (std::stol(line) > 0)
+              && (std::stol(period) > 0)
+           ){
+          auto cpusOfQuota = std::stod(line) / std::stod(period);
+          if (  (budget.quota == 0)
+                || (cpusOfQuota < budget.quota)
+             ){
+            budget.quota = cpusOfQuota;
+          }
+        }
+        if (directory == mount){
+          break ;
+        }
+        directory = directory.substr(0, directory.find_last_of('/'));
+      }
+    }
+  }
+  path = internal_cgroupPath("cpuset", found);
+  if (  found
+        && (budget.cpuset == 0)
+        && internal_readLine("/sys/fs/cgroup/cpuset" + path + "/cpuset.effective_cpus", line)
+     ){
+    budget.cpuset = internal_countCPUs(line);
+  }
+
+  /*
+   * Combine the limits.
+   */
+  if (budget.cpuset > 0){
+    cpus = std::min(cpus, budget.cpuset);
+  }
+  if (budget.quota > 0){
+    cpus = std::min<std::uint32_t>(cpus, std::ceil(budget.quota));
+  }
+  budget.cpus = std::max<std::uint32_t>(cpus, 1);
+
+  return budget;
+}
+
+std::uint32_t arcana::virgil::CPUBudget::available (void){
+  auto cpus = cachedCPUs.load(std::memory_order_relaxed);
+  if (cpus == 0){
+    cpus = refresh();
+  }
+
+  return cpus;
+}
+
+std::uint32_t arcana::virgil::CPUBudget::refresh (void){
+  auto cpus = detect().cpus;
+  cachedCPUs.store(cpus, std::memory_order_relaxed);
+
+  return cpus;
+}
+
+std::uint32_t arcana::virgil::CPUBudget::defaultNumberOfThreads (void){
+  return std::max(available(), 2u) - 1u;
+}
+
+std::uint32_t arcana::virgil::CPUBudget::internal_countCPUs (const std::string &list){
+  std::uint32_t cpus = 0;
+  std::istringstream ranges{list};
+  std::string range;
+  while (std::getline(ranges, range, ',')){
+    if (range.empty()){
+      continue ;
+    }
+    auto dash = range.find('-');
+    if (dash == std::string::npos){
+      cpus++;
+      continue ;
+    }
+    auto first = std::stoul(range.substr(0, dash));
+    auto last = std::stoul(range.substr(dash + 1));
+    if (last >= first){
+      cpus += last - first + 1;
+    }
+  }
+
+  return cpus;
+}
+
+std::string arcana::virgil::CPUBudget::internal_cgroupPath (const std::string &controller, bool &found){
+
+  /*
+   * Every line of /proc/self/cgroup is "ID:CONTROLLERS:PATH", where the cgroup v2 line has ID 0 and no controllers.
+   */
+  found = false;
+  std::ifstream cgroups{"/proc/self/cgroup"};
+  std::string line;
+  while (std::getline(cgroups, line)){
+    auto first = line.find(':');
+    auto second = line.find(':', first + 1);
+    if (  (first == std::string::npos)
+          || (second == std::string::npos)
+       ){
+      continue ;
+    }
+    auto controllers = line.substr(first + 1, second - first - 1);
+    auto matches = false;
+    if (controller.empty()){
+      matches = (line.substr(0, first) == "0") && controllers.empty();
+    } else {
+      std::istringstream names{controllers};
+      std::string name;
+      while (std::getline(names, name, ',')){
+        if (name == controller){
+          matches = true;
+        }
+      }
+    }
+    if (matches){
+      found = true;
+      auto path = line.substr(second + 1);
+      if (path == "/"){
+        path = "";
+      }
+      return path;
+    }
+  }
+
+  return "";
+}
+
+bool arcana::virgil::CPUBudget::internal_readLine (const std::string &file, std::string &line){
+  std::ifstream input{file};
+  if (!input.is_open()){
+    return false;
+  }
+
+  return static_cast<bool>(std::getline(input, line));
+}
+
+arcana::virgil::CPUBudgetMonitor::CPUBudgetMonitor (std::chrono::milliseconds period, std::function<void (std::uint32_t cpus)> onChange)
+  : period{period}
+  , onChange{onChange}
+  {
+  this->monitor = std::thread{&CPUBudgetMonitor::monitorFunction, this};
+
+  return ;
+}
+
+arcana::virgil::CPUBudgetMonitor::~CPUBudgetMonitor (void){
+  {
+    std::lock_guard<std::mutex> guard{this->lock};
+    this->stop = true;
+  }
+  this->stopped.notify_all();
+  this->monitor.join();
+
+  return ;
+}
+
+void arcana::virgil::CPUBudgetMonitor::monitorFunction (void){
+  auto cpus = CPUBudget::available();
+  std::unique_lock<std::mutex> guard{this->lock};
+  while (!this->stop){
+    this->stopped.wait_for(guard, this->period, [this](void){ return this->stop; });
+    if (this->stop){
+      break ;
+    }
+
+    /*
+     * Read the budget without holding the lock, so the destructor does not wait for the file system.
+     */
+    guard.unlock();
+    auto newCPUs = CPUBudget::refresh();
+    if (newCPUs != cpus){
+      cpus = newCPUs;
+      this->onChange(cpus);
+    }
+    guard.lock();
+  }
+
+  return ;
+}
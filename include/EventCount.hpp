@@ -0,0 +1,116 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The EventCount class.
+ * Lets threads sleep until a condition, checked without locks, becomes true.
+ *
+ * A waiter announces itself with prepareWait(), checks its condition again, and then either calls cancelWait() if the condition holds or wait() otherwise.
+ * A notifier makes the condition true and then calls notify(), which costs a single load when nobody waits.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Futex.hpp"
+
+namespace arcana::virgil {
+
+  class EventCount {
+    public:
+
+      /*
+       * Announce that the caller is about to wait.
+       * Return the key to pass to wait().
+       */
+      std::uint32_t prepareWait (void);
+
+      /*
+       * The caller does not need to wait anymore.
+       */
+      void cancelWait (void);
+
+      /*
+       * Sleep until a notification happens after the prepareWait() that returned @key.
+       */
+      void wait (std::uint32_t key);
+
+      /*
+       * Wake up one or all waiting threads, if any.
+       */
+      void notify (void);
+      void notifyAll (void);
+
+      /*
+       * Check whether or not some thread is waiting.
+       */
+      bool hasWaiters (void) const ;
+
+    private:
+      std::atomic<std::uint32_t> epoch{0};
+      std::atomic<std::uint32_t> waiters{0};
+  };
+
+}
+
+inline std::uint32_t arcana::virgil::EventCount::prepareWait (void){
+  this->waiters.fetch_add(1, std::memory_order_seq_cst);
+
+  return this->epoch.load(std::memory_order_seq_cst);
+}
+
+inline void arcana::virgil::EventCount::cancelWait (void){
+  this->waiters.fetch_sub(1, std::memory_order_relaxed);
+
+  return ;
+}
+
+inline void arcana::virgil::EventCount::wait (std::uint32_t key){
+  while (this->epoch.load(std::memory_order_acquire) == key){
+    Futex::wait(&this->epoch, key);
+  }
+  this->waiters.fetch_sub(1, std::memory_order_relaxed);
+
+  return ;
+}
+
+inline void arcana::virgil::EventCount::notify (void){
+
+  /*
+   * Order the update of the condition done by the caller before the check of the waiters.
+   * This pairs with the fetch_add of prepareWait.
+   */
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (this->waiters.load(std::memory_order_relaxed) == 0){
+    return ;
+  }
+  this->epoch.fetch_add(1, std::memory_order_release);
+  Futex::wake(&this->epoch, 1);
+
+  return ;
+}
+
+inline void arcana::virgil::EventCount::notifyAll (void){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (this->waiters.load(std::memory_order_relaxed) == 0){
+    return ;
+  }
+  this->epoch.fetch_add(1, std::memory_order_release);
+  Futex::wakeAll(&this->epoch);
+
+  return ;
+}
+
+inline bool arcana::virgil::EventCount::hasWaiters (void) const {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  return this->waiters.load(std::memory_order_relaxed) > 0;
+}
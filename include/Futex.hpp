@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The Futex class.
+ * Thin wrapper around the futex system call of Linux.
+ */
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+
+namespace arcana::virgil {
+
+  class Futex {
+    public:
+
+      /*
+       * Sleep while *address is equal to @expected.
+       * The caller might wake up spuriously, so it needs to check the condition it waits for again.
+       * If @timeoutNanoseconds is not zero, the caller sleeps for at most that long.
+       */
+      static void wait (std::atomic<std::uint32_t> *address, std::uint32_t expected, std::uint64_t timeoutNanoseconds = 0);
+
+      /*
+       * Wake up at most @threads threads sleeping on @address.
+       */
+      static void wake (std::atomic<std::uint32_t> *address, std::uint32_t threads);
+
+      /*
+       * Wake up all threads sleeping on @address.
+       */
+      static void wakeAll (std::atomic<std::uint32_t> *address);
+  };
+
+}
+
+inline void arcana::virgil::Futex::wait (std::atomic<std::uint32_t> *address, std::uint32_t expected, std::uint64_t timeoutNanoseconds){
+  static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futexes need 32-bit words");
+
+  struct timespec timeout;
+  struct timespec *t = nullptr;
+  if (timeoutNanoseconds > 0){
+    timeout.tv_sec = static_cast<time_t>(timeoutNanoseconds / 1000000000);
+    timeout.tv_nsec = static_cast<long>(timeoutNanoseconds % 1000000000);
+    t = &timeout;
+  }
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(address), FUTEX_WAIT_PRIVATE, expected, t, nullptr, 0);
+
+  return ;
+}
+
+inline void arcana::virgil::Futex::wake (std::atomic<std::uint32_t> *address, std::uint32_t threads){
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(address), FUTEX_WAKE_PRIVATE, threads, nullptr, nullptr, 0);
+
+  return ;
+}
+
+inline void arcana::virgil::Futex::wakeAll (std::atomic<std::uint32_t> *address){
+  Futex::wake(address, INT32_MAX);
+
+  return ;
+}
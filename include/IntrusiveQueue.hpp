@@ -0,0 +1,482 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The IntrusiveMPSCQueue and IntrusiveMPMCQueue classes.
+ * Queues of objects that are linked through a field embedded in the objects themselves, so pushing and popping never allocate nor copy.
+ *
+ * An object can be in at most one intrusive queue at a time, and it must outlive its stay in the queue.
+ * IntrusiveMPSCQueue is D. Vyukov's intrusive multi-producer single-consumer queue: a push is a single atomic exchange.
+ * IntrusiveMPMCQueue adds a lock on the consumer side to let several consumers share the queue, while pushes stay lock-free.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <pthread.h>
+
+#include "EventCount.hpp"
+
+namespace arcana::virgil {
+
+  /*
+   * Base class of the objects that can be pushed to intrusive queues.
+   */
+  class IntrusiveQueueNode {
+    public:
+      IntrusiveQueueNode (void) = default;
+
+      /*
+       * Copies and moves do not carry the link, which belongs to the queue the object is in.
+       */
+      IntrusiveQueueNode (const IntrusiveQueueNode &other) {}
+      IntrusiveQueueNode & operator= (const IntrusiveQueueNode &other) { return *this; }
+
+    private:
+      template <typename T> friend class IntrusiveMPSCQueue;
+
+      std::atomic<IntrusiveQueueNode *> intrusiveNext{nullptr};
+  };
+
+  /*
+   * How an intrusive queue finds the node embedded in an object and vice versa.
+   * Objects that cannot derive from IntrusiveQueueNode (e.g., C structures) specialize this class.
+   */
+  template <typename T>
+  struct IntrusiveQueueTraits {
+    static IntrusiveQueueNode * node (T *object) {
+      return object;
+    }
+
+    static T * object (IntrusiveQueueNode *node) {
+      return static_cast<T *>(node);
+    }
+  };
+
+  template <typename T>
+  class IntrusiveMPSCQueue {
+    public:
+
+      /*
+       * Constructor.
+       */
+      IntrusiveMPSCQueue (void);
+
+      /*
+       * Push a new object onto the queue.
+       * Any number of threads can push concurrently.
+       */
+      void push (T *object);
+
+      /*
+       * Attempt to get the first object in the queue.
+       * Returns true if an object was successfully written to the out parameter, false otherwise.
+       * Only one thread at a time can pop.
+       */
+      bool tryPop (T *&out);
+
+      /*
+       * Get the first object in the queue.
+       * Will block until an object is available unless the queue is invalidated.
+       * Returns true if an object was successfully written to the out parameter, false otherwise.
+       */
+      bool waitPop (T *&out);
+
+      /*
+       * Get the first object in the queue.
+       * Keeps polling the queue for @spinPeriod before sleeping, which trades a core for a lower wakeup latency.
+       */
+      bool waitPop (T *&out, std::chrono::nanoseconds spinPeriod);
+
+      /*
+       * Invalidate the queue and wake up the consumers waiting on it.
+       */
+      void invalidate (void);
+
+      /*
+       * Check whether or not the queue is empty.
+       */
+      bool empty (void) const ;
+
+      /*
+       * Return the number of objects in the queue.
+       */
+      int64_t size (void) const ;
+
+      /*
+       * Not copyable.
+       */
+      IntrusiveMPSCQueue (const IntrusiveMPSCQueue & other) = delete;
+      IntrusiveMPSCQueue & operator= (const IntrusiveMPSCQueue & other) = delete;
+
+    private:
+      template <typename U> friend class IntrusiveMPMCQueue;
+
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+
+      /*
+       * Fields.
+       * Producers append after head, the consumer pops from tail, and stub keeps the list non-empty.
+       */
+      alignas(64) std::atomic<IntrusiveQueueNode *> head;
+      alignas(64) IntrusiveQueueNode *tail;
+      IntrusiveQueueNode stub;
+      alignas(64) std::atomic<int64_t> count{0};
+      std::atomic_bool valid{true};
+      EventCount notEmpty;
+
+      /*
+       * Methods.
+       */
+      void link (IntrusiveQueueNode *node);
+  };
+
+  template <typename T>
+  class IntrusiveMPMCQueue {
+    public:
+
+      /*
+       * Constructor.
+       */
+      IntrusiveMPMCQueue (void);
+
+      /*
+       * Push a new object onto the queue.
+       * Any number of threads can push concurrently.
+       */
+      void push (T *object);
+
+      /*
+       * Attempt to get the first object in the queue.
+       * Returns true if an object was successfully written to the out parameter, false otherwise.
+       */
+      bool tryPop (T *&out);
+
+      /*
+       * Get the first object in the queue.
+       * Will block until an object is available unless the queue is invalidated.
+       * Returns true if an object was successfully written to the out parameter, false otherwise.
+       */
+      bool waitPop (T *&out);
+
+      /*
+       * Get the first object in the queue.
+       * Keeps polling the queue for @spinPeriod before sleeping, which trades a core for a lower wakeup latency.
+       */
+      bool waitPop (T *&out, std::chrono::nanoseconds spinPeriod);
+
+      /*
+       * Invalidate the queue and wake up the consumers waiting on it.
+       */
+      void invalidate (void);
+
+      /*
+       * Check whether or not the queue is empty.
+       */
+      bool empty (void) const ;
+
+      /*
+       * Return the number of objects in the queue.
+       */
+      int64_t size (void) const ;
+
+      /*
+       * Destructor.
+       */
+      ~IntrusiveMPMCQueue (void);
+
+      /*
+       * Not copyable.
+       */
+      IntrusiveMPMCQueue (const IntrusiveMPMCQueue & other) = delete;
+      IntrusiveMPMCQueue & operator= (const IntrusiveMPMCQueue & other) = delete;
+
+    private:
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+
+      /*
+       * Consumers sleep on the event count of the underlying queue.
+       */
+      IntrusiveMPSCQueue<T> queue;
+      mutable pthread_spinlock_t consumerLock;
+  };
+
+}
+
+template <typename T>
+arcana::virgil::IntrusiveMPSCQueue<T>::IntrusiveMPSCQueue (void)
+  : head{&stub}
+  , tail{&stub}
+  {
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::IntrusiveMPSCQueue<T>::push (T *object){
+
+  /*
+   * Count the object before linking it, so the consumer never misses it when it goes to sleep.
+   */
+  this->count.fetch_add(1, std::memory_order_relaxed);
+  this->link(IntrusiveQueueTraits<T>::node(object));
+
+  /*
+   * Wake up the consumer if it sleeps.
+   */
+  this->notEmpty.notify();
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPSCQueue<T>::tryPop (T *&out){
+  auto t = this->tail;
+  auto next = t->intrusiveNext.load(std::memory_order_acquire);
+
+  /*
+   * Skip the stub.
+   */
+  if (t == &this->stub){
+    if (next == nullptr){
+      return false;
+    }
+    this->tail = next;
+    t = next;
+    next = next->intrusiveNext.load(std::memory_order_acquire);
+  }
+
+  /*
+   * Pop t if another object follows it.
+   */
+  if (next != nullptr){
+    this->tail = next;
+    out = IntrusiveQueueTraits<T>::object(t);
+    this->count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /*
+   * t is the last object linked.
+   * If a producer has already swapped head but has not linked its object yet, the object will be available shortly.
+   */
+  if (t != this->head.load(std::memory_order_acquire)){
+    return false;
+  }
+
+  /*
+   * Put the stub behind t, so t can leave the queue.
+   */
+  this->link(&this->stub);
+  next = t->intrusiveNext.load(std::memory_order_acquire);
+  if (next != nullptr){
+    this->tail = next;
+    out = IntrusiveQueueTraits<T>::object(t);
+    this->count.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPSCQueue<T>::waitPop (T *&out){
+  return this->waitPop(out, std::chrono::nanoseconds{0});
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPSCQueue<T>::waitPop (T *&out, std::chrono::nanoseconds spinPeriod){
+  std::uint32_t spins = 0;
+  std::chrono::steady_clock::time_point spinEnd{};
+  while (true){
+    if (!this->valid.load(std::memory_order_acquire)){
+      return false;
+    }
+    if (this->tryPop(out)){
+      return true;
+    }
+
+    /*
+     * Spin for a while before sleeping, as an object often arrives shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Keep spinning until the spin period elapses.
+     * The clock is read once every spinsBeforeSleeping attempts.
+     */
+    if (spinPeriod.count() > 0){
+      auto now = std::chrono::steady_clock::now();
+      if (spinEnd == std::chrono::steady_clock::time_point{}){
+        spinEnd = now + spinPeriod;
+      }
+      if (now < spinEnd){
+        spins = 0;
+        continue ;
+      }
+    }
+
+    /*
+     * Sleep until a producer pushes an object.
+     * The queue is checked again after announcing the wait, so an object pushed in between is not missed.
+     */
+    auto key = this->notEmpty.prepareWait();
+    if (  (!this->empty())
+          || (!this->valid.load(std::memory_order_acquire))
+       ){
+      this->notEmpty.cancelWait();
+
+      /*
+       * A producer might be in the middle of linking its object.
+       */
+      std::this_thread::yield();
+      continue ;
+    }
+    this->notEmpty.wait(key);
+  }
+}
+
+template <typename T>
+void arcana::virgil::IntrusiveMPSCQueue<T>::invalidate (void){
+  this->valid.store(false, std::memory_order_release);
+  this->notEmpty.notifyAll();
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPSCQueue<T>::empty (void) const {
+  return this->size() == 0;
+}
+
+template <typename T>
+int64_t arcana::virgil::IntrusiveMPSCQueue<T>::size (void) const {
+  return this->count.load(std::memory_order_acquire);
+}
+
+template <typename T>
+void arcana::virgil::IntrusiveMPSCQueue<T>::link (IntrusiveQueueNode *node){
+  node->intrusiveNext.store(nullptr, std::memory_order_relaxed);
+  auto previous = this->head.exchange(node, std::memory_order_acq_rel);
+  previous->intrusiveNext.store(node, std::memory_order_release);
+
+  return ;
+}
+
+template <typename T>
+arcana::virgil::IntrusiveMPMCQueue<T>::IntrusiveMPMCQueue (void){
+  pthread_spin_init(&this->consumerLock, 0);
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::IntrusiveMPMCQueue<T>::push (T *object){
+  this->queue.push(object);
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPMCQueue<T>::tryPop (T *&out){
+  if (this->queue.empty()){
+    return false;
+  }
+
+  pthread_spin_lock(&this->consumerLock);
+  auto popped = this->queue.tryPop(out);
+  pthread_spin_unlock(&this->consumerLock);
+
+  return popped;
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPMCQueue<T>::waitPop (T *&out){
+  return this->waitPop(out, std::chrono::nanoseconds{0});
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPMCQueue<T>::waitPop (T *&out, std::chrono::nanoseconds spinPeriod){
+  std::uint32_t spins = 0;
+  std::chrono::steady_clock::time_point spinEnd{};
+  while (true){
+    if (!this->queue.valid.load(std::memory_order_acquire)){
+      return false;
+    }
+    if (this->tryPop(out)){
+      return true;
+    }
+
+    /*
+     * Spin for a while before sleeping, as an object often arrives shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Keep spinning until the spin period elapses.
+     * The clock is read once every spinsBeforeSleeping attempts.
+     */
+    if (spinPeriod.count() > 0){
+      auto now = std::chrono::steady_clock::now();
+      if (spinEnd == std::chrono::steady_clock::time_point{}){
+        spinEnd = now + spinPeriod;
+      }
+      if (now < spinEnd){
+        spins = 0;
+        continue ;
+      }
+    }
+
+    /*
+     * Sleep until a producer pushes an object.
+     */
+    auto key = this->queue.notEmpty.prepareWait();
+    if (  (!this->queue.empty())
+          || (!this->queue.valid.load(std::memory_order_acquire))
+       ){
+      this->queue.notEmpty.cancelWait();
+      std::this_thread::yield();
+      continue ;
+    }
+    this->queue.notEmpty.wait(key);
+  }
+}
+
+template <typename T>
+void arcana::virgil::IntrusiveMPMCQueue<T>::invalidate (void){
+  this->queue.invalidate();
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::IntrusiveMPMCQueue<T>::empty (void) const {
+  return this->queue.empty();
+}
+
+template <typename T>
+int64_t arcana::virgil::IntrusiveMPMCQueue<T>::size (void) const {
+  return this->queue.size();
+}
+
+template <typename T>
+arcana::virgil::IntrusiveMPMCQueue<T>::~IntrusiveMPMCQueue (void){
+  pthread_spin_destroy(&this->consumerLock);
+
+  return ;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The LatencyHistogram class.
+ * Log-linear histogram of latencies expressed in nanoseconds.
+ *
+ * Each power of two is split into 32 linear sub-buckets, so every recorded value is known within about 3%.
+ * Recording a value takes no lock and allocates no memory.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "TimestampCounter.hpp"
+
+namespace arcana::virgil {
+
+  class LatencyHistogram {
+    public:
+
+      /*
+       * Default constructor.
+       */
+      LatencyHistogram (void) = default;
+
+      /*
+       * Copy the counts of another histogram.
+       */
+      LatencyHistogram (const LatencyHistogram &other);
+      LatencyHistogram & operator= (const LatencyHistogram &other);
+
+      /*
+       * Record a latency of @nanoseconds.
+       * Multiple threads can record concurrently.
+       */
+      void record (std::uint64_t nanoseconds);
+
+      /*
+       * Record the latency between @startTicks, a value of TimestampCounter::read(), and now.
+       */
+      void recordSince (std::uint64_t startTicks);
+
+      /*
+       * Add the counts of @other to this histogram.
+       */
+      void merge (const LatencyHistogram &other);
+
+      /*
+       * Return the number of latencies recorded.
+       */
+      std::uint64_t count (void) const ;
+
+      /*
+       * Return the latency in nanoseconds that is greater than or equal to @p percent of the latencies recorded (e.g., 99.9).
+       * Return 0 if no latency has been recorded.
+       */
+      std::uint64_t percentile (double p) const ;
+
+      /*
+       * Return the average latency in nanoseconds.
+       */
+      double mean (void) const ;
+
+      /*
+       * Return the largest latency recorded, within the precision of the histogram.
+       */
+      std::uint64_t max (void) const ;
+
+      /*
+       * Forget all latencies recorded.
+       */
+      void reset (void);
+
+      /*
+       * Record the time spent in the scope where the object lives.
+       */
+      class ScopedRecorder {
+        public:
+          explicit ScopedRecorder (LatencyHistogram *histogram);
+          ~ScopedRecorder (void);
+
+          ScopedRecorder (const ScopedRecorder &other) = delete;
+          ScopedRecorder & operator= (const ScopedRecorder &other) = delete;
+
+        private:
+          LatencyHistogram *histogram;
+          std::uint64_t start;
+      };
+
+    private:
+      static constexpr std::uint32_t subBucketBits = 5;
+      static constexpr std::uint32_t subBuckets = 1u << subBucketBits;
+      static constexpr std::uint32_t buckets = (64 - subBucketBits + 1) * subBuckets;
+
+      std::atomic<std::uint64_t> counts[buckets] = {};
+
+      /*
+       * Map a value to its bucket and a bucket to the smallest and largest values it holds.
+       */
+      static std::uint32_t bucketOf (std::uint64_t value);
+      static std::uint64_t lowestValueOf (std::uint32_t bucket);
+      static std::uint64_t highestValueOf (std::uint32_t bucket);
+  };
+
+  /*
+   * Latencies of the tasks run by a single worker.
+   *
+   * queueResidence: time between the submission of a task and the beginning of its execution.
+   * execution: time spent executing a task.
+   */
+  struct WorkerLatencies {
+    LatencyHistogram queueResidence;
+    LatencyHistogram execution;
+  };
+
+  /*
+   * Latencies of a whole thread pool.
+   */
+  struct ThreadPoolLatencies {
+
+    /*
+     * Whether or not the histograms have been compiled in.
+     */
+    bool enabled = false;
+
+    /*
+     * Merge of the histograms of all workers.
+     */
+    LatencyHistogram queueResidence;
+    LatencyHistogram execution;
+
+    /*
+     * Time spent by callers of TaskFuture::get waiting for the result of tasks of the pool.
+     */
+    LatencyHistogram futureWait;
+
+    /*
+     * Histograms of each worker, in order of creation.
+     */
+    std::vector<WorkerLatencies> workers;
+  };
+
+}
+
+inline arcana::virgil::LatencyHistogram::LatencyHistogram (const LatencyHistogram &other){
+  this->merge(other);
+
+  return ;
+}
+
+inline arcana::virgil::LatencyHistogram & arcana::virgil::LatencyHistogram::operator= (const LatencyHistogram &other){
+  if (this != &other){
+    this->reset();
+    this->merge(other);
+  }
+
+  return *this;
+}
+
+inline void arcana::virgil::LatencyHistogram::record (std::uint64_t nanoseconds){
+  this->counts[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+  return ;
+}
+
+inline void arcana::virgil::LatencyHistogram::recordSince (std::uint64_t startTicks){
+  auto endTicks = TimestampCounter::read();
+  auto elapsed = (endTicks > startTicks) ? (endTicks - startTicks) : 0;
+  this->record(TimestampCounter::toNanoseconds(elapsed));
+
+  return ;
+}
+
+inline void arcana::virgil::LatencyHistogram::merge (const LatencyHistogram &other){
+  for (auto i = 0u; i < buckets; i++){
+    auto c = other.counts[i].load(std::memory_order_relaxed);
+    if (c > 0){
+      this->counts[i].fetch_add(c, std::memory_order_relaxed);
+    }
+  }
+
+  return ;
+}
+
+inline std::uint64_t arcana::virgil::LatencyHistogram::count (void) const {
+  std::uint64_t n = 0;
+  for (auto i = 0u; i < buckets; i++){
+    n += this->counts[i].load(std::memory_order_relaxed);
+  }
+
+  return n;
+}
+
+inline std::uint64_t arcana::virgil::LatencyHistogram::percentile (double p) const {
+
+  /*
+   * Compute the rank of the latency to return.
+   */
+  auto n = this->count();
+  if (n == 0){
+    return 0;
+  }
+  auto rank = static_cast<std::uint64_t>((p / 100.0) * static_cast<double>(n) + 0.5);
+  rank = std::max<std::uint64_t>(rank, 1);
+  rank = std::min(rank, n);
+
+  /*
+   * Find the bucket that includes the rank.
+   */
+  std::uint64_t seen = 0;
+  for (auto i = 0u; i < buckets; i++){
+    seen += this->counts[i].load(std::memory_order_relaxed);
+    if (seen >= rank){
+      return highestValueOf(i);
+    }
+  }
+
+  return highestValueOf(buckets - 1);
+}
+
+inline double arcana::virgil::LatencyHistogram::mean (void) const {
+  double sum = 0;
+  std::uint64_t n = 0;
+  for (auto i = 0u; i < buckets; i++){
+    auto c = this->counts[i].load(std::memory_order_relaxed);
+    if (c == 0){
+      continue ;
+    }
+
+    /*
+     * Use the middle of the bucket.
+     */
+    auto middle = (static_cast<double>(lowestValueOf(i)) + static_cast<double>(highestValueOf(i))) / 2;
+    sum += middle * static_cast<double>(c);
+    n += c;
+  }
+  if (n == 0){
+    return 0;
+  }
+
+  return sum / static_cast<double>(n);
+}
+
+inline std::uint64_t arcana::virgil::LatencyHistogram::max (void) const {
+  for (auto i = buckets; i > 0; i--){
+    if (this->counts[i - 1].load(std::memory_order_relaxed) > 0){
+      return highestValueOf(i - 1);
+    }
+  }
+
+  return 0;
+}
+
+inline void arcana::virgil::LatencyHistogram::reset (void){
+  for (auto i = 0u; i < buckets; i++){
+    this->counts[i].store(0, std::memory_order_relaxed);
+  }
+
+  return ;
+}
+
+inline std::uint32_t arcana::virgil::LatencyHistogram::bucketOf (std::uint64_t value){
+
+  /*
+   * Small values have a bucket each.
+   */
+  if (value < subBuckets){
+    return static_cast<std::uint32_t>(value);
+  }
+
+  /*
+   * Larger values are grouped by their most significant bit, and then by the next subBucketBits bits.
+   */
+  std::uint32_t msb = 63 - __builtin_clzll(value);
+  std::uint32_t shift = msb - subBucketBits;
+  auto top = static_cast<std::uint32_t>(value >> shift);
+
+  return (shift + 1) * subBuckets + (top - subBuckets);
+}
+
+inline std::uint64_t arcana::virgil::LatencyHistogram::lowestValueOf (std::uint32_t bucket){
+  if (bucket < subBuckets){
+    return bucket;
+  }
+  auto shift = (bucket / subBuckets) - 1;
+  std::uint64_t top = subBuckets + (bucket % subBuckets);
+
+  return top << shift;
+}
+
+inline std::uint64_t arcana::virgil::LatencyHistogram::highestValueOf (std::uint32_t bucket){
+  if (bucket < subBuckets){
+    return bucket;
+  }
+  auto shift = (bucket / subBuckets) - 1;
+
+  return lowestValueOf(bucket) + ((std::uint64_t(1) << shift) - 1);
+}
+
+inline arcana::virgil::LatencyHistogram::ScopedRecorder::ScopedRecorder (LatencyHistogram *histogram)
+  : histogram{histogram}
+  , start{0}
+  {
+  if (this->histogram != nullptr){
+    this->start = TimestampCounter::read();
+  }
+
+  return ;
+}
+
+inline arcana::virgil::LatencyHistogram::ScopedRecorder::~ScopedRecorder (void){
+  if (this->histogram != nullptr){
+    this->histogram->recordSince(this->start);
+  }
+
+  return ;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The building blocks of the parallel reductions and scans of ThreadPool.
+ * An iteration space is split in chunks, every chunk (or every participant) accumulates into its own cache line, and the partial results are combined by a tree.
+ */
+#pragma once
+
+#include "EventCount.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace arcana::virgil {
+
+  /*
+   * How a parallel reduction or scan splits and combines its work.
+   */
+  enum class ReductionMode {
+
+    /*
+     * Split the work in a number of chunks that depends on the workers of the pool, and let every participant accumulate the chunks it grabs.
+     * Floating point results can change from run to run.
+     */
+    Fast,
+
+    /*
+     * Split the work in chunks that depend only on its size, and combine their results in a fixed order.
+     * Results are bitwise reproducible regardless of the number of workers and of the scheduling of the chunks.
+     */
+    Deterministic
+  };
+
+  /*
+   * An accumulator that has a cache line on its own, so accumulators of different threads do not false-share.
+   */
+  template <typename T>
+  struct alignas(64) PaddedAccumulator {
+    T value;
+  };
+
+  /*
+   * The state shared by the threads that run the chunks of a parallel loop.
+   * It is shared through a shared_ptr, so helper tasks that start after the loop completed find no chunk left and exit.
+   */
+  template <typename Body>
+  class ParallelChunks {
+    public:
+
+      /*
+       * Constructor.
+       */
+      ParallelChunks (std::uint64_t chunks, Body body);
+
+      /*
+       * Run chunks until none is left.
+       */
+      void run (void);
+
+      /*
+       * Wait until every chunk completed, and rethrow the first exception thrown by a chunk, if any.
+       */
+      void wait (void);
+
+    private:
+      const std::uint64_t chunks;
+      Body body;
+      std::atomic<std::uint64_t> nextChunk{0};
+      std::atomic<std::uint32_t> nextParticipant{0};
+      std::atomic<std::uint64_t> completedChunks{0};
+      EventCount completed;
+      std::mutex errorLock;
+      std::exception_ptr error;
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+  };
+
+  /*
+   * Sequential kernels of the reductions and scans.
+   */
+  class Reduction {
+    public:
+
+      /*
+       * The minimum number of elements of a chunk.
+       */
+      static constexpr std::uint64_t minimumChunkSize = 1024;
+
+      /*
+       * The maximum number of chunks of a deterministic reduction or scan.
+       */
+      static constexpr std::uint64_t deterministicChunks = 256;
+
+      /*
+       * Return the number of chunks to split @elements elements into, for a pool with @workers workers.
+       * The deterministic mode ignores @workers.
+       */
+      static std::uint64_t numberOfChunks (std::uint64_t elements, std::uint32_t workers, ReductionMode mode);
+
+      /*
+       * Return the first element of the chunk @chunk out of @chunks of an iteration space of @elements elements.
+       */
+      static std::uint64_t chunkBegin (std::uint64_t elements, std::uint64_t chunks, std::uint64_t chunk);
+
+      /*
+       * Return the combination of map(i) for every i in [@first, @last), where @identity is neutral for @combine.
+       * Arithmetic types are accumulated in independent lanes, which the compiler can keep in vector registers.
+       */
+      template <typename T, typename Map, typename Combine>
+      static T accumulate (std::int64_t first, std::int64_t last, const T &identity, Map &map, Combine &combine);
+
+      /*
+       * Combine @values pairwise in index order.
+       */
+      template <typename T, typename Combine>
+      static T combineTree (std::vector<PaddedAccumulator<T>> &values, Combine &combine);
+
+    private:
+      static constexpr std::int64_t lanes = 8;
+  };
+
+}
+
+template <typename Body>
+arcana::virgil::ParallelChunks<Body>::ParallelChunks (std::uint64_t chunks, Body body)
+  : chunks{chunks}
+  , body{std::move(body)}
+  {
+  return ;
+}
+
+template <typename Body>
+void arcana::virgil::ParallelChunks<Body>::run (void){
+  auto participant = this->nextParticipant.fetch_add(1, std::memory_order_relaxed);
+
+  while (true){
+
+    /*
+     * Grab the next chunk.
+     */
+    auto chunk = this->nextChunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= this->chunks){
+      break ;
+    }
+
+    /*
+     * Run it.
+     * A chunk that throws still completes, so the caller does not wait forever.
+     */
+    try {
+      this->body(participant, chunk);
+    } catch (...){
+      std::lock_guard<std::mutex> lock{this->errorLock};
+      if (this->error == nullptr){
+        this->error = std::current_exception();
+      }
+    }
+
+    /*
+     * Wake up the caller waiting for the last chunk.
+     */
+    if ((this->completedChunks.fetch_add(1, std::memory_order_acq_rel) + 1) == this->chunks){
+      this->completed.notify();
+    }
+  }
+
+  return ;
+}
+
+template <typename Body>
+void arcana::virgil::ParallelChunks<Body>::wait (void){
+  std::uint32_t spins = 0;
+  while (this->completedChunks.load(std::memory_order_acquire) < this->chunks){
+
+    /*
+     * Spin for a while before sleeping, as the chunks of the helpers often complete shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Sleep until the last chunk completes.
+     * The counter is checked again after announcing the wait, so a completion in between is not missed.
+     */
+    auto key = this->completed.prepareWait();
+    if (this->completedChunks.load(std::memory_order_acquire) < this->chunks){
+      this->completed.wait(key);
+    } else {
+      this->completed.cancelWait();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock{this->errorLock};
+  if (this->error != nullptr){
+    std::rethrow_exception(this->error);
+  }
+
+  return ;
+}
+
+std::uint64_t arcana::virgil::Reduction::numberOfChunks (std::uint64_t elements, std::uint32_t workers, ReductionMode mode){
+  auto chunks = (elements + minimumChunkSize - 1) / minimumChunkSize;
+
+  /*
+   * The caller runs chunks too.
+   */
+  if (mode == ReductionMode::Fast){
+    return std::min<std::uint64_t>(chunks, 4 * (static_cast<std::uint64_t>(workers) + 1));
+  }
+
+  return std::min(chunks, deterministicChunks);
+}
+
+std::uint64_t arcana::virgil::Reduction::chunkBegin (std::uint64_t elements, std::uint64_t chunks, std::uint64_t chunk){
+  auto size = elements / chunks;
+  auto remainder = elements % chunks;
+
+  return (chunk * size) + std::min(chunk, remainder);
+}
+
+template <typename T, typename Map, typename Combine>
+T arcana::virgil::Reduction::accumulate (std::int64_t first, std::int64_t last, const T &identity, Map &map, Combine &combine){
+  auto accumulator = identity;
+  if constexpr (!std::is_arithmetic_v<T>){
+    for (auto i = first; i < last; i++){
+      accumulator = combine(accumulator, map(i));
+    }
+
+  } else {
+
+    /*
+     * Accumulate in independent lanes, so consecutive combinations do not depend on each other.
+     */
+    T laneValues[lanes];
+    for (auto l = 0; l < lanes; l++){
+      laneValues[l] = identity;
+    }
+    auto i = first;
+    for (; (i + lanes) <= last; i += lanes){
+      for (auto l = 0; l < lanes; l++){
+        laneValues[l] = combine(laneValues[l], map(i + l));
+      }
+    }
+    for (auto l = 0; i < last; i++, l++){
+      laneValues[l] = combine(laneValues[l], map(i));
+    }
+
+    /*
+     * Combine the lanes pairwise.
+     */
+    for (auto width = lanes / 2; width > 0; width /= 2){
+      for (auto l = 0; l < width; l++){
+        laneValues[l] = combine(laneValues[l], laneValues[l + width]);
+      }
+    }
+    accumulator = laneValues[0];
+  }
+
+  return accumulator;
+}
+
+template <typename T, typename Combine>
+T arcana::virgil::Reduction::combineTree (std::vector<PaddedAccumulator<T>> &values, Combine &combine){
+  for (std::size_t width = 1; width < values.size(); width *= 2){
+    for (std::size_t i = 0; (i + width) < values.size(); i += 2 * width){
+      values[i].value = combine(values[i].value, values[i + width].value);
+    }
+  }
+
+  return values[0].value;
+}
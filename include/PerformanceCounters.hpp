@@ -0,0 +1,412 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The PerformanceCounters class.
+ * Hardware performance counters of a thread, attributed to the tasks it runs.
+ *
+ * Counters are collected only if VIRGIL_PERFORMANCE_COUNTERS is defined before including any VIRGIL header.
+ * Counters that the kernel does not allow to open (e.g., because of perf_event_paranoid or because of a virtual machine) are reported as unavailable.
+ */
+#pragma once
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+namespace arcana::virgil {
+
+  /*
+   * Events counted.
+   */
+  enum PerformanceCounterEvent : std::uint32_t {
+    COUNTER_CYCLES = 0,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_MISSES,
+    COUNTER_CONTEXT_SWITCHES,
+    COUNTER_EVENTS
+  };
+
+  /*
+   * What identifies the tasks that share counters.
+   * C tasks are identified by their function, C++ tasks by the type of their callable object or by their function pointer.
+   */
+  struct TaskProfilingKey {
+    const void *function = nullptr;
+    const std::type_info *type = nullptr;
+
+    /*
+     * Return the key of the callable object @f.
+     */
+    template <typename Func>
+    static TaskProfilingKey of (const Func &f);
+
+    /*
+     * Return a human readable name of the key.
+     */
+    std::string name (void) const ;
+
+    bool operator== (const TaskProfilingKey &other) const ;
+  };
+
+  /*
+   * Counters of the tasks that share the same key.
+   */
+  struct TaskPerformanceCounters {
+    TaskProfilingKey key;
+    std::string name;
+    std::uint64_t tasks = 0;
+    std::uint64_t values[COUNTER_EVENTS] = {0};
+
+    /*
+     * Return the instructions per cycle.
+     */
+    double instructionsPerCycle (void) const ;
+  };
+
+  /*
+   * Counters of a whole thread pool.
+   */
+  struct ThreadPoolPerformanceCounters {
+
+    /*
+     * Whether or not the counters have been compiled in.
+     */
+    bool enabled = false;
+
+    /*
+     * Whether or not each event could be counted.
+     */
+    bool available[COUNTER_EVENTS] = {false};
+
+    /*
+     * Counters of each kind of task, sorted by decreasing number of cycles.
+     */
+    std::vector<TaskPerformanceCounters> tasks;
+  };
+
+  /*
+   * Counters of the thread that creates the object.
+   * All methods but read() must be invoked by that thread.
+   */
+  class PerformanceCounters {
+    public:
+
+      /*
+       * Open the counters of the invoking thread.
+       */
+      void open (void);
+
+      /*
+       * A task is about to run.
+       */
+      void beginTask (void);
+
+      /*
+       * The task started by the last beginTask completed.
+       */
+      void endTask (const TaskProfilingKey &key);
+
+      /*
+       * Accumulate the counters of the tasks run by the thread to @result.
+       */
+      void read (ThreadPoolPerformanceCounters &result) const ;
+
+      PerformanceCounters (void) = default;
+      ~PerformanceCounters (void);
+
+      PerformanceCounters (const PerformanceCounters &other) = delete;
+      PerformanceCounters & operator= (const PerformanceCounters &other) = delete;
+
+    private:
+
+      /*
+       * Entry of the table of counters per task key.
+       * The owner thread writes the entry; other threads can read it at any time.
+       */
+      struct Entry {
+        std::atomic<const void *> function{nullptr};
+        std::atomic<const std::type_info *> type{nullptr};
+        std::atomic_bool used{false};
+        std::atomic<std::uint64_t> tasks{0};
+        std::atomic<std::uint64_t> values[COUNTER_EVENTS] = {};
+      };
+
+      /*
+       * The table has a fixed size to avoid allocations while tasks run.
+       * Tasks that do not fit are accumulated in the last entry.
+       */
+      static constexpr std::uint32_t entries = 256;
+      Entry table[entries + 1];
+
+      int groupFD = -1;
+      int fds[COUNTER_EVENTS] = {-1, -1, -1, -1};
+      std::uint32_t slotOf[COUNTER_EVENTS] = {0};
+      std::uint32_t opened = 0;
+      std::uint64_t start[COUNTER_EVENTS] = {0};
+
+      bool readCounters (std::uint64_t *values);
+      Entry & entryOf (const TaskProfilingKey &key);
+      static int openEvent (std::uint32_t type, std::uint64_t config, int group);
+  };
+
+}
+
+template <typename Func>
+arcana::virgil::TaskProfilingKey arcana::virgil::TaskProfilingKey::of (const Func &f){
+  TaskProfilingKey k;
+  using F = std::decay_t<Func>;
+  if constexpr (std::is_pointer_v<F> && std::is_function_v<std::remove_pointer_t<F>>){
+    k.function = reinterpret_cast<const void *>(f);
+  } else {
+    k.type = &typeid(F);
+  }
+
+  return k;
+}
+
+inline std::string arcana::virgil::TaskProfilingKey::name (void) const {
+  const char *mangled = nullptr;
+  char address[32];
+
+  /*
+   * Fetch the symbol.
+   */
+  if (this->function != nullptr){
+    Dl_info info;
+    if (  (dladdr(this->function, &info) != 0)
+          && (info.dli_sname != nullptr)
+       ){
+      mangled = info.dli_sname;
+    } else {
+      snprintf(address, sizeof(address), "%p", this->function);
+      return address;
+    }
+  } else if (this->type != nullptr){
+    mangled = this->type->name();
+  } else {
+    return "other";
+  }
+
+  /*
+   * Demangle it.
+   */
+  auto status = 0;
+  auto demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+  if (  (status != 0)
+        || (demangled == nullptr)
+     ){
+    return mangled;
+  }
+  std::string n{demangled};
+  free(demangled);
+
+  return n;
+}
+
+inline bool arcana::virgil::TaskProfilingKey::operator== (const TaskProfilingKey &other) const {
+  if (this->function != other.function){
+    return false;
+  }
+  if (this->type == other.type){
+    return true;
+  }
+
+  return (this->type != nullptr) && (other.type != nullptr) && (*this->type == *other.type);
+}
+
+inline double arcana::virgil::TaskPerformanceCounters::instructionsPerCycle (void) const {
+  if (this->values[COUNTER_CYCLES] == 0){
+    return 0;
+  }
+
+  return static_cast<double>(this->values[COUNTER_INSTRUCTIONS]) / static_cast<double>(this->values[COUNTER_CYCLES]);
+}
+
+inline int arcana::virgil::PerformanceCounters::openEvent (std::uint32_t type, std::uint64_t config, int group){
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+inline void arcana::virgil::PerformanceCounters::open (void){
+  static const std::uint32_t types[COUNTER_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+  static const std::uint64_t configs[COUNTER_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES};
+
+  /*
+   * Open every event as part of a single group, so all of them can be read with a single system call.
+   * The first event that can be opened leads the group.
+   */
+  for (auto e = 0u; e < COUNTER_EVENTS; e++){
+    auto fd = openEvent(types[e], configs[e], this->groupFD);
+    if (fd < 0){
+      continue ;
+    }
+    if (this->groupFD < 0){
+      this->groupFD = fd;
+    }
+    this->fds[e] = fd;
+    this->slotOf[e] = this->opened;
+    this->opened++;
+  }
+
+  return ;
+}
+
+inline bool arcana::virgil::PerformanceCounters::readCounters (std::uint64_t *values){
+  if (this->groupFD < 0){
+    return false;
+  }
+
+  /*
+   * The group is read as the number of events followed by their values, in the order they have been opened.
+   */
+  std::uint64_t buffer[COUNTER_EVENTS + 1];
+  auto bytes = ::read(this->groupFD, buffer, sizeof(std::uint64_t) * (this->opened + 1));
+  if (bytes != static_cast<ssize_t>(sizeof(std::uint64_t) * (this->opened + 1))){
+    return false;
+  }
+  for (auto e = 0u; e < COUNTER_EVENTS; e++){
+    values[e] = (this->fds[e] >= 0) ? buffer[1 + this->slotOf[e]] : 0;
+  }
+
+  return true;
+}
+
+inline void arcana::virgil::PerformanceCounters::beginTask (void){
+  this->readCounters(this->start);
+
+  return ;
+}
+
+inline void arcana::virgil::PerformanceCounters::endTask (const TaskProfilingKey &key){
+  std::uint64_t end[COUNTER_EVENTS];
+  if (!this->readCounters(end)){
+    return ;
+  }
+
+  /*
+   * Attribute the difference to the task.
+   */
+  auto &entry = this->entryOf(key);
+  entry.tasks.store(entry.tasks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  for (auto e = 0u; e < COUNTER_EVENTS; e++){
+    auto &v = entry.values[e];
+    v.store(v.load(std::memory_order_relaxed) + (end[e] - this->start[e]), std::memory_order_relaxed);
+  }
+
+  return ;
+}
+
+inline arcana::virgil::PerformanceCounters::Entry & arcana::virgil::PerformanceCounters::entryOf (const TaskProfilingKey &key){
+
+  /*
+   * Look the key up, starting from its hash.
+   */
+  auto h = reinterpret_cast<std::uintptr_t>(key.function) ^ ((key.type != nullptr) ? key.type->hash_code() : 0);
+  h ^= (h >> 17);
+  for (auto i = 0u; i < entries; i++){
+    auto &entry = this->table[(h + i) % entries];
+    if (!entry.used.load(std::memory_order_relaxed)){
+
+      /*
+       * The key is new.
+       */
+      entry.function.store(key.function, std::memory_order_relaxed);
+      entry.type.store(key.type, std::memory_order_relaxed);
+      entry.used.store(true, std::memory_order_release);
+      return entry;
+    }
+    TaskProfilingKey k;
+    k.function = entry.function.load(std::memory_order_relaxed);
+    k.type = entry.type.load(std::memory_order_relaxed);
+    if (k == key){
+      return entry;
+    }
+  }
+
+  return this->table[entries];
+}
+
+inline void arcana::virgil::PerformanceCounters::read (ThreadPoolPerformanceCounters &result) const {
+  for (auto e = 0u; e < COUNTER_EVENTS; e++){
+    result.available[e] |= (this->fds[e] >= 0);
+  }
+
+  for (auto i = 0u; i <= entries; i++){
+    auto &entry = this->table[i];
+    if (  (i < entries)
+          && (!entry.used.load(std::memory_order_acquire))
+       ){
+      continue ;
+    }
+    auto tasks = entry.tasks.load(std::memory_order_relaxed);
+    if (tasks == 0){
+      continue ;
+    }
+
+    /*
+     * Find the counters of the same key computed so far.
+     */
+    TaskProfilingKey key;
+    if (i < entries){
+      key.function = entry.function.load(std::memory_order_relaxed);
+      key.type = entry.type.load(std::memory_order_relaxed);
+    }
+    auto it = std::find_if(result.tasks.begin(), result.tasks.end(), [&key](const TaskPerformanceCounters &t){ return t.key == key; });
+    if (it == result.tasks.end()){
+      TaskPerformanceCounters t;
+      t.key = key;
+      t.name = key.name();
+      result.tasks.push_back(t);
+      it = result.tasks.end() - 1;
+    }
+
+    /*
+     * Accumulate.
+     */
+    it->tasks += tasks;
+    for (auto e = 0u; e < COUNTER_EVENTS; e++){
+      it->values[e] += entry.values[e].load(std::memory_order_relaxed);
+    }
+  }
+
+  return ;
+}
+
+inline arcana::virgil::PerformanceCounters::~PerformanceCounters (void){
+  for (auto e = 0u; e < COUNTER_EVENTS; e++){
+    if (this->fds[e] >= 0){
+      close(this->fds[e]);
+    }
+  }
+
+  return ;
+}
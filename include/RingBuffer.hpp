@@ -0,0 +1,291 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The RingBuffer class.
+ * FIFO container that stores its elements in a circular array whose capacity is a power of two.
+ *
+ * The array doubles when it is full and it never shrinks, so a queue that reached its steady-state size pushes and pops without allocating memory.
+ * The container is not thread safe: callers need to synchronize accesses, with the exception of empty() and size() that can be invoked concurrently with push and pop to get a hint.
+ */
+#pragma once
+
+#include <sys/mman.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace arcana::virgil {
+
+  template <typename T>
+  class RingBuffer {
+    public:
+
+      /*
+       * Constructor.
+       *
+       * @preallocatedElements: number of elements the buffer can hold before growing for the first time (rounded up to a power of two).
+       * @hugePages: back the buffer with huge pages when it is large enough to span at least one of them.
+       */
+      explicit RingBuffer (std::uint64_t preallocatedElements = 0, bool hugePages = false);
+
+      /*
+       * Append @value.
+       */
+      void push (const T &value);
+      void push (T &&value);
+
+      /*
+       * Return the oldest element.
+       * The buffer must not be empty.
+       */
+      T & front (void);
+
+      /*
+       * Remove the oldest element.
+       * The buffer must not be empty.
+       */
+      void pop (void);
+
+      /*
+       * Check whether or not the buffer is empty.
+       */
+      bool empty (void) const ;
+
+      /*
+       * Return the number of elements in the buffer.
+       */
+      std::uint64_t size (void) const ;
+
+      /*
+       * Return the number of elements the buffer can hold before growing.
+       */
+      std::uint64_t capacity (void) const ;
+
+      /*
+       * Make room for at least @elements elements.
+       */
+      void reserve (std::uint64_t elements);
+
+      /*
+       * Destructor.
+       */
+      ~RingBuffer (void);
+
+      /*
+       * Not copyable.
+       */
+      RingBuffer (const RingBuffer &other) = delete;
+      RingBuffer & operator= (const RingBuffer &other) = delete;
+
+    private:
+      static constexpr std::uint64_t hugePageSize = 2 * 1024 * 1024;
+
+      T *m_elements = nullptr;
+      std::uint64_t m_capacity = 0;
+      std::uint64_t m_mappedBytes = 0;
+      bool m_hugePages;
+
+      /*
+       * Indexes of the oldest element and of the next free slot.
+       * They grow monotonically and they are mapped to slots by masking them with (capacity - 1).
+       */
+      std::atomic<std::uint64_t> m_head{0};
+      std::atomic<std::uint64_t> m_tail{0};
+
+      /*
+       * Methods.
+       */
+      T * slot (std::uint64_t index) const ;
+      void grow (std::uint64_t minimumCapacity);
+      T * allocate (std::uint64_t elements, std::uint64_t &mappedBytes) const ;
+      static void deallocate (T *elements, std::uint64_t mappedBytes);
+  };
+
+}
+
+template <typename T>
+arcana::virgil::RingBuffer<T>::RingBuffer (std::uint64_t preallocatedElements, bool hugePages)
+  : m_hugePages{hugePages}
+  {
+  if (preallocatedElements > 0){
+    this->grow(preallocatedElements);
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::RingBuffer<T>::push (const T &value){
+  T copy{value};
+  this->push(std::move(copy));
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::RingBuffer<T>::push (T &&value){
+  auto tail = this->m_tail.load(std::memory_order_relaxed);
+  auto head = this->m_head.load(std::memory_order_relaxed);
+
+  /*
+   * Make room for the new element.
+   */
+  if ((tail - head) == this->m_capacity){
+    this->grow(this->m_capacity + 1);
+    tail = this->m_tail.load(std::memory_order_relaxed);
+  }
+
+  /*
+   * Append the element.
+   */
+  new (this->slot(tail)) T(std::move(value));
+  this->m_tail.store(tail + 1, std::memory_order_release);
+
+  return ;
+}
+
+template <typename T>
+T & arcana::virgil::RingBuffer<T>::front (void){
+  return *this->slot(this->m_head.load(std::memory_order_relaxed));
+}
+
+template <typename T>
+void arcana::virgil::RingBuffer<T>::pop (void){
+  auto head = this->m_head.load(std::memory_order_relaxed);
+  this->slot(head)->~T();
+  this->m_head.store(head + 1, std::memory_order_release);
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::RingBuffer<T>::empty (void) const {
+  return this->m_head.load(std::memory_order_acquire) == this->m_tail.load(std::memory_order_acquire);
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::RingBuffer<T>::size (void) const {
+  auto head = this->m_head.load(std::memory_order_acquire);
+  auto tail = this->m_tail.load(std::memory_order_acquire);
+
+  return (tail > head) ? (tail - head) : 0;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::RingBuffer<T>::capacity (void) const {
+  return this->m_capacity;
+}
+
+template <typename T>
+void arcana::virgil::RingBuffer<T>::reserve (std::uint64_t elements){
+  if (elements > this->m_capacity){
+    this->grow(elements);
+  }
+
+  return ;
+}
+
+template <typename T>
+arcana::virgil::RingBuffer<T>::~RingBuffer (void){
+  while (!this->empty()){
+    this->pop();
+  }
+  deallocate(this->m_elements, this->m_mappedBytes);
+
+  return ;
+}
+
+template <typename T>
+T * arcana::virgil::RingBuffer<T>::slot (std::uint64_t index) const {
+  return this->m_elements + (index & (this->m_capacity - 1));
+}
+
+template <typename T>
+void arcana::virgil::RingBuffer<T>::grow (std::uint64_t minimumCapacity){
+
+  /*
+   * Compute the new capacity.
+   */
+  std::uint64_t newCapacity = 16;
+  while (newCapacity < minimumCapacity){
+    newCapacity *= 2;
+  }
+
+  /*
+   * Move the elements to the new array, oldest first.
+   */
+  std::uint64_t newMappedBytes = 0;
+  auto newElements = this->allocate(newCapacity, newMappedBytes);
+  auto head = this->m_head.load(std::memory_order_relaxed);
+  auto tail = this->m_tail.load(std::memory_order_relaxed);
+  for (auto i = head; i != tail; i++){
+    auto element = this->slot(i);
+    new (newElements + (i - head)) T(std::move(*element));
+    element->~T();
+  }
+
+  /*
+   * Switch to the new array.
+   */
+  deallocate(this->m_elements, this->m_mappedBytes);
+  this->m_elements = newElements;
+  this->m_mappedBytes = newMappedBytes;
+  this->m_capacity = newCapacity;
+  this->m_head.store(0, std::memory_order_relaxed);
+  this->m_tail.store(tail - head, std::memory_order_release);
+
+  return ;
+}
+
+template <typename T>
+T * arcana::virgil::RingBuffer<T>::allocate (std::uint64_t elements, std::uint64_t &mappedBytes) const {
+  auto bytes = elements * sizeof(T);
+
+  /*
+   * Use huge pages if they have been requested and the buffer spans at least one of them.
+   * Explicit huge pages are tried first; if none is reserved, ask for transparent huge pages.
+   */
+  if (  this->m_hugePages
+        && (bytes >= hugePageSize)
+     ){
+    auto rounded = ((bytes + hugePageSize - 1) / hugePageSize) * hugePageSize;
+    auto p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED){
+      p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p != MAP_FAILED){
+        madvise(p, rounded, MADV_HUGEPAGE);
+      }
+    }
+    if (p != MAP_FAILED){
+      mappedBytes = rounded;
+      return static_cast<T *>(p);
+    }
+  }
+
+  mappedBytes = 0;
+  return static_cast<T *>(::operator new(bytes, std::align_val_t{alignof(T) > 64 ? alignof(T) : 64}));
+}
+
+template <typename T>
+void arcana::virgil::RingBuffer<T>::deallocate (T *elements, std::uint64_t mappedBytes){
+  if (elements == nullptr){
+    return ;
+  }
+  if (mappedBytes > 0){
+    munmap(elements, mappedBytes);
+    return ;
+  }
+  ::operator delete(elements, std::align_val_t{alignof(T) > 64 ? alignof(T) : 64});
+
+  return ;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The SharedExecutor class.
+ * Owns a set of workers that serve the tasks of several clients, e.g., thread pools attached to it.
+ *
+ * Clients keep their own queue; workers visit the clients that have tasks in round-robin order and run one task at a time.
+ * So thread pools attached to the same executor share its workers rather than oversubscribing the cores with their own.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+
+#include "EventCount.hpp"
+#include "CPUBudget.hpp"
+#include "WorkerConfiguration.hpp"
+#include "WorkerThread.hpp"
+
+namespace arcana::virgil {
+
+  class SharedExecutor {
+    public:
+
+      /*
+       * A source of tasks served by the workers of an executor.
+       */
+      class Client {
+        public:
+
+          /*
+           * Check whether or not the client has tasks ready to run.
+           * It is invoked while the executor holds the lock of its clients, so it must not use the executor, and it must not block (e.g., on the lock of a queue): idle workers spin on that lock meanwhile.
+           */
+          virtual bool hasTasks (void) const = 0;
+
+          /*
+           * Run one task of the client, if any, on the worker @worker of the executor.
+           * Returns true if a task has been executed.
+           */
+          virtual bool runTask (std::uint32_t worker) = 0;
+
+        private:
+          friend class SharedExecutor;
+
+          /*
+           * Number of workers running a task of the client.
+           */
+          std::atomic<std::uint32_t> runners{0};
+      };
+
+      /*
+       * Return the executor shared by the whole process.
+       * It is created, with the default number of workers, the first time it is requested.
+       */
+      static SharedExecutor & instance (void);
+
+      /*
+       * Constructor.
+       * Workers are created with the stack, scheduling class, and name prefix of @configuration; they are all started by the constructor, whatever its start mode.
+       */
+      explicit SharedExecutor (const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(), const WorkerConfiguration &configuration = WorkerConfiguration{});
+
+      /*
+       * Return the number of workers.
+       */
+      std::uint32_t numberOfThreads (void) const ;
+
+      /*
+       * Start serving the tasks of @client.
+       */
+      void attach (Client *client);
+
+      /*
+       * Stop serving the tasks of @client.
+       * It returns once no worker runs a task of @client anymore.
+       */
+      void detach (Client *client);
+
+      /*
+       * Wake up workers for @tasks new tasks of a client.
+       */
+      void notify (std::uint64_t tasks);
+
+      /*
+       * Destructor.
+       * Clients must be detached first.
+       */
+      ~SharedExecutor (void);
+
+      /*
+       * Not copyable.
+       */
+      SharedExecutor (const SharedExecutor & other) = delete;
+      SharedExecutor & operator= (const SharedExecutor & other) = delete;
+
+    private:
+
+      /*
+       * Fields.
+       */
+      mutable pthread_spinlock_t clientsLock;
+      std::vector<Client *> clients;
+      std::uint64_t nextClient = 0;
+      alignas(64) std::atomic_bool done{false};
+      EventCount workAvailable;
+      std::vector<WorkerThread> workers;
+
+      /*
+       * Pick the next client that has tasks, and count the calling worker as one of its runners.
+       * Returns nullptr if no client has tasks.
+       */
+      Client * internal_nextClient (void);
+
+      /*
+       * Check whether or not a client has tasks.
+       */
+      bool internal_hasTasks (void) const ;
+
+      void workerFunction (std::uint32_t worker);
+  };
+
+}
+
+arcana::virgil::SharedExecutor & arcana::virgil::SharedExecutor::instance (void){
+  static SharedExecutor executor{};
+
+  return executor;
+}
+
+arcana::virgil::SharedExecutor::SharedExecutor (const std::uint32_t numThreads, const WorkerConfiguration &configuration){
+  pthread_spin_init(&this->clientsLock, 0);
+
+  /*
+   * Start the workers.
+   * If one cannot be created, the ones that already run are stopped before reporting the error.
+   */
+  auto threads = std::max<std::uint32_t>(numThreads, 1);
+  try {
+    for (std::uint32_t i = 0; i < threads; i++){
+      auto name = configuration.namePrefix + "-shared-" + std::to_string(i);
+      this->workers.emplace_back(configuration, name, [this, i](void){ this->workerFunction(i); });
+    }
+  } catch (...){
+    this->done.store(true, std::memory_order_seq_cst);
+    this->workAvailable.notifyAll();
+    for (auto &worker : this->workers){
+      worker.join();
+    }
+    pthread_spin_destroy(&this->clientsLock);
+    throw ;
+  }
+
+  return ;
+}
+
+std::uint32_t arcana::virgil::SharedExecutor::numberOfThreads (void) const {
+  return this->workers.size();
+}
+
+void arcana::virgil::SharedExecutor::attach (Client *client){
+  pthread_spin_lock(&this->clientsLock);
+  this->clients.push_back(client);
+  pthread_spin_unlock(&this->clientsLock);
+
+  /*
+   * The client might have tasks already.
+   */
+  this->notify(this->workers.size());
+
+  return ;
+}
+
+void arcana::virgil::SharedExecutor::detach (Client *client){
+  pthread_spin_lock(&this->clientsLock);
+  this->clients.erase(std::remove(this->clients.begin(), this->clients.end(), client), this->clients.end());
+  pthread_spin_unlock(&this->clientsLock);
+
+  /*
+   * Workers become runners of a client only while holding the lock, so no new runner can show up.
+   */
+  while (client->runners.load(std::memory_order_acquire) != 0){
+    std::this_thread::yield();
+  }
+
+  return ;
+}
+
+void arcana::virgil::SharedExecutor::notify (std::uint64_t tasks){
+
+  /*
+   * The notification costs a single load unless a worker sleeps.
+   */
+  if (tasks == 1){
+    this->workAvailable.notify();
+  } else if (tasks > 1){
+    this->workAvailable.notifyAll();
+  }
+
+  return ;
+}
+
+arcana::virgil::SharedExecutor::~SharedExecutor (void){
+  this->done.store(true, std::memory_order_seq_cst);
+  this->workAvailable.notifyAll();
+  for (auto &worker : this->workers){
+    worker.join();
+  }
+  pthread_spin_destroy(&this->clientsLock);
+
+  return ;
+}
+
+arcana::virgil::SharedExecutor::Client * arcana::virgil::SharedExecutor::internal_nextClient (void){
+  Client *client = nullptr;
+
+  pthread_spin_lock(&this->clientsLock);
+  auto numberOfClients = this->clients.size();
+  for (std::uint64_t i = 0; i < numberOfClients; i++){
+    auto candidate = this->clients[(this->nextClient + i) % numberOfClients];
+    if (candidate->hasTasks()){
+      candidate->runners.fetch_add(1, std::memory_order_relaxed);
+      this->nextClient += i + 1;
+      client = candidate;
+      break ;
+    }
+  }
+  pthread_spin_unlock(&this->clientsLock);
+
+  return client;
+}
+
+bool arcana::virgil::SharedExecutor::internal_hasTasks (void) const {
+  auto hasTasks = false;
+
+  pthread_spin_lock(&this->clientsLock);
+  for (auto client : this->clients){
+    if (client->hasTasks()){
+      hasTasks = true;
+      break ;
+    }
+  }
+  pthread_spin_unlock(&this->clientsLock);
+
+  return hasTasks;
+}
+
+void arcana::virgil::SharedExecutor::workerFunction (std::uint32_t worker){
+  while (!this->done.load(std::memory_order_acquire)){
+
+    /*
+     * Run a task of the next client that has some.
+     */
+    auto client = this->internal_nextClient();
+    if (client != nullptr){
+      client->runTask(worker);
+      client->runners.fetch_sub(1, std::memory_order_release);
+      continue ;
+    }
+
+    /*
+     * Sleep until a client receives a task.
+     * Clients are checked again after announcing the wait, so a task submitted in between is not missed.
+     */
+    auto key = this->workAvailable.prepareWait();
+    if (  this->done.load(std::memory_order_seq_cst)
+          || this->internal_hasTasks()
+       ){
+      this->workAvailable.cancelWait();
+      continue ;
+    }
+    this->workAvailable.wait(key);
+  }
+
+  return ;
+}
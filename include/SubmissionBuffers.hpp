@@ -0,0 +1,314 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The SubmissionBuffers class.
+ * Gives every producer thread its own buffer of values in front of a shared queue, so producers do not contend on the queue for every value.
+ *
+ * A buffer is published to the queue with a single pushBulk when it holds batchSize values, when its producer calls flush(), or when a timer thread finds it non-empty.
+ * The timer sleeps while all buffers are empty, so it costs nothing to idle producers.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "ThreadSafeQueue.hpp"
+#include "EventCount.hpp"
+
+namespace arcana::virgil {
+
+  template <typename T>
+  class SubmissionBuffers {
+    public:
+
+      /*
+       * Constructor.
+       * Values pushed to the buffers reach @queue in batches of @batchSize values, or after at most about @flushInterval.
+       */
+      SubmissionBuffers (ThreadSafeQueue<T> &queue, std::uint32_t batchSize, std::chrono::microseconds flushInterval);
+
+      /*
+       * Append a value to the buffer of the calling thread.
+       */
+      void push (T value);
+
+      /*
+       * Publish the buffer of the calling thread to the queue.
+       */
+      void flush (void);
+
+      /*
+       * Publish all buffers to the queue.
+       */
+      void flushAll (void);
+
+      /*
+       * Destructor.
+       * The values left in the buffers are published to the queue.
+       */
+      ~SubmissionBuffers (void);
+
+      /*
+       * Not copyable.
+       */
+      SubmissionBuffers (const SubmissionBuffers & other) = delete;
+      SubmissionBuffers & operator= (const SubmissionBuffers & other) = delete;
+
+    private:
+
+      /*
+       * The buffer of a producer.
+       * The lock is contended only when the timer flushes the buffer.
+       */
+      struct alignas(64) Buffer {
+        std::mutex lock;
+        std::vector<T> values;
+      };
+
+      /*
+       * Fields.
+       */
+      ThreadSafeQueue<T> &queue;
+      std::uint64_t identifier;
+      std::uint32_t batchSize;
+      std::chrono::microseconds flushInterval;
+      std::mutex buffersLock;
+      std::vector<std::unique_ptr<Buffer>> buffers;
+      alignas(64) std::atomic_bool pending{false};
+      std::atomic_bool stop{false};
+      EventCount timerEvent;
+      std::thread timer;
+
+      /*
+       * Identifiers of the instances alive, and number of instances destroyed so far.
+       * Producers use them to prune the buffers of destroyed instances from their cache.
+       */
+      inline static std::mutex instancesLock;
+      inline static std::unordered_set<std::uint64_t> liveInstances;
+      inline static std::atomic<std::uint64_t> destroyedInstances{0};
+
+      /*
+       * Methods.
+       */
+      Buffer * threadBuffer (void);
+      void publish (Buffer *buffer);
+      void timerFunction (void);
+      static std::uint64_t newIdentifier (void);
+  };
+
+}
+
+template <typename T>
+arcana::virgil::SubmissionBuffers<T>::SubmissionBuffers (ThreadSafeQueue<T> &queue, std::uint32_t batchSize, std::chrono::microseconds flushInterval)
+  : queue{queue}
+  , identifier{newIdentifier()}
+  , batchSize{std::max<std::uint32_t>(batchSize, 1)}
+  , flushInterval{flushInterval}
+  {
+
+  /*
+   * Register the instance.
+   */
+  {
+    std::lock_guard<std::mutex> lock{instancesLock};
+    liveInstances.insert(this->identifier);
+  }
+
+  /*
+   * Start the timer.
+   */
+  this->timer = std::thread{&SubmissionBuffers::timerFunction, this};
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::SubmissionBuffers<T>::push (T value){
+  auto buffer = this->threadBuffer();
+
+  std::lock_guard<std::mutex> lock{buffer->lock};
+  buffer->values.push_back(std::move(value));
+  if (buffer->values.size() >= this->batchSize){
+    this->publish(buffer);
+    return ;
+  }
+
+  /*
+   * Wake up the timer if this is the first value buffered since its last round.
+   * The buffer lock is still held, so the timer cannot miss the value if it clears pending concurrently.
+   */
+  if (  (buffer->values.size() == 1)
+        && (!this->pending.load(std::memory_order_seq_cst))
+     ){
+    this->pending.store(true, std::memory_order_seq_cst);
+    this->timerEvent.notify();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::SubmissionBuffers<T>::flush (void){
+  auto buffer = this->threadBuffer();
+
+  std::lock_guard<std::mutex> lock{buffer->lock};
+  this->publish(buffer);
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::SubmissionBuffers<T>::flushAll (void){
+  std::lock_guard<std::mutex> buffersLock{this->buffersLock};
+  for (auto &buffer : this->buffers){
+    std::lock_guard<std::mutex> lock{buffer->lock};
+    this->publish(buffer.get());
+  }
+
+  return ;
+}
+
+template <typename T>
+arcana::virgil::SubmissionBuffers<T>::~SubmissionBuffers (void){
+
+  /*
+   * Stop the timer, which flushes the buffers one last time.
+   */
+  this->stop = true;
+  this->timerEvent.notifyAll();
+  this->timer.join();
+
+  /*
+   * Let producers drop their buffers of this instance from their cache.
+   */
+  std::lock_guard<std::mutex> lock{instancesLock};
+  liveInstances.erase(this->identifier);
+  destroyedInstances.fetch_add(1, std::memory_order_release);
+
+  return ;
+}
+
+template <typename T>
+typename arcana::virgil::SubmissionBuffers<T>::Buffer * arcana::virgil::SubmissionBuffers<T>::threadBuffer (void){
+
+  /*
+   * Identifiers are never reused, so the entries of destroyed instances are never found again.
+   * They are pruned when the thread allocates a new buffer, so a thread that submits to many short-lived pools does not accumulate them.
+   */
+  static thread_local std::unordered_map<std::uint64_t, Buffer *> threadBuffers;
+  static thread_local std::uint64_t lastIdentifier = 0;
+  static thread_local Buffer *lastBuffer = nullptr;
+  static thread_local std::uint64_t destroyedInstancesWhenPruned = 0;
+
+  /*
+   * Fast path: the calling thread pushed to this instance last time.
+   */
+  if (lastIdentifier == this->identifier){
+    return lastBuffer;
+  }
+
+  /*
+   * Prune the entries of the instances destroyed since the last allocation of a buffer.
+   */
+  auto found = threadBuffers.find(this->identifier);
+  auto destroyed = destroyedInstances.load(std::memory_order_acquire);
+  if (  (found == threadBuffers.end())
+        && (destroyed != destroyedInstancesWhenPruned)
+     ){
+    std::lock_guard<std::mutex> lock{instancesLock};
+    for (auto entry = threadBuffers.begin(); entry != threadBuffers.end(); ){
+      if (liveInstances.count(entry->first) == 0){
+        entry = threadBuffers.erase(entry);
+      } else {
+        entry++;
+      }
+    }
+    destroyedInstancesWhenPruned = destroyed;
+  }
+
+  /*
+   * Fetch or allocate the buffer of the calling thread.
+   */
+  auto &buffer = threadBuffers[this->identifier];
+  if (buffer == nullptr){
+    auto newBuffer = std::make_unique<Buffer>();
+    newBuffer->values.reserve(this->batchSize);
+    buffer = newBuffer.get();
+    std::lock_guard<std::mutex> lock{this->buffersLock};
+    this->buffers.push_back(std::move(newBuffer));
+  }
+  lastIdentifier = this->identifier;
+  lastBuffer = buffer;
+
+  return buffer;
+}
+
+template <typename T>
+void arcana::virgil::SubmissionBuffers<T>::publish (Buffer *buffer){
+  if (buffer->values.empty()){
+    return ;
+  }
+
+  /*
+   * The whole batch reaches the queue with a single synchronization.
+   */
+  auto first = buffer->values.data();
+  this->queue.pushBulk(first, first + buffer->values.size());
+  buffer->values.clear();
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::SubmissionBuffers<T>::timerFunction (void){
+  while (!this->stop){
+
+    /*
+     * Sleep until a producer buffers a value.
+     */
+    auto key = this->timerEvent.prepareWait();
+    if (  (!this->pending.load(std::memory_order_seq_cst))
+          && (!this->stop)
+       ){
+      this->timerEvent.wait(key);
+      continue ;
+    }
+    this->timerEvent.cancelWait();
+
+    /*
+     * Give producers the time to fill their buffers, and then publish whatever they hold.
+     */
+    if (!this->stop){
+      std::this_thread::sleep_for(this->flushInterval);
+    }
+    this->pending.store(false, std::memory_order_seq_cst);
+    this->flushAll();
+  }
+  this->flushAll();
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::SubmissionBuffers<T>::newIdentifier (void){
+  static std::atomic<std::uint64_t> nextIdentifier{1};
+
+  return nextIdentifier.fetch_add(1, std::memory_order_relaxed);
+}
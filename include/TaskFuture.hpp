@@ -14,8 +14,13 @@
 #pragma once
 
 #include <future>
+#include <memory>
+
+#include "BuildConfiguration.hpp"
+#include "LatencyHistogram.hpp"
 
 namespace arcana::virgil {
+inline namespace VIRGIL_BUILD_NAMESPACE {
 
   /*
    * A wrapper around a std::future that adds the behavior of futures returned from std::async.
@@ -24,8 +29,17 @@ namespace arcana::virgil {
   template <typename T>
   class TaskFuture {
     public:
-      TaskFuture(std::future<T>&& future)
+
+      /*
+       * Constructor.
+       * If VIRGIL_LATENCY_HISTOGRAMS is defined and @waitHistogram is not nullptr, the time spent in get() is recorded in @waitHistogram.
+       * The future shares the ownership of @waitHistogram, so it can outlive the thread pool that owns the histogram.
+       */
+      TaskFuture(std::future<T>&& future, std::shared_ptr<LatencyHistogram> waitHistogram = nullptr)
         :m_future{std::move(future)}
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+        ,m_waitHistogram{std::move(waitHistogram)}
+#endif
         {
         return ;
       }
@@ -52,12 +66,26 @@ namespace arcana::virgil {
         return ;
       }
 
+      /*
+       * Check whether or not the future refers to a task (e.g., it does not when the thread pool rejected the task).
+       */
+      bool valid(void) const {
+        return m_future.valid();
+      }
+
       auto get(void) {
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+        LatencyHistogram::ScopedRecorder recorder{m_waitHistogram.get()};
+#endif
         return m_future.get();
       }
 
     private:
       std::future<T> m_future;
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+      std::shared_ptr<LatencyHistogram> m_waitHistogram;
+#endif
   };
 
 }
+}
@@ -13,177 +13,194 @@
  */
 #pragma once
 
-#include <sched.h>
-#include <pthread.h>
-#include <iostream>
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <cstdint>
 
 #include <ThreadTask.hpp>
+#include "IntrusiveQueue.hpp"
+#include "virgil_task.h"
 
 namespace arcana::virgil {
 
   /*
-   * An implementation of the thread task interface for C functions
+   * Operations the pools perform on the descriptors of C tasks.
    */
-  class ThreadCTask: public IThreadTask {
+  class CTaskDescriptor {
     public:
 
       /*
-       * Constructors.
+       * Prepare @task to be enqueued: mark it pending, and remember and trace the time it has been submitted.
        */
-      ThreadCTask (
-        uint64_t ID
-        );
+      static void markSubmission (virgil_task_t *task);
 
-      ThreadCTask (
-        uint64_t ID,
-        void (*f) (void *args),
-        void *args
-        );
+      /*
+       * Run the task.
+       */
+      static void execute (virgil_task_t *task);
+
+      /*
+       * Mark the task as completed, after which its descriptor belongs to its owner again.
+       */
+      static void complete (virgil_task_t *task);
+
+      /*
+       * Return what identifies the kind of the task when hardware performance counters are attributed to tasks.
+       */
+      static TaskProfilingKey getProfilingKey (const virgil_task_t *task);
+  };
+
+  /*
+   * Descriptors link themselves into the queues of the pools through their first field.
+   */
+  template <>
+  struct IntrusiveQueueTraits<virgil_task_t> {
+    static_assert(sizeof(IntrusiveQueueNode) == sizeof(void *), "the link of a descriptor must hold a node");
+    static_assert(offsetof(virgil_task_t, link) == 0, "the link must be the first field of a descriptor");
+    static_assert(offsetof(virgil_task_t, inline_args) == 32, "the fields used to run a task must fit in 32 bytes");
+
+    static IntrusiveQueueNode * node (virgil_task_t *task) {
+      return reinterpret_cast<IntrusiveQueueNode *>(&task->link);
+    }
+
+    static virgil_task_t * object (IntrusiveQueueNode *node) {
+      return reinterpret_cast<virgil_task_t *>(node);
+    }
+  };
+
+  /*
+   * A C task owned by a pool.
+   * Pools recycle these tasks and enqueue their descriptors, so submitting them does not allocate.
+   *
+   * The state of the descriptor tells whether or not the task is in use: the pool marks it pending when it takes the task, and the worker marks it done when the task completes.
+   * Workers run the descriptor itself (see CTaskDescriptor::execute), so the task holds nothing else.
+   */
+  class ThreadCTask {
+    public:
+
+      /*
+       * Constructors.
+       * The new task is in use.
+       */
+      ThreadCTask (void);
 
       ThreadCTask (
-        uint64_t ID,
-        cpu_set_t coresToUse, 
         void (*f) (void *args),
         void *args
         );
 
       /*
-       * Default moving operation.
-       */
-      ThreadCTask (ThreadCTask&& other) = default;
-      ThreadCTask& operator= (ThreadCTask&& other) = default;
-
-      /*
-       * Not copyable.
+       * Not copyable nor movable, as queues link its descriptor.
        */
       ThreadCTask (const ThreadCTask& rhs) = delete;
       ThreadCTask& operator= (const ThreadCTask& rhs) = delete;
 
+      void setFunction (void (*f) (void *args), void *args);
+
       /*
-       * Default deconstructor.
+       * Set the task to run f on a copy of the @size bytes at @argbytes, which must fit in the descriptor.
        */
-      ~ThreadCTask(void) override = default;
+      void setInlineFunction (void (*f) (void *args), const void *argbytes, std::uint64_t size);
 
       /*
-       * Run the task.
+       * Return the descriptor the pools enqueue for this task.
        */
-      void execute (void) override ;
+      virgil_task_t * getDescriptor (void);
 
-      std::uint64_t getID (void) const ;
-
-      void setFunction (void (*f) (void *args), void *args);
-
-      bool getAvailability();
-      void setAvailable();
+      /*
+       * Take the task if it is not in use.
+       * Returns true if the task has been taken.
+       */
+      bool getAvailability (void);
 
     private:
-      void (*m_func) (void *args);
-      void *args;
-      cpu_set_t cores;
-      bool useAffinity;
-      bool available;
-      uint64_t ID;
-      mutable pthread_spinlock_t availabilityLock;
+      virgil_task_t descriptor;
   };
 
 }
 
-arcana::virgil::ThreadCTask::ThreadCTask (uint64_t ID)
-  : useAffinity{false}
-  , ID{ID}
-  , available{false}
+arcana::virgil::ThreadCTask::ThreadCTask (void)
+  : ThreadCTask{nullptr, nullptr}
 {
-  pthread_spin_init(&this->availabilityLock, 0);
   return ;
 }
 
 arcana::virgil::ThreadCTask::ThreadCTask (
-  uint64_t ID,
   void (*f) (void *args),
   void *args
   )
-  :
-    m_func{f}
-  , args{args}
-  , useAffinity{false}
-  , ID{ID}
-  , available{false}
   {
+  virgil_task_init(&this->descriptor, f, args);
+  this->descriptor.state = VIRGIL_TASK_PENDING;
 
-  pthread_spin_init(&this->availabilityLock, 0);
   return ;
 }
 
-arcana::virgil::ThreadCTask::ThreadCTask (
-  uint64_t ID,
-  cpu_set_t coresToUse, 
-  void (*f) (void *args),
-  void *args
-  )
-  :
-  m_func{f},
-  args{args},
-  cores{coresToUse},
-  useAffinity{true}
-  , ID{ID}
-  , available{false}
-  {
-  pthread_spin_init(&this->availabilityLock, 0);
-  return ;
-}
-
-void arcana::virgil::ThreadCTask::execute (void){
+bool arcana::virgil::ThreadCTask::getAvailability (void){
 
   /*
-   * Check if we have been asked to set the affinity of the thread that will run the task.
+   * Avoid the read-modify-write while the task is in use.
    */
-  if (this->useAffinity){
-
-    /*
-     * Set the thread affinity.
-     */
-    auto self = pthread_self();
-    auto exitCode = pthread_setaffinity_np(self, sizeof(cpu_set_t), &(this->cores));
-    if (exitCode != 0) {
-      std::cerr << "ThreadPool: Error calling pthread_setaffinity_np: " << exitCode << std::endl;
-      abort();
-    }
+  if (__atomic_load_n(&this->descriptor.state, __ATOMIC_RELAXED) != VIRGIL_TASK_DONE){
+    return false;
   }
+  std::uint32_t done = VIRGIL_TASK_DONE;
 
-  /*
-   * Run
-   */
-  (*this->m_func)(this->args);
+  return __atomic_compare_exchange_n(&this->descriptor.state, &done, VIRGIL_TASK_PENDING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void arcana::virgil::ThreadCTask::setFunction (void (*f) (void *args), void *args){
+  this->descriptor.function = f;
+  this->descriptor.args = args;
+  this->descriptor.flags = 0;
 
   return ;
 }
 
-bool arcana::virgil::ThreadCTask::getAvailability() {
-  auto ret = false;
-
-  if(available) {
-    pthread_spin_lock(&this->availabilityLock);
-    if(available) {
-      available = false;
-      ret = true;
-    }
-    pthread_spin_unlock(&this->availabilityLock);
+void arcana::virgil::ThreadCTask::setInlineFunction (void (*f) (void *args), const void *argbytes, std::uint64_t size){
+  assert(size <= VIRGIL_TASK_INLINE_ARGUMENT_BYTES);
+  this->descriptor.function = f;
+  this->descriptor.args = nullptr;
+  this->descriptor.flags = VIRGIL_TASK_FLAG_INLINE_ARGUMENTS;
+  if (size > 0){
+    memcpy(this->descriptor.inline_args, argbytes, size);
   }
 
-  return ret;
+  return ;
 }
 
-void arcana::virgil::ThreadCTask::setAvailable() {
-  pthread_spin_lock(&this->availabilityLock);
-  available = true;
-  pthread_spin_unlock(&this->availabilityLock);
+virgil_task_t * arcana::virgil::ThreadCTask::getDescriptor (void){
+  return &this->descriptor;
 }
 
-std::uint64_t arcana::virgil::ThreadCTask::getID (void) const {
-  return this->ID;
+inline void arcana::virgil::CTaskDescriptor::markSubmission (virgil_task_t *task){
+  task->state = VIRGIL_TASK_PENDING;
+#if defined(VIRGIL_STATISTICS) || defined(VIRGIL_LATENCY_HISTOGRAMS)
+  task->submission_time = TimestampCounter::nanoseconds();
+#endif
+  Tracer::record(TRACE_SUBMIT, task);
+
+  return ;
 }
-      
-void arcana::virgil::ThreadCTask::setFunction (void (*f) (void *args), void *args){
-  this->m_func = f;
-  this->args = args;
+
+inline void arcana::virgil::CTaskDescriptor::execute (virgil_task_t *task){
+  auto args = ((task->flags & VIRGIL_TASK_FLAG_INLINE_ARGUMENTS) != 0) ? static_cast<void *>(task->inline_args) : task->args;
+  (*task->function)(args);
+
+  return ;
+}
+
+inline void arcana::virgil::CTaskDescriptor::complete (virgil_task_t *task){
+
+  /*
+   * Hand the descriptor back to its owner: the caller, or the pool that recycles it.
+   */
+  __atomic_store_n(&task->state, VIRGIL_TASK_DONE, __ATOMIC_RELEASE);
+
+  return ;
+}
+
+inline arcana::virgil::TaskProfilingKey arcana::virgil::CTaskDescriptor::getProfilingKey (const virgil_task_t *task){
+  return TaskProfilingKey::of(task->function);
 }
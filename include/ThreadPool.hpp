@@ -15,15 +15,19 @@
 #pragma once
 
 #include "ThreadSafeMutexQueue.hpp"
+#include "SubmissionBuffers.hpp"
 #include "ThreadTask.hpp"
 #include "TaskFuture.hpp"
 #include "ThreadPoolInterface.hpp"
+#include "ParallelReduction.hpp"
 
 #include <unistd.h>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <thread>
 #include <type_traits>
@@ -32,6 +36,27 @@
 
 namespace arcana::virgil {
 
+  /*
+   * What a submission does when the queue of the thread pool already holds its maximum number of tasks.
+   */
+  enum class SaturationPolicy {
+
+    /*
+     * Wait until the queue has room.
+     */
+    Block,
+
+    /*
+     * Drop the task: the returned future is not valid, and submitAndDetach returns false.
+     */
+    Reject,
+
+    /*
+     * Run the task on the thread that submits it.
+     */
+    CallerRuns
+  };
+
   /*
    * Thread pool.
    */
@@ -50,11 +75,21 @@ namespace arcana::virgil {
        */
       explicit ThreadPool (
         const bool extendible,
-        const std::uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1u,
+        const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(),
+        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr,
+        const WorkerConfiguration &configuration = WorkerConfiguration{});
+
+      /*
+       * Constructor of a thread pool that runs its tasks on the workers of @executor (e.g., SharedExecutor::instance()) rather than on its own threads.
+       * The pool keeps its own queue, saturation policy, and statistics.
+       */
+      explicit ThreadPool (
+        SharedExecutor &executor,
         std::function <void (void)> codeToExecuteAtDeconstructor = nullptr);
 
       /*
        * Submit a job to be run by the thread pool.
+       * If the job has been rejected because the pool is saturated, the returned future is not valid.
        */
       template <typename Func, typename... Args>
       auto submit (Func&& func, Args&&... args);
@@ -73,9 +108,65 @@ namespace arcana::virgil {
 
       /*
        * Submit a job to be run by the thread pool and detach it from the caller.
+       * Returns false if the job has been rejected because the pool is saturated.
        */
       template <typename Func, typename... Args>
-      void submitAndDetach (Func&& func, Args&&... args) ;
+      bool submitAndDetach (Func&& func, Args&&... args) ;
+
+      /*
+       * Return the combination through @combine of map(i) for every i in [@first, @last).
+       * @combine must be associative and commutative, and @identity must be neutral for it.
+       * Every chunk of the iteration space (or every participant, see ReductionMode) accumulates into its own cache line, and the partial results are combined by a tree.
+       * The calling thread runs chunks too, so this can be invoked by a task of the pool.
+       */
+      template <typename T, typename Map, typename Combine>
+      T parallelReduce (std::int64_t first, std::int64_t last, T identity, Map map, Combine combine, ReductionMode mode = ReductionMode::Fast);
+
+      /*
+       * Write to @output the combinations through @combine of the elements of [@first, @last) up to and including each of them, as std::inclusive_scan does.
+       * @combine must be associative. @output can be @first. Both the input and the output must be random access iterators.
+       * Returns the end of the output.
+       */
+      template <typename RandomIt1, typename RandomIt2, typename Combine>
+      RandomIt2 parallelInclusiveScan (RandomIt1 first, RandomIt1 last, RandomIt2 output, Combine combine, ReductionMode mode = ReductionMode::Fast);
+
+      /*
+       * Write to @output the combinations through @combine of @init and the elements of [@first, @last) that precede each of them, as std::exclusive_scan does.
+       * @combine must be associative. @output can be @first. Both the input and the output must be random access iterators.
+       * Returns the end of the output.
+       */
+      template <typename RandomIt1, typename RandomIt2, typename T, typename Combine>
+      RandomIt2 parallelExclusiveScan (RandomIt1 first, RandomIt1 last, RandomIt2 output, T init, Combine combine, ReductionMode mode = ReductionMode::Fast);
+
+      /*
+       * Bound the number of tasks waiting in the queue of the pool to @maximumQueueDepth (0 means unbounded, which is the default).
+       * @policy decides what a submission does when the queue is full.
+       * Tasks pinned to cores (submitToCores and submitToCore) cannot run on the caller, so they block when the policy is CallerRuns.
+       */
+      void setSaturationPolicy (std::uint64_t maximumQueueDepth, SaturationPolicy policy);
+
+      /*
+       * Return the maximum number of tasks waiting in the queue (0 means unbounded).
+       */
+      std::uint64_t getMaximumQueueDepth (void) const ;
+
+      /*
+       * Return what a submission does when the queue is full.
+       */
+      SaturationPolicy getSaturationPolicy (void) const ;
+
+      /*
+       * Let every submitting thread buffer its tasks and publish them to the queue of the pool @batchSize at a time, so submitters do not contend on the queue for every task.
+       * A buffer is also published when its thread calls flush(), and at most about @flushInterval after its first task.
+       * Tasks are buffered only while the queue of the pool is unbounded (see setSaturationPolicy).
+       * This must be called before submitting tasks, and only by pools that have their own threads.
+       */
+      void enableSubmissionBuffers (std::uint32_t batchSize = 64, std::chrono::microseconds flushInterval = std::chrono::microseconds{100});
+
+      /*
+       * Publish the tasks buffered by the calling thread to the queue of the pool.
+       */
+      void flush (void);
 
       /*
        * Return the number of tasks that did not start executing yet.
@@ -103,11 +194,43 @@ namespace arcana::virgil {
        * Object fields.
        */
       ThreadSafeMutexQueue<std::unique_ptr<IThreadTask>> m_workQueue;
+      std::atomic<std::uint64_t> m_maximumQueueDepth{0};
+      std::atomic<SaturationPolicy> m_saturationPolicy{SaturationPolicy::Block};
+      std::unique_ptr<SubmissionBuffers<std::unique_ptr<IThreadTask>>> m_submissionBuffers;
+
+      /*
+       * Push @task to the queue following the saturation policy of the pool.
+       * Returns false if the task has been rejected, true if it has been queued or executed by the caller.
+       */
+      bool enqueue (std::unique_ptr<IThreadTask> &task, bool canRunOnCaller);
+
+      /*
+       * Return the number of workers that can run the chunks of a parallel reduction or scan.
+       */
+      std::uint32_t internal_numberOfWorkers (void) const ;
+
+      /*
+       * Run body(participant, chunk) for every chunk in [0, @chunks) on the calling thread and on up to @helpers workers of the pool, and wait for them.
+       * participant is in [0, @helpers].
+       */
+      template <typename Body>
+      void internal_parallelFor (std::uint64_t chunks, std::uint32_t helpers, Body body);
+
+      /*
+       * Implementation of parallelInclusiveScan (@init is nullptr) and of parallelExclusiveScan.
+       */
+      template <typename T, typename RandomIt1, typename RandomIt2, typename Combine>
+      RandomIt2 internal_parallelScan (RandomIt1 first, RandomIt1 last, RandomIt2 output, const T *init, Combine &combine, ReductionMode mode);
 
       /*
        * Constantly running function each thread uses to acquire work items from the queue.
        */
       void workerFunction (std::atomic_bool *availability, std::uint32_t thread) override ;
+
+      /*
+       * Run a task of the queue on a worker of the executor.
+       */
+      bool runQueuedTask (void) override ;
   };
 
 }
@@ -117,9 +240,9 @@ arcana::virgil::ThreadPool::ThreadPool(void)
   {
 
   /*
-   * Always create at least one thread.  If hardware_concurrency() returns 0,
-   * subtracting one would turn it to UINT_MAX, so get the maximum of
-   * hardware_concurrency() and 2 before subtracting 1.
+   * Always create at least one thread.  The default number of threads
+   * leaves one of the CPUs available to the process (see CPUBudget) to
+   * the thread that submits tasks, but it is never 0.
    */
 
   return ;
@@ -128,16 +251,18 @@ arcana::virgil::ThreadPool::ThreadPool(void)
 arcana::virgil::ThreadPool::ThreadPool (
   const bool extendible,
   const std::uint32_t numThreads,
-  std::function <void (void)> codeToExecuteAtDeconstructor)
+  std::function <void (void)> codeToExecuteAtDeconstructor,
+  const WorkerConfiguration &configuration)
   :
     m_workQueue{}
   {
+  this->configuration = configuration;
 
   /*
    * Start threads.
    */
   try {
-    this->newThreads(numThreads);
+    this->startThreads(numThreads);
 
   } catch(...) {
     throw;
@@ -146,12 +271,29 @@ arcana::virgil::ThreadPool::ThreadPool (
   return ;
 }
 
+arcana::virgil::ThreadPool::ThreadPool (
+  SharedExecutor &executor,
+  std::function <void (void)> codeToExecuteAtDeconstructor)
+  :
+    ThreadPoolInterface{executor, codeToExecuteAtDeconstructor}
+  , m_workQueue{}
+  {
+
+  /*
+   * Let the workers of the executor serve the queue.
+   */
+  this->attachToExecutor();
+
+  return ;
+}
+
 template <typename Func, typename... Args>
 auto arcana::virgil::ThreadPool::submit (Func&& func, Args&&... args){
 
   /*
    * Making the task.
    */
+  auto profilingKey = TaskProfilingKey::of(func);
   auto boundTask = std::bind(std::forward<Func>(func), std::forward<Args>(args)...);
   using ResultType = std::result_of_t<decltype(boundTask)()>;
   using PackagedTask = std::packaged_task<ResultType()>;
@@ -161,19 +303,28 @@ auto arcana::virgil::ThreadPool::submit (Func&& func, Args&&... args){
   /*
    * Create the future.
    */
-  TaskFuture<ResultType> result{task.get_future()};
+  auto future = task.get_future();
   
   /*
    * Submit the task.
    */
-  m_workQueue.push(std::make_unique<TaskType>(std::move(task)));
+  std::unique_ptr<IThreadTask> pTask = std::make_unique<TaskType>(std::move(task));
+  pTask->setProfilingKey(profilingKey);
+  pTask->markSubmission();
+  if (!this->enqueue(pTask, true)){
+
+    /*
+     * The task has been rejected: it will never set the future.
+     */
+    future = std::future<ResultType>{};
+  }
 
   /*
    * Expand the pool if possible and necessary.
    */
   this->expandPool();
 
-  return result;
+  return TaskFuture<ResultType>{std::move(future), this->futureWaitHistogram()};
 }
 
 template <typename Func, typename... Args>
@@ -182,6 +333,7 @@ auto arcana::virgil::ThreadPool::submitToCores (const cpu_set_t& cores, Func&& f
   /*
    * Making the task.
    */
+  auto profilingKey = TaskProfilingKey::of(func);
   auto boundTask = std::bind(std::forward<Func>(func), std::forward<Args>(args)...);
   using ResultType = std::result_of_t<decltype(boundTask)()>;
   using PackagedTask = std::packaged_task<ResultType()>;
@@ -191,19 +343,28 @@ auto arcana::virgil::ThreadPool::submitToCores (const cpu_set_t& cores, Func&& f
   /*
    * Create the future.
    */
-  TaskFuture<ResultType> result{task.get_future()};
+  auto future = task.get_future();
   
   /*
    * Submit the task.
    */
-  m_workQueue.push(std::make_unique<TaskType>(cores, std::move(task)));
+  std::unique_ptr<IThreadTask> pTask = std::make_unique<TaskType>(cores, std::move(task));
+  pTask->setProfilingKey(profilingKey);
+  pTask->markSubmission();
+  if (!this->enqueue(pTask, false)){
+
+    /*
+     * The task has been rejected: it will never set the future.
+     */
+    future = std::future<ResultType>{};
+  }
 
   /*
    * Expand the pool if possible and necessary.
    */
   this->expandPool();
 
-  return result;
+  return TaskFuture<ResultType>{std::move(future), this->futureWaitHistogram()};
 }
 
 template <typename Func, typename... Args>
@@ -212,6 +373,7 @@ auto arcana::virgil::ThreadPool::submitToCore (uint32_t core, Func&& func, Args&
   /*
    * Making the task.
    */
+  auto profilingKey = TaskProfilingKey::of(func);
   auto boundTask = std::bind(std::forward<Func>(func), std::forward<Args>(args)...);
   using ResultType = std::result_of_t<decltype(boundTask)()>;
   using PackagedTask = std::packaged_task<ResultType()>;
@@ -221,7 +383,7 @@ auto arcana::virgil::ThreadPool::submitToCore (uint32_t core, Func&& func, Args&
   /*
    * Create the future.
    */
-  TaskFuture<ResultType> result{task.get_future()};
+  auto future = task.get_future();
 
   /*
    * Set the affinity.
@@ -233,22 +395,32 @@ auto arcana::virgil::ThreadPool::submitToCore (uint32_t core, Func&& func, Args&
   /*
    * Submit the task.
    */
-  m_workQueue.push(std::make_unique<TaskType>(cores, std::move(task)));
+  std::unique_ptr<IThreadTask> pTask = std::make_unique<TaskType>(cores, std::move(task));
+  pTask->setProfilingKey(profilingKey);
+  pTask->markSubmission();
+  if (!this->enqueue(pTask, false)){
+
+    /*
+     * The task has been rejected: it will never set the future.
+     */
+    future = std::future<ResultType>{};
+  }
 
   /*
    * Expand the pool if possible and necessary.
    */
   this->expandPool();
 
-  return result;
+  return TaskFuture<ResultType>{std::move(future), this->futureWaitHistogram()};
 }
 
 template <typename Func, typename... Args>
-void arcana::virgil::ThreadPool::submitAndDetach (Func&& func, Args&&... args){
+bool arcana::virgil::ThreadPool::submitAndDetach (Func&& func, Args&&... args){
 
   /*
    * Making the task.
    */
+  auto profilingKey = TaskProfilingKey::of(func);
   auto boundTask = std::bind(std::forward<Func>(func), std::forward<Args>(args)...);
   using ResultType = std::result_of_t<decltype(boundTask)()>;
   using PackagedTask = std::packaged_task<ResultType()>;
@@ -258,29 +430,307 @@ void arcana::virgil::ThreadPool::submitAndDetach (Func&& func, Args&&... args){
   /*
    * Submit the task.
    */
-  m_workQueue.push(std::make_unique<TaskType>(std::move(task)));
+  std::unique_ptr<IThreadTask> pTask = std::make_unique<TaskType>(std::move(task));
+  pTask->setProfilingKey(profilingKey);
+  pTask->markSubmission();
+  auto submitted = this->enqueue(pTask, true);
 
   /*
    * Expand the pool if possible and necessary.
    */
   this->expandPool();
 
+  return submitted;
+}
+
+template <typename T, typename Map, typename Combine>
+T arcana::virgil::ThreadPool::parallelReduce (std::int64_t first, std::int64_t last, T identity, Map map, Combine combine, ReductionMode mode){
+  if (last <= first){
+    return identity;
+  }
+
+  /*
+   * Split the iteration space.
+   */
+  std::uint64_t elements = last - first;
+  auto workers = this->internal_numberOfWorkers();
+  auto chunks = Reduction::numberOfChunks(elements, workers, mode);
+  auto helpers = static_cast<std::uint32_t>(std::min<std::uint64_t>(chunks - 1, workers));
+
+  /*
+   * Fast reductions keep an accumulator per participant, which combines the chunks it grabs in whatever order they come.
+   * Deterministic reductions keep an accumulator per chunk, so the order of the combinations does not depend on the scheduling.
+   */
+  auto accumulators = (mode == ReductionMode::Fast) ? (helpers + 1) : chunks;
+  std::vector<PaddedAccumulator<T>> partials(accumulators, PaddedAccumulator<T>{identity});
+  this->internal_parallelFor(chunks, helpers, [&](std::uint32_t participant, std::uint64_t chunk){
+    auto begin = first + static_cast<std::int64_t>(Reduction::chunkBegin(elements, chunks, chunk));
+    auto end = first + static_cast<std::int64_t>(Reduction::chunkBegin(elements, chunks, chunk + 1));
+    auto value = Reduction::accumulate(begin, end, identity, map, combine);
+    if (mode == ReductionMode::Fast){
+      partials[participant].value = combine(partials[participant].value, value);
+    } else {
+      partials[chunk].value = value;
+    }
+  });
+
+  /*
+   * Combine the partial results.
+   */
+  auto result = Reduction::combineTree(partials, combine);
+
+  return result;
+}
+
+template <typename RandomIt1, typename RandomIt2, typename Combine>
+RandomIt2 arcana::virgil::ThreadPool::parallelInclusiveScan (RandomIt1 first, RandomIt1 last, RandomIt2 output, Combine combine, ReductionMode mode){
+  using T = typename std::iterator_traits<RandomIt1>::value_type;
+
+  return this->internal_parallelScan<T>(first, last, output, nullptr, combine, mode);
+}
+
+template <typename RandomIt1, typename RandomIt2, typename T, typename Combine>
+RandomIt2 arcana::virgil::ThreadPool::parallelExclusiveScan (RandomIt1 first, RandomIt1 last, RandomIt2 output, T init, Combine combine, ReductionMode mode){
+  return this->internal_parallelScan<T>(first, last, output, &init, combine, mode);
+}
+
+template <typename T, typename RandomIt1, typename RandomIt2, typename Combine>
+RandomIt2 arcana::virgil::ThreadPool::internal_parallelScan (RandomIt1 first, RandomIt1 last, RandomIt2 output, const T *init, Combine &combine, ReductionMode mode){
+  static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<RandomIt1>::iterator_category>, "parallel scans need random access input iterators");
+  static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<RandomIt2>::iterator_category>, "parallel scans need random access output iterators");
+  std::uint64_t elements = std::distance(first, last);
+  if (elements == 0){
+    return output;
+  }
+
+  /*
+   * Split the sequence.
+   */
+  auto workers = this->internal_numberOfWorkers();
+  auto chunks = Reduction::numberOfChunks(elements, workers, mode);
+  auto helpers = static_cast<std::uint32_t>(std::min<std::uint64_t>(chunks - 1, workers));
+  auto chunkBegin = [elements, chunks](std::uint64_t chunk){
+    return static_cast<std::ptrdiff_t>(Reduction::chunkBegin(elements, chunks, chunk));
+  };
+
+  /*
+   * Combine the elements of every chunk but the last one.
+   */
+  std::vector<PaddedAccumulator<T>> offsets(chunks, PaddedAccumulator<T>{static_cast<T>(*first)});
+  this->internal_parallelFor(chunks - 1, helpers, [&](std::uint32_t participant, std::uint64_t chunk){
+    auto end = chunkBegin(chunk + 1);
+    auto i = chunkBegin(chunk);
+    T value = first[i];
+    for (i++; i < end; i++){
+      value = combine(value, first[i]);
+    }
+    offsets[chunk + 1].value = value;
+  });
+
+  /*
+   * Turn the results of the chunks into the value that precedes every chunk.
+   * The first chunk of an inclusive scan has no such value.
+   */
+  std::uint64_t firstOffset = 1;
+  if (init != nullptr){
+    offsets[0].value = *init;
+    firstOffset = 0;
+  }
+  for (auto chunk = firstOffset + 1; chunk < chunks; chunk++){
+    offsets[chunk].value = combine(offsets[chunk - 1].value, offsets[chunk].value);
+  }
+
+  /*
+   * Scan every chunk starting from the value that precedes it.
+   * Elements are read before the output is written, so the scan can be done in place.
+   */
+  auto inclusive = (init == nullptr);
+  this->internal_parallelFor(chunks, helpers, [&](std::uint32_t participant, std::uint64_t chunk){
+    auto i = chunkBegin(chunk);
+    auto end = chunkBegin(chunk + 1);
+    T accumulator = offsets[chunk].value;
+    if (chunk < firstOffset){
+      accumulator = first[i];
+      output[i] = accumulator;
+      i++;
+    }
+    for (; i < end; i++){
+      T value = first[i];
+      if (inclusive){
+        accumulator = combine(accumulator, value);
+        output[i] = accumulator;
+      } else {
+        output[i] = accumulator;
+        accumulator = combine(accumulator, value);
+      }
+    }
+  });
+
+  return output + elements;
+}
+
+template <typename Body>
+void arcana::virgil::ThreadPool::internal_parallelFor (std::uint64_t chunks, std::uint32_t helpers, Body body){
+  if (chunks == 0){
+    return ;
+  }
+  auto loop = std::make_shared<ParallelChunks<Body>>(chunks, std::move(body));
+
+  /*
+   * Ask workers to help.
+   * A full bounded queue gets no helpers, so the caller never blocks on it; rejected helpers are fine too, because the caller runs the chunks nobody grabbed.
+   */
+  auto maximumQueueDepth = this->m_maximumQueueDepth.load(std::memory_order_relaxed);
+  for (std::uint32_t i = 0; i < helpers; i++){
+    if (  (maximumQueueDepth > 0)
+          && (this->numberOfTasksWaitingToBeProcessed() >= maximumQueueDepth)
+       ){
+      break ;
+    }
+    this->submitAndDetach([loop](void){ loop->run(); });
+  }
+  this->flush();
+
+  /*
+   * Run chunks on the calling thread, and wait for the ones grabbed by the helpers.
+   */
+  loop->run();
+  loop->wait();
+
   return ;
 }
 
+void arcana::virgil::ThreadPool::setSaturationPolicy (std::uint64_t maximumQueueDepth, SaturationPolicy policy){
+  this->m_saturationPolicy = policy;
+  this->m_maximumQueueDepth = maximumQueueDepth;
+
+  return ;
+}
+
+std::uint64_t arcana::virgil::ThreadPool::getMaximumQueueDepth (void) const {
+  return this->m_maximumQueueDepth;
+}
+
+arcana::virgil::SaturationPolicy arcana::virgil::ThreadPool::getSaturationPolicy (void) const {
+  return this->m_saturationPolicy;
+}
+
+bool arcana::virgil::ThreadPool::enqueue (std::unique_ptr<IThreadTask> &task, bool canRunOnCaller){
+
+  /*
+   * Unbounded queues never saturate.
+   */
+  auto maximumQueueDepth = static_cast<int64_t>(this->m_maximumQueueDepth.load(std::memory_order_relaxed));
+  if (maximumQueueDepth == 0){
+    if (this->m_submissionBuffers != nullptr){
+      this->m_submissionBuffers->push(std::move(task));
+    } else {
+      m_workQueue.push(std::move(task));
+      this->tasksSubmitted(1);
+    }
+    return true;
+  }
+
+  /*
+   * Handle a full queue.
+   */
+  auto policy = this->m_saturationPolicy.load(std::memory_order_relaxed);
+  if (  (policy == SaturationPolicy::CallerRuns)
+        && (!canRunOnCaller)
+     ){
+    policy = SaturationPolicy::Block;
+  }
+  auto pushed = false;
+  switch (policy){
+    case SaturationPolicy::Block:
+      pushed = m_workQueue.waitPush(std::move(task), maximumQueueDepth);
+      break ;
+
+    case SaturationPolicy::Reject:
+      pushed = m_workQueue.tryPush(task, maximumQueueDepth);
+      break ;
+
+    case SaturationPolicy::CallerRuns:
+      pushed = m_workQueue.tryPush(task, maximumQueueDepth);
+      if (!pushed){
+        task->execute();
+        return true;
+      }
+      break ;
+  }
+  if (pushed){
+    this->tasksSubmitted(1);
+  }
+
+  return pushed;
+}
+
 void arcana::virgil::ThreadPool::workerFunction (std::atomic_bool *availability, std::uint32_t thread) {
   while(!m_done) {
+    this->workerMayPause();
     (*availability) = true;
     std::unique_ptr<IThreadTask> pTask{nullptr};
+    this->workerWillWait();
     if(m_workQueue.waitPop(pTask)) {
-      (*availability) = false;
+      this->workerDidTakeTask(availability);
+      this->workerMayPause();
+      this->workerDidWakeUp(pTask.get());
+      this->workerWillExecute(pTask.get());
       pTask->execute();
+      this->workerDidExecute(pTask.get());
+    } else {
+      this->workerDidWakeUp(nullptr);
     }
   }
 
   return ;
 }
 
+bool arcana::virgil::ThreadPool::runQueuedTask (void){
+  std::unique_ptr<IThreadTask> pTask{nullptr};
+  this->workerWillWait();
+  if (!m_workQueue.tryPop(pTask)){
+    this->workerDidWakeUp(nullptr);
+    return false;
+  }
+  this->taskDequeued();
+  this->workerDidWakeUp(pTask.get());
+  this->workerWillExecute(pTask.get());
+  pTask->execute();
+  this->workerDidExecute(pTask.get());
+
+  return true;
+}
+
+void arcana::virgil::ThreadPool::enableSubmissionBuffers (std::uint32_t batchSize, std::chrono::microseconds flushInterval){
+
+  /*
+   * Buffers are published without waking up the workers of an executor.
+   */
+  assert(this->executor == nullptr);
+
+  this->m_submissionBuffers = std::make_unique<SubmissionBuffers<std::unique_ptr<IThreadTask>>>(m_workQueue, batchSize, flushInterval);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPool::flush (void){
+  if (this->m_submissionBuffers != nullptr){
+    this->m_submissionBuffers->flush();
+  }
+
+  return ;
+}
+
+std::uint32_t arcana::virgil::ThreadPool::internal_numberOfWorkers (void) const {
+  if (this->executor != nullptr){
+    return this->executor->numberOfThreads();
+  }
+  std::uint32_t workers = this->m_threads.size();
+
+  return workers;
+}
+
 std::uint64_t arcana::virgil::ThreadPool::numberOfTasksWaitingToBeProcessed (void) const {
   auto s = this->m_workQueue.size();
 
@@ -289,10 +739,17 @@ std::uint64_t arcana::virgil::ThreadPool::numberOfTasksWaitingToBeProcessed (voi
 
 arcana::virgil::ThreadPool::~ThreadPool (void){
 
+  /*
+   * Publish the buffered tasks.
+   */
+  this->m_submissionBuffers.reset();
+
   /*
    * Signal threads to quite.
    */
   m_done = true;
+  this->resume();
+  this->detachFromExecutor();
   m_workQueue.invalidate();
 
   /*
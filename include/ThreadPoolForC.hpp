@@ -54,7 +54,16 @@ namespace arcana::virgil {
        */
       explicit ThreadPoolForC (
         const bool extendible,
-        const std::uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1u,
+        const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(),
+        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr,
+        const WorkerConfiguration &configuration = WorkerConfiguration{}
+        );
+
+      /*
+       * Constructor of a thread pool that runs its tasks on the workers of @executor rather than on its own threads.
+       */
+      explicit ThreadPoolForC (
+        SharedExecutor &executor,
         std::function <void (void)> codeToExecuteAtDeconstructor = nullptr
         );
 
@@ -66,6 +75,23 @@ namespace arcana::virgil {
         void *args
         ) = 0;
 
+      /*
+       * Submit a task whose descriptor is owned by the caller and detach it from the caller.
+       * The pool uses the descriptor as is, so it neither allocates nor takes locks; the caller must not touch the descriptor until virgil_task_done(task) returns true.
+       */
+      virtual void submitAndDetach (virgil_task_t *task) = 0;
+
+      /*
+       * Submit a job that runs f on a copy of the @size bytes at @argbytes, and detach it from the caller.
+       * The arguments are copied in a task of the pool, so the caller can reuse their memory right away and does not need to allocate it.
+       * Returns false, without submitting the job, if the arguments are larger than VIRGIL_TASK_INLINE_ARGUMENT_BYTES.
+       */
+      bool submitAndDetachInline (
+        void (*f) (void *args),
+        const void *argbytes,
+        std::uint64_t size
+        );
+
       /*
        * Destructor.
        */
@@ -90,6 +116,7 @@ namespace arcana::virgil {
 
     private:
       std::vector<ThreadCTask *> memoryPool;
+      std::uint64_t nextTask = 0;
       mutable pthread_spinlock_t memoryPoolLock;
   };
 
@@ -100,9 +127,9 @@ arcana::virgil::ThreadPoolForC::ThreadPoolForC(void)
   {
 
   /*
-   * Always create at least one thread.  If hardware_concurrency() returns 0,
-   * subtracting one would turn it to UINT_MAX, so get the maximum of
-   * hardware_concurrency() and 2 before subtracting 1.
+   * Always create at least one thread.  The default number of threads
+   * leaves one of the CPUs available to the process (see CPUBudget) to
+   * the thread that submits tasks, but it is never 0.
    */
 
   return ;
@@ -111,8 +138,18 @@ arcana::virgil::ThreadPoolForC::ThreadPoolForC(void)
 arcana::virgil::ThreadPoolForC::ThreadPoolForC (
   const bool extendible,
   const std::uint32_t numThreads,
+  std::function <void (void)> codeToExecuteAtDeconstructor,
+  const WorkerConfiguration &configuration
+  ) : ThreadPoolInterface{extendible, numThreads, codeToExecuteAtDeconstructor, configuration}
+  {
+  pthread_spin_init(&this->memoryPoolLock, 0);
+  return ;
+}
+
+arcana::virgil::ThreadPoolForC::ThreadPoolForC (
+  SharedExecutor &executor,
   std::function <void (void)> codeToExecuteAtDeconstructor
-  ) : ThreadPoolInterface{extendible, numThreads, codeToExecuteAtDeconstructor}
+  ) : ThreadPoolInterface{executor, codeToExecuteAtDeconstructor}
   {
   pthread_spin_init(&this->memoryPoolLock, 0);
   return ;
@@ -126,21 +163,51 @@ arcana::virgil::ThreadCTask * arcana::virgil::ThreadPoolForC::getTask (void){
   ThreadCTask *cTask = nullptr;
   pthread_spin_lock(&this->memoryPoolLock);
   auto poolSize = this->memoryPool.size();
-  for (auto i = 0; i < poolSize; i++){
-    if (this->memoryPool[i]->getAvailability()){
-      cTask = this->memoryPool[i];
+
+  /*
+   * Tasks complete roughly in the order they are submitted, so the search starts after the last task taken: it is likely to find a completed one right away.
+   */
+  for (std::uint64_t i = 0; i < poolSize; i++){
+    auto index = (this->nextTask + i) % poolSize;
+    if (this->memoryPool[index]->getAvailability()){
+      cTask = this->memoryPool[index];
+      this->nextTask = index + 1;
       break ;
     }
   }
   if (cTask == nullptr){
-    cTask = new ThreadCTask(poolSize);
+    cTask = new ThreadCTask();
     this->memoryPool.push_back(cTask);
+    this->nextTask = 0;
   }
   pthread_spin_unlock(&this->memoryPoolLock);
 
   return cTask;
 }
 
+bool arcana::virgil::ThreadPoolForC::submitAndDetachInline (
+  void (*f) (void *args),
+  const void *argbytes,
+  std::uint64_t size
+  ){
+  if (size > VIRGIL_TASK_INLINE_ARGUMENT_BYTES){
+    return false;
+  }
+
+  /*
+   * Fetch the memory.
+   */
+  auto cTask = this->getTask();
+  cTask->setInlineFunction(f, argbytes, size);
+
+  /*
+   * Submit the task.
+   */
+  this->submitAndDetach(cTask->getDescriptor());
+
+  return true;
+}
+
 arcana::virgil::ThreadPoolForC::~ThreadPoolForC (void){
 
   /*
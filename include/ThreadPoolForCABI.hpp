@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The definitions of the C interface of VIRGIL declared in virgil_pool.h.
+ * This header must be included by exactly one C++ translation unit of the program.
+ *
+ * The pools of the C interface are ThreadPoolForCMultiQueues.
+ */
+#pragma once
+
+#include <cstdint>
+#include <new>
+
+#include "virgil_pool.h"
+#include "ThreadPoolForCMultiQueues.hpp"
+
+struct virgil_pool {
+  arcana::virgil::ThreadPoolForCMultiQueues pool;
+
+  explicit virgil_pool (std::uint32_t threads)
+    : pool{false, threads}
+    {
+    return ;
+  }
+};
+
+extern "C" virgil_pool_t * virgil_pool_create (uint32_t threads){
+
+  /*
+   * Exceptions cannot cross the C interface.
+   */
+  if (threads == 0){
+    threads = arcana::virgil::CPUBudget::defaultNumberOfThreads();
+  }
+  try {
+    return new virgil_pool(threads);
+  } catch (...){
+    return nullptr;
+  }
+}
+
+extern "C" uint32_t virgil_pool_threads (const virgil_pool_t *pool){
+  return pool->pool.numberOfThreads();
+}
+
+extern "C" void virgil_pool_destroy (virgil_pool_t *pool){
+  delete pool;
+
+  return ;
+}
+
+extern "C" void virgil_submit (virgil_pool_t *pool, void (*f) (void *args), void *args){
+  pool->pool.submitAndDetach(f, args);
+
+  return ;
+}
+
+extern "C" int virgil_submit_inline (virgil_pool_t *pool, void (*f) (void *args), const void *argbytes, uint64_t size){
+  return pool->pool.submitAndDetachInline(f, argbytes, size) ? 0 : -1;
+}
+
+extern "C" void virgil_submit_task (virgil_pool_t *pool, virgil_task_t *task){
+  pool->pool.submitAndDetach(task);
+
+  return ;
+}
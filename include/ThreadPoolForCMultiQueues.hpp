@@ -14,8 +14,7 @@
  */
 #pragma once
 
-#include "ThreadSafeMutexQueue.hpp"
-#include "ThreadSafeSpinLockQueue.hpp"
+#include "IntrusiveQueue.hpp"
 #include "ThreadCTask.hpp"
 #include "TaskFuture.hpp"
 #include "ThreadPoolForC.hpp"
@@ -24,9 +23,13 @@
 #include <unistd.h>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <fstream>
 #include <functional>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
@@ -37,6 +40,27 @@ typedef int LocalityIsland;
 
 namespace arcana::virgil {
 
+  /*
+   * How submissions without a locality island choose the queue of their task.
+   */
+  enum class PlacementPolicy {
+
+    /*
+     * Every submitting thread cycles through the queues, starting from a queue of its own.
+     */
+    RoundRobin,
+
+    /*
+     * Pick two queues at random and use the shorter one.
+     */
+    PowerOfTwoChoices,
+
+    /*
+     * Use the shortest queue among the ones whose worker runs on the NUMA node of the submitting thread.
+     */
+    LeastLoadedInNode
+  };
+
   /*
    * Thread pool.
    */
@@ -55,8 +79,9 @@ namespace arcana::virgil {
        */
       explicit ThreadPoolForCMultiQueues (
         const bool extendible,
-        const std::uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1u,
-        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr
+        const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(),
+        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr,
+        const WorkerConfiguration &configuration = WorkerConfiguration{}
         );
 
       /*
@@ -67,14 +92,52 @@ namespace arcana::virgil {
         void *args
         ) override;
 
+      /*
+       * Submit a task whose descriptor is owned by the caller and detach it from the caller.
+       */
+      void submitAndDetach (virgil_task_t *task) override;
+
       /*
        * Submit a job to be run by the thread pool and detach it from the caller.
+       * The task goes to the queue li modulo the number of queues.
        */
       void submitAndDetach (
         void (*f) (void *args),
         void *args,
         LocalityIsland li
         );
+      void submitAndDetach (
+        virgil_task_t *task,
+        LocalityIsland li
+        );
+
+      /*
+       * Change the number of workers, and therefore of queues, to @numThreads (at least 1).
+       * When shrinking, the tasks left in the queues of the removed workers move to the remaining queues.
+       * Only extendible pools can be resized, and tasks of the pool must not resize it.
+       */
+      void resize (std::uint32_t numThreads);
+
+      /*
+       * Return the number of workers.
+       */
+      std::uint32_t numberOfThreads (void) const ;
+
+      /*
+       * Check the CPU budget of the process (see CPUBudget) every @period, and resize the pool to the default number of workers whenever the budget changes, e.g., when the CPU quota of the container is updated.
+       * Only extendible pools can follow the budget.
+       */
+      void followCPUBudget (std::chrono::milliseconds period);
+
+      /*
+       * Set how submissions without a locality island choose the queue of their task (RoundRobin by default).
+       */
+      void setPlacementPolicy (PlacementPolicy policy);
+
+      /*
+       * Return how submissions without a locality island choose the queue of their task.
+       */
+      PlacementPolicy getPlacementPolicy (void) const ;
 
       /*
        * Return the number of tasks that did not start executing yet.
@@ -98,11 +161,83 @@ namespace arcana::virgil {
 
     protected:
 
+      /*
+       * The queue of a worker, and the NUMA node the worker runs on (-1 until the worker starts).
+       * Submitters of extendible pools count themselves in pushers while they push, so a resize knows when a queue it removed cannot receive tasks anymore.
+       * While a lazy pool starts its workers, claimable tells whether the worker has nothing to run and no submitter took it yet.
+       */
+      struct WorkerQueue {
+        IntrusiveMPSCQueue<virgil_task_t> tasks;
+        std::atomic<std::int32_t> node{-1};
+        alignas(64) std::atomic<std::uint32_t> pushers{0};
+        std::atomic_bool retired{false};
+        std::atomic_bool claimable{true};
+        std::uint32_t thread;
+      };
+      using QueueSet = std::vector<WorkerQueue *>;
+
       /*
        * Object fields.
+       * cWorkQueues points to the queues of the current workers; a resize publishes a new set rather than changing the current one, so submitters do not lock.
+       * Old sets are freed with the pool, as submitters might still be reading them.
+       * allWorkerQueues holds the queue of every worker ever created, indexed by worker, and it is protected by cWorkQueuesLock.
        */
-      std::vector<ThreadSafeSpinLockQueue<ThreadCTask *>*> cWorkQueues;
+      std::atomic<QueueSet *> cWorkQueues{nullptr};
+      std::vector<QueueSet *> oldQueueSets;
+      std::vector<WorkerQueue *> allWorkerQueues;
       mutable pthread_spinlock_t cWorkQueuesLock;
+      std::uint64_t identifier;
+      std::atomic<PlacementPolicy> placementPolicy{PlacementPolicy::RoundRobin};
+      std::unique_ptr<CPUBudgetMonitor> budgetMonitor;
+
+      /*
+       * Start new workers, each with its own queue.
+       */
+      void newThreads (std::uint32_t newThreadsToGenerate) override ;
+
+      /*
+       * Push @task to the queue of locality island *li, or to the queue chosen by the placement policy if li is nullptr.
+       */
+      void internal_push (virgil_task_t *task, const LocalityIsland *li);
+
+      /*
+       * Push @task to @queue, unless a resize removed @queue.
+       * Returns true if the task has been pushed.
+       */
+      bool internal_pushTo (WorkerQueue *queue, virgil_task_t *task);
+
+      /*
+       * Push @task to a worker that has nothing to run, starting a worker if every started one is busy.
+       * Tasks never move between queues, so a task queued behind a busy worker would not run on the workers started later.
+       * Returns false, without pushing the task, once every worker of the pool started.
+       */
+      bool internal_pushToIdleWorker (virgil_task_t *task);
+
+      /*
+       * Choose the queue for a task submitted without a locality island.
+       */
+      std::uint64_t internal_selectQueue (const QueueSet &queues);
+
+      /*
+       * Make @queues the queues of the current workers.
+       */
+      void internal_publish (QueueSet *queues);
+
+      /*
+       * Return the NUMA node of the core the caller is running on.
+       * The core comes from sched_getcpu, which does not enter the kernel, and the node from a table of the cores built once per program.
+       */
+      static std::int32_t currentNode (void);
+
+      /*
+       * Return the NUMA node of every core, indexed by core, as listed in /sys/devices/system/node.
+       */
+      static const std::vector<std::int32_t> & internal_nodesOfCores (void);
+
+      /*
+       * Return the numbers of a list like "0-3,8,10-11".
+       */
+      static std::vector<std::uint32_t> internal_parseList (const std::string &list);
 
       /*
        * Constantly running function each thread uses to acquire work items from the queue.
@@ -117,9 +252,9 @@ arcana::virgil::ThreadPoolForCMultiQueues::ThreadPoolForCMultiQueues(void)
   {
 
   /*
-   * Always create at least one thread.  If hardware_concurrency() returns 0,
-   * subtracting one would turn it to UINT_MAX, so get the maximum of
-   * hardware_concurrency() and 2 before subtracting 1.
+   * Always create at least one thread.  The default number of threads
+   * leaves one of the CPUs available to the process (see CPUBudget) to
+   * the thread that submits tasks, but it is never 0.
    */
 
   return ;
@@ -128,24 +263,24 @@ arcana::virgil::ThreadPoolForCMultiQueues::ThreadPoolForCMultiQueues(void)
 arcana::virgil::ThreadPoolForCMultiQueues::ThreadPoolForCMultiQueues (
   const bool extendible,
   const std::uint32_t numThreads,
-  std::function <void (void)> codeToExecuteAtDeconstructor)
+  std::function <void (void)> codeToExecuteAtDeconstructor,
+  const WorkerConfiguration &configuration)
   :
-      ThreadPoolForC{extendible, numThreads, codeToExecuteAtDeconstructor}
+      ThreadPoolForC{extendible, numThreads, codeToExecuteAtDeconstructor, configuration}
   {
   pthread_spin_init(&this->cWorkQueuesLock, 0);
 
   /*
-   * Create 1 queue per thread
+   * Identify the pool, so the round-robin state of a submitter is not shared between pools.
    */
-  for (auto i = 0; i < numThreads; i++){
-    cWorkQueues.push_back(new ThreadSafeSpinLockQueue<ThreadCTask *>);
-  }
+  static std::atomic<std::uint64_t> nextIdentifier{1};
+  this->identifier = nextIdentifier.fetch_add(1, std::memory_order_relaxed);
 
   /*
-   * Start threads.
+   * Start threads, each with its own queue.
    */
   try {
-    this->newThreads(numThreads);
+    this->startThreads(numThreads);
 
   } catch(...) {
     throw;
@@ -158,9 +293,40 @@ void arcana::virgil::ThreadPoolForCMultiQueues::submitAndDetach (
   void (*f) (void *args),
   void *args
   ){
-  static std::uint32_t nextLocality = 0;
-  this->submitAndDetach(f, args, nextLocality);
-  nextLocality++;
+
+  /*
+   * Fetch the memory.
+   */
+  auto cTask = this->getTask();
+  cTask->setFunction(f, args);
+
+  /*
+   * Submit the task.
+   */
+  this->submitAndDetach(cTask->getDescriptor());
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolForCMultiQueues::submitAndDetach (virgil_task_t *task){
+  CTaskDescriptor::markSubmission(task);
+
+  /*
+   * Submit the task.
+   */
+  if (  (this->numberOfLazyThreads() == 0)
+        || (!this->internal_pushToIdleWorker(task))
+     ){
+    this->internal_push(task, nullptr);
+  }
+
+  /*
+   * Expand the pool if possible and necessary.
+   * Lazy workers have been started while pushing the task.
+   */
+  this->expandPool(false);
+
+  return ;
 }
 
 void arcana::virgil::ThreadPoolForCMultiQueues::submitAndDetach (
@@ -178,16 +344,21 @@ void arcana::virgil::ThreadPoolForCMultiQueues::submitAndDetach (
   /*
    * Submit the task.
    */
-  if (this->extendible){
-    pthread_spin_lock(&this->cWorkQueuesLock);
-  }
+  this->submitAndDetach(cTask->getDescriptor(), li);
 
-  auto queueID = li % this->cWorkQueues.size();
-  this->cWorkQueues.at(queueID)->push(cTask);
+  return ;
+}
 
-  if (this->extendible){
-    pthread_spin_unlock(&this->cWorkQueuesLock);
-  }
+void arcana::virgil::ThreadPoolForCMultiQueues::submitAndDetach (
+  virgil_task_t *task,
+  LocalityIsland li
+  ){
+  CTaskDescriptor::markSubmission(task);
+
+  /*
+   * Submit the task.
+   */
+  this->internal_push(task, &li);
 
   /*
    * Expand the pool if possible and necessary.
@@ -197,6 +368,339 @@ void arcana::virgil::ThreadPoolForCMultiQueues::submitAndDetach (
   return ;
 }
 
+void arcana::virgil::ThreadPoolForCMultiQueues::internal_push (virgil_task_t *task, const LocalityIsland *li){
+  while (true){
+    auto queues = this->cWorkQueues.load(std::memory_order_acquire);
+    auto queueID = (li != nullptr) ? (*li % queues->size()) : this->internal_selectQueue(*queues);
+    auto queue = (*queues)[queueID];
+    if (this->internal_pushTo(queue, task)){
+      return ;
+    }
+
+    /*
+     * The queue has been removed: try again with the new set of queues.
+     */
+  }
+}
+
+bool arcana::virgil::ThreadPoolForCMultiQueues::internal_pushTo (WorkerQueue *queue, virgil_task_t *task){
+
+  /*
+   * Pools that are not extendible never remove queues.
+   */
+  if (!this->extendible){
+    queue->tasks.push(task);
+    return true;
+  }
+
+  /*
+   * Announce the push before checking whether the queue has been removed; resize does the opposite.
+   * So either this push sees the queue retired, or the resize waits for it.
+   */
+  queue->pushers.fetch_add(1, std::memory_order_seq_cst);
+  if (!queue->retired.load(std::memory_order_seq_cst)){
+    queue->tasks.push(task);
+    queue->pushers.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+  queue->pushers.fetch_sub(1, std::memory_order_relaxed);
+
+  return false;
+}
+
+bool arcana::virgil::ThreadPoolForCMultiQueues::internal_pushToIdleWorker (virgil_task_t *task){
+  while (true){
+
+    /*
+     * Claim a worker that has nothing to run.
+     * Claiming clears the flag, so two submitters never pick the same idle worker.
+     */
+    auto queues = this->cWorkQueues.load(std::memory_order_acquire);
+    for (auto queue : *queues){
+      if (  queue->claimable.load(std::memory_order_relaxed)
+            && queue->claimable.exchange(false, std::memory_order_acquire)
+            && this->internal_pushTo(queue, task)
+         ){
+        return true;
+      }
+    }
+
+    /*
+     * Every started worker is busy: start another one, and look for an idle worker again.
+     * Give up once every worker started.
+     */
+    std::lock_guard<std::mutex> lock{this->extendingMutex};
+    if (!this->startLazyThread()){
+      break ;
+    }
+  }
+
+  return false;
+}
+
+void arcana::virgil::ThreadPoolForCMultiQueues::resize (std::uint32_t numThreads){
+  assert(this->extendible);
+  assert(!this->m_done);
+  numThreads = std::max<std::uint32_t>(numThreads, 1);
+  std::lock_guard<std::mutex> lock{this->extendingMutex};
+
+  /*
+   * The pool gets exactly @numThreads workers, even if it started lazily.
+   */
+  this->cancelLazyThreads();
+  this->waitForThreadsToBeCreated();
+
+  /*
+   * Grow.
+   */
+  auto queues = this->cWorkQueues.load(std::memory_order_acquire);
+  if (numThreads >= queues->size()){
+    this->newThreads(numThreads - queues->size());
+    return ;
+  }
+
+  /*
+   * Shrink: stop publishing the queues of the last workers.
+   */
+  auto remaining = new QueueSet(queues->begin(), queues->begin() + numThreads);
+  QueueSet removed(queues->begin() + numThreads, queues->end());
+  this->internal_publish(remaining);
+
+  std::uint64_t nextQueue = 0;
+  for (auto queue : removed){
+
+    /*
+     * Wait for the submitters that might still push to the queue.
+     */
+    queue->retired.store(true, std::memory_order_seq_cst);
+    while (queue->pushers.load(std::memory_order_seq_cst) != 0){
+      std::this_thread::yield();
+    }
+
+    /*
+     * Stop the worker of the queue.
+     */
+    queue->tasks.invalidate();
+    this->wakeUpPausedWorkers();
+    this->m_threads.at(queue->thread).join();
+
+    /*
+     * Move the tasks left behind to the remaining queues.
+     */
+    virgil_task_t *task;
+    while (queue->tasks.tryPop(task)){
+      (*remaining)[nextQueue % remaining->size()]->tasks.push(task);
+      nextQueue++;
+    }
+  }
+
+  return ;
+}
+
+std::uint32_t arcana::virgil::ThreadPoolForCMultiQueues::numberOfThreads (void) const {
+  return this->cWorkQueues.load(std::memory_order_acquire)->size();
+}
+
+void arcana::virgil::ThreadPoolForCMultiQueues::followCPUBudget (std::chrono::milliseconds period){
+  assert(this->extendible);
+
+  /*
+   * Adopt the current budget, and then track its changes.
+   */
+  this->budgetMonitor.reset();
+  CPUBudget::refresh();
+  this->resize(CPUBudget::defaultNumberOfThreads());
+  this->budgetMonitor = std::make_unique<CPUBudgetMonitor>(period, [this](std::uint32_t cpus){
+    this->resize(CPUBudget::defaultNumberOfThreads());
+  });
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolForCMultiQueues::newThreads (std::uint32_t newThreadsToGenerate){
+  if (newThreadsToGenerate == 0){
+    return ;
+  }
+
+  /*
+   * Create the queues of the new workers.
+   */
+  auto queues = this->cWorkQueues.load(std::memory_order_acquire);
+  auto newQueues = (queues != nullptr) ? new QueueSet(*queues) : new QueueSet();
+  pthread_spin_lock(&this->cWorkQueuesLock);
+  for (std::uint32_t i = 0; i < newThreadsToGenerate; i++){
+    auto queue = new WorkerQueue;
+    queue->thread = this->allWorkerQueues.size();
+    this->allWorkerQueues.push_back(queue);
+    newQueues->push_back(queue);
+  }
+  pthread_spin_unlock(&this->cWorkQueuesLock);
+
+  /*
+   * Let submitters use the new queues, and start the workers.
+   * Workers are numbered like their queues in allWorkerQueues.
+   */
+  this->internal_publish(newQueues);
+  ThreadPoolForC::newThreads(newThreadsToGenerate);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolForCMultiQueues::internal_publish (QueueSet *queues){
+  auto old = this->cWorkQueues.exchange(queues, std::memory_order_acq_rel);
+  if (old != nullptr){
+    this->oldQueueSets.push_back(old);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolForCMultiQueues::setPlacementPolicy (PlacementPolicy policy){
+  this->placementPolicy = policy;
+
+  return ;
+}
+
+arcana::virgil::PlacementPolicy arcana::virgil::ThreadPoolForCMultiQueues::getPlacementPolicy (void) const {
+  return this->placementPolicy;
+}
+
+std::uint64_t arcana::virgil::ThreadPoolForCMultiQueues::internal_selectQueue (const QueueSet &workQueues){
+  auto queues = workQueues.size();
+
+  /*
+   * The state of the submitting thread.
+   * The round-robin position restarts from a queue of the thread whenever the thread submits to a different pool.
+   */
+  static thread_local std::uint64_t lastPool = 0;
+  static thread_local std::uint64_t nextQueue = 0;
+  static thread_local std::uint64_t random = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+  auto nextRandom = [](void) -> std::uint64_t {
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return random;
+  };
+
+  switch (this->placementPolicy.load(std::memory_order_relaxed)){
+    case PlacementPolicy::RoundRobin:
+      if (lastPool != this->identifier){
+        lastPool = this->identifier;
+        nextQueue = nextRandom();
+      }
+      return (nextQueue++) % queues;
+
+    case PlacementPolicy::PowerOfTwoChoices: {
+      auto first = nextRandom() % queues;
+      auto second = nextRandom() % queues;
+      if (workQueues[second]->tasks.size() < workQueues[first]->tasks.size()){
+        return second;
+      }
+      return first;
+    }
+
+    case PlacementPolicy::LeastLoadedInNode: {
+
+      /*
+       * Fall back to all queues if no worker runs on the node of the caller.
+       * Scanning starts from a random queue, so ties do not always go to the same queue.
+       */
+      auto node = currentNode();
+      auto start = nextRandom() % queues;
+      std::uint64_t best = queues;
+      int64_t bestSize = 0;
+      for (auto round = 0; (round < 2) && (best == queues); round++){
+        for (std::uint64_t i = 0; i < queues; i++){
+          auto q = (start + i) % queues;
+          auto queue = workQueues[q];
+          if (  (round == 0)
+                && (queue->node.load(std::memory_order_relaxed) != node)
+             ){
+            continue ;
+          }
+          auto size = queue->tasks.size();
+          if (  (best == queues)
+                || (size < bestSize)
+             ){
+            best = q;
+            bestSize = size;
+          }
+        }
+      }
+      return best;
+    }
+  }
+
+  return 0;
+}
+
+std::int32_t arcana::virgil::ThreadPoolForCMultiQueues::currentNode (void){
+  auto &nodes = internal_nodesOfCores();
+  auto cpu = sched_getcpu();
+  if (  (cpu < 0)
+        || (static_cast<std::size_t>(cpu) >= nodes.size())
+     ){
+    return 0;
+  }
+
+  return nodes[cpu];
+}
+
+const std::vector<std::int32_t> & arcana::virgil::ThreadPoolForCMultiQueues::internal_nodesOfCores (void){
+  static const std::vector<std::int32_t> nodes = [](void){
+    std::vector<std::int32_t> nodesOfCores;
+
+    /*
+     * Machines without NUMA information have a single node, so every core maps to node 0 by default.
+     */
+    std::ifstream possible{"/sys/devices/system/node/possible"};
+    std::string line;
+    if (  (!possible.is_open())
+          || (!std::getline(possible, line))
+       ){
+      return nodesOfCores;
+    }
+    for (auto node : internal_parseList(line)){
+      std::ifstream cores{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+      std::string coresOfNode;
+      if (  (!cores.is_open())
+            || (!std::getline(cores, coresOfNode))
+         ){
+        continue ;
+      }
+      for (auto core : internal_parseList(coresOfNode)){
+        if (core >= nodesOfCores.size()){
+          nodesOfCores.resize(core + 1, 0);
+        }
+        nodesOfCores[core] = static_cast<std::int32_t>(node);
+      }
+    }
+
+    return nodesOfCores;
+  }();
+
+  return nodes;
+}
+
+std::vector<std::uint32_t> arcana::virgil::ThreadPoolForCMultiQueues::internal_parseList (const std::string &list){
+  std::vector<std::uint32_t> numbers;
+  std::istringstream ranges{list};
+  std::string range;
+  while (std::getline(ranges, range, ',')){
+    if (range.empty()){
+      continue ;
+    }
+    auto dash = range.find('-');
+    auto first = std::stoul(range.substr(0, dash));
+    auto last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+    for (auto n = first; n <= last; n++){
+      numbers.push_back(static_cast<std::uint32_t>(n));
+    }
+  }
+
+  return numbers;
+}
+
 void arcana::virgil::ThreadPoolForCMultiQueues::workerFunction (std::atomic_bool *availability, std::uint32_t thread){
 
   /*
@@ -217,26 +721,50 @@ void arcana::virgil::ThreadPoolForCMultiQueues::workerFunction (std::atomic_bool
    * Fetch the queue of the thread
    */
   pthread_spin_lock(&this->cWorkQueuesLock);
-  auto threadQueue = this->cWorkQueues.at(thread);
-/*  std::cout << "Worker started with cpu " << cpu << std::endl
-            << "It's thread id is " << thread << std::endl
-            << "cWorkQueues Size = " << cWorkQueues.size() << std::endl
-            << "threadQ = " << threadQueue << std::endl;*/
+  auto workerQueue = this->allWorkerQueues.at(thread);
   pthread_spin_unlock(&this->cWorkQueuesLock);
+  workerQueue->node = currentNode();
+  auto threadQueue = &workerQueue->tasks;
 
   while(!m_done) {
+    this->workerMayPause(&workerQueue->retired);
     (*availability) = true;
-    ThreadCTask *pTask = nullptr;
-    if(threadQueue->waitPop(pTask)) {
-      (*availability) = false;
-      pTask->execute();
+    virgil_task_t *pTask = nullptr;
+    this->workerWillWait();
+    if(threadQueue->waitPop(pTask, this->idleSpinPeriod())) {
+      this->workerDidTakeTask(availability);
+      auto lazy = this->numberOfLazyThreads() > 0;
+      if (lazy){
+        workerQueue->claimable.store(false, std::memory_order_relaxed);
+      }
+      this->workerMayPause(&workerQueue->retired);
+      this->workerDidWakeUp(pTask);
+      this->workerWillExecute(pTask);
+      CTaskDescriptor::execute(pTask);
+      this->workerDidExecute(pTask);
+      CTaskDescriptor::complete(pTask);
+
+      /*
+       * Lazy submissions can give tasks to the worker again once it ran everything it has been given.
+       */
+      if (  lazy
+            && (threadQueue->size() == 0)
+         ){
+        workerQueue->claimable.store(true, std::memory_order_release);
+      }
+    } else {
+      this->workerDidWakeUp(nullptr);
+
+      /*
+       * The queue of the worker has been removed by a resize.
+       */
+      if (workerQueue->retired){
+        break;
+      }
     }
     if (m_done) {
       break;
     }
-    if (pTask){
-      pTask->setAvailable();
-    }
   }
 
   return ;
@@ -244,24 +772,28 @@ void arcana::virgil::ThreadPoolForCMultiQueues::workerFunction (std::atomic_bool
 
 std::uint64_t arcana::virgil::ThreadPoolForCMultiQueues::numberOfTasksWaitingToBeProcessed (void) const {
   std::uint64_t s = 0;
-  pthread_spin_lock(&this->cWorkQueuesLock);
-  for (auto queue : this->cWorkQueues) {
-    s += queue->size();
+  for (auto queue : *this->cWorkQueues.load(std::memory_order_acquire)) {
+    s += queue->tasks.size();
   }
-  pthread_spin_unlock(&this->cWorkQueuesLock);
 
   return s;
 }
 
 arcana::virgil::ThreadPoolForCMultiQueues::~ThreadPoolForCMultiQueues (void){
 
+  /*
+   * Stop resizing the pool.
+   */
+  this->budgetMonitor.reset();
+
   /*
    * Signal threads to quite.
    */
   this->m_done = true;
+  this->resume();
   pthread_spin_lock(&this->cWorkQueuesLock);
-  for (auto queue : this->cWorkQueues) {
-    queue->invalidate();
+  for (auto queue : this->allWorkerQueues) {
+    queue->tasks.invalidate();
   }
   pthread_spin_unlock(&this->cWorkQueuesLock);
 
@@ -271,7 +803,25 @@ arcana::virgil::ThreadPoolForCMultiQueues::~ThreadPoolForCMultiQueues (void){
   this->waitAllThreadsToBeUnavailable();
 
   /*
-   * Join threads.
+   * Join threads, as they use the queues until they return.
    */
+  for (auto &thread : this->m_threads){
+    if (thread.joinable()){
+      thread.join();
+    }
+  }
+
+  /*
+   * Free the queues.
+   */
+  for (auto queue : this->allWorkerQueues) {
+    delete queue;
+  }
+  for (auto queues : this->oldQueueSets) {
+    delete queues;
+  }
+  delete this->cWorkQueues.load();
+  pthread_spin_destroy(&this->cWorkQueuesLock);
+
   return ;
 }
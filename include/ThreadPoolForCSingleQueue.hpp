@@ -14,8 +14,7 @@
  */
 #pragma once
 
-#include "ThreadSafeMutexQueue.hpp"
-#include "ThreadSafeSpinLockQueue.hpp"
+#include "IntrusiveQueue.hpp"
 #include "ThreadCTask.hpp"
 #include "TaskFuture.hpp"
 #include "ThreadPoolForC.hpp"
@@ -52,7 +51,17 @@ namespace arcana::virgil {
        */
       explicit ThreadPoolForCSingleQueue (
         const bool extendible,
-        const std::uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1u,
+        const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(),
+        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr,
+        const WorkerConfiguration &configuration = WorkerConfiguration{}
+        );
+
+      /*
+       * Constructor of a thread pool that runs its tasks on the workers of @executor (e.g., SharedExecutor::instance()) rather than on its own threads.
+       * The pool keeps its own queue and statistics.
+       */
+      explicit ThreadPoolForCSingleQueue (
+        SharedExecutor &executor,
         std::function <void (void)> codeToExecuteAtDeconstructor = nullptr
         );
 
@@ -64,6 +73,11 @@ namespace arcana::virgil {
         void *args
         ) override;
 
+      /*
+       * Submit a task whose descriptor is owned by the caller and detach it from the caller.
+       */
+      void submitAndDetach (virgil_task_t *task) override;
+
       /*
        * Return the number of tasks that did not start executing yet.
        */
@@ -89,12 +103,17 @@ namespace arcana::virgil {
       /*
        * Object fields.
        */
-      ThreadSafeMutexQueue<ThreadCTask *> cWorkQueue;
+      IntrusiveMPMCQueue<virgil_task_t> cWorkQueue;
 
       /*
        * Constantly running function each thread uses to acquire work items from the queue.
        */
       void workerFunction (std::atomic_bool *availability, std::uint32_t thread) override ;
+
+      /*
+       * Run a task of the queue on a worker of the executor.
+       */
+      bool runQueuedTask (void) override ;
   };
 
 }
@@ -104,9 +123,9 @@ arcana::virgil::ThreadPoolForCSingleQueue::ThreadPoolForCSingleQueue(void)
   {
 
   /*
-   * Always create at least one thread.  If hardware_concurrency() returns 0,
-   * subtracting one would turn it to UINT_MAX, so get the maximum of
-   * hardware_concurrency() and 2 before subtracting 1.
+   * Always create at least one thread.  The default number of threads
+   * leaves one of the CPUs available to the process (see CPUBudget) to
+   * the thread that submits tasks, but it is never 0.
    */
 
   return ;
@@ -115,17 +134,18 @@ arcana::virgil::ThreadPoolForCSingleQueue::ThreadPoolForCSingleQueue(void)
 arcana::virgil::ThreadPoolForCSingleQueue::ThreadPoolForCSingleQueue (
   const bool extendible,
   const std::uint32_t numThreads,
-  std::function <void (void)> codeToExecuteAtDeconstructor)
+  std::function <void (void)> codeToExecuteAtDeconstructor,
+  const WorkerConfiguration &configuration)
   :
       cWorkQueue{}
-    , ThreadPoolForC{extendible, numThreads, codeToExecuteAtDeconstructor}
+    , ThreadPoolForC{extendible, numThreads, codeToExecuteAtDeconstructor, configuration}
   {
 
   /*
    * Start threads.
    */
   try {
-    this->newThreads(numThreads);
+    this->startThreads(numThreads);
 
   } catch(...) {
     throw;
@@ -134,6 +154,22 @@ arcana::virgil::ThreadPoolForCSingleQueue::ThreadPoolForCSingleQueue (
   return ;
 }
 
+arcana::virgil::ThreadPoolForCSingleQueue::ThreadPoolForCSingleQueue (
+  SharedExecutor &executor,
+  std::function <void (void)> codeToExecuteAtDeconstructor)
+  :
+      cWorkQueue{}
+    , ThreadPoolForC{executor, codeToExecuteAtDeconstructor}
+  {
+
+  /*
+   * Let the workers of the executor serve the queue.
+   */
+  this->attachToExecutor();
+
+  return ;
+}
+
 void arcana::virgil::ThreadPoolForCSingleQueue::submitAndDetach (
   void (*f) (void *args),
   void *args
@@ -148,7 +184,19 @@ void arcana::virgil::ThreadPoolForCSingleQueue::submitAndDetach (
   /*
    * Submit the task.
    */
-  this->cWorkQueue.push(cTask);
+  this->submitAndDetach(cTask->getDescriptor());
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolForCSingleQueue::submitAndDetach (virgil_task_t *task){
+  CTaskDescriptor::markSubmission(task);
+
+  /*
+   * Submit the task.
+   */
+  this->cWorkQueue.push(task);
+  this->tasksSubmitted(1);
 
   /*
    * Expand the pool if possible and necessary.
@@ -160,23 +208,46 @@ void arcana::virgil::ThreadPoolForCSingleQueue::submitAndDetach (
 
 void arcana::virgil::ThreadPoolForCSingleQueue::workerFunction (std::atomic_bool *availability, std::uint32_t thread) {
   while(!m_done) {
+    this->workerMayPause();
     (*availability) = true;
-    ThreadCTask *pTask = nullptr;
-    if(this->cWorkQueue.waitPop(pTask)) {
-      (*availability) = false;
-      pTask->execute();
+    virgil_task_t *pTask = nullptr;
+    this->workerWillWait();
+    if(this->cWorkQueue.waitPop(pTask, this->idleSpinPeriod())) {
+      this->workerDidTakeTask(availability);
+      this->workerMayPause();
+      this->workerDidWakeUp(pTask);
+      this->workerWillExecute(pTask);
+      CTaskDescriptor::execute(pTask);
+      this->workerDidExecute(pTask);
+      CTaskDescriptor::complete(pTask);
+    } else {
+      this->workerDidWakeUp(nullptr);
     }
     if (m_done) {
       break;
     }
-    if (pTask){
-      pTask->setAvailable();
-    }
   }
 
   return ;
 }
 
+bool arcana::virgil::ThreadPoolForCSingleQueue::runQueuedTask (void){
+  virgil_task_t *pTask = nullptr;
+  this->workerWillWait();
+  if (!this->cWorkQueue.tryPop(pTask)){
+    this->workerDidWakeUp(nullptr);
+    return false;
+  }
+  this->taskDequeued();
+  this->workerDidWakeUp(pTask);
+  this->workerWillExecute(pTask);
+  CTaskDescriptor::execute(pTask);
+  this->workerDidExecute(pTask);
+  CTaskDescriptor::complete(pTask);
+
+  return true;
+}
+
 std::uint64_t arcana::virgil::ThreadPoolForCSingleQueue::numberOfTasksWaitingToBeProcessed (void) const {
   auto s = this->cWorkQueue.size();
 
@@ -189,6 +260,8 @@ arcana::virgil::ThreadPoolForCSingleQueue::~ThreadPoolForCSingleQueue (void){
    * Signal threads to quite.
    */
   this->m_done = true;
+  this->resume();
+  this->detachFromExecutor();
   this->cWorkQueue.invalidate();
 
   /*
@@ -18,10 +18,23 @@
 #include "ThreadTask.hpp"
 #include "ThreadCTask.hpp"
 #include "TaskFuture.hpp"
+#include "ThreadPoolStatistics.hpp"
+#include "LatencyHistogram.hpp"
+#include "PerformanceCounters.hpp"
+#include "ThreadPoolTracer.hpp"
+#include "EventCount.hpp"
+#include "SharedExecutor.hpp"
+#include "CPUBudget.hpp"
+#include "WorkerConfiguration.hpp"
+#include "WorkerThread.hpp"
 
 #include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -31,12 +44,16 @@
 #include <vector>
 #include <assert.h>
 
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
 namespace arcana::virgil {
 
   /*
    * Thread pool.
    */
-  class ThreadPoolInterface {
+  class ThreadPoolInterface : private SharedExecutor::Client {
     public:
 
       /*
@@ -51,7 +68,17 @@ namespace arcana::virgil {
        */
       explicit ThreadPoolInterface (
         const bool extendible,
-        const std::uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1u,
+        const std::uint32_t numThreads = CPUBudget::defaultNumberOfThreads(),
+        std::function <void (void)> codeToExecuteAtDeconstructor = nullptr,
+        const WorkerConfiguration &configuration = WorkerConfiguration{}
+        );
+
+      /*
+       * Constructor of a thread pool that runs its tasks on the workers of @executor rather than on its own threads.
+       * The pool keeps its own queue and statistics.
+       */
+      explicit ThreadPoolInterface (
+        SharedExecutor &executor,
         std::function <void (void)> codeToExecuteAtDeconstructor = nullptr
         );
 
@@ -70,6 +97,59 @@ namespace arcana::virgil {
        */
       virtual std::uint64_t numberOfTasksWaitingToBeProcessed (void) const = 0;
 
+      /*
+       * Prepare the pool for a latency-critical phase.
+       * Start the workers that a lazy pool did not start yet, wait until every worker runs, and pre-fault the top @stackBytes of their stacks.
+       */
+      void warmup (std::size_t stackBytes = 256 * 1024);
+
+      /*
+       * Set how long an idle worker keeps polling its queue before it sleeps until a task is submitted.
+       * Polling lowers the latency of the tasks submitted right after the previous ones, while sleeping frees the cores of an idle pool.
+       * By default, workers poll only for a few iterations.
+       * The workers of ThreadPool sleep on the condition variable of their queue right away, so they ignore this period.
+       */
+      void setIdleSpinPeriod (std::chrono::microseconds period);
+
+      /*
+       * Return how long an idle worker keeps polling its queue.
+       */
+      std::chrono::microseconds getIdleSpinPeriod (void) const ;
+
+      /*
+       * Pause the pool, e.g., during serial phases of the application.
+       * Workers complete the tasks they are executing and then sleep; tasks submitted while the pool is paused wait in the queue until resume is called.
+       */
+      void pause (void);
+
+      /*
+       * Wake up the workers of a paused pool.
+       */
+      void resume (void);
+
+      /*
+       * Check whether or not the pool is paused.
+       */
+      bool isPaused (void) const ;
+
+      /*
+       * Return the execution counters of every worker and their sum.
+       * Counters are collected only if VIRGIL_STATISTICS is defined.
+       */
+      ThreadPoolStatistics stats (void) const ;
+
+      /*
+       * Return the histograms of the time tasks spend in the queue, of their execution time, and of the time spent waiting for their results.
+       * Histograms are collected only if VIRGIL_LATENCY_HISTOGRAMS is defined.
+       */
+      ThreadPoolLatencies latencies (void) const ;
+
+      /*
+       * Return the hardware performance counters (cycles, instructions, last-level cache misses, context switches) of the tasks run by the pool, grouped by kind of task.
+       * Counters are collected only if VIRGIL_PERFORMANCE_COUNTERS is defined.
+       */
+      ThreadPoolPerformanceCounters performanceCounters (void) const ;
+
       /*
        * Destructor.
        */
@@ -91,21 +171,85 @@ namespace arcana::virgil {
        * Object fields.
        */
       std::atomic_bool m_done;
-      std::vector<std::thread> m_threads;
+      std::vector<WorkerThread> m_threads;
       std::vector<std::atomic_bool *> threadAvailability;
       ThreadSafeMutexQueue<std::function<void ()>> codeToExecuteByTheDeconstructor;
       bool extendible;
       mutable std::mutex extendingMutex;
 
+      /*
+       * The executor that runs the tasks of the pool, or nullptr if the pool has its own threads.
+       */
+      SharedExecutor *executor = nullptr;
+
+      /*
+       * How workers are created.
+       */
+      WorkerConfiguration configuration;
+
       /*
        * Expand the pool if possible and necessary.
+       * Pools that start their lazy workers on their own pass false as @startLazyThreads; the submitted task is accounted anyway.
+       */
+      void expandPool (bool startLazyThreads = true);
+
+      /*
+       * Start and stop being served by the executor of the pool, if any.
+       * Pools attach once their queue is ready, and they detach before destroying it.
+       */
+      void attachToExecutor (void);
+      void detachFromExecutor (void);
+
+      /*
+       * Wake up the workers of the executor, if any, for @tasks tasks just queued.
+       */
+      void tasksSubmitted (std::uint64_t tasks);
+
+      /*
+       * Account a task popped by runQueuedTask.
+       */
+      void taskDequeued (void);
+
+      /*
+       * Fetch a task from the queue of the pool, if any, and run it on the calling worker of the executor.
+       * Returns true if a task has been executed.
+       */
+      virtual bool runQueuedTask (void);
+
+      /*
+       * Start the first @numThreads workers of the pool as its configuration says.
+       * Constructors invoke it rather than newThreads.
        */
-      void expandPool (void);
+      void startThreads (std::uint32_t numThreads);
 
       /*
        * Start new threads.
+       * Workers are numbered in order of creation, starting from 0.
+       * With StartMode::Parallel, the new threads create each other, so some of them might not exist yet when this returns.
+       */
+      virtual void newThreads (std::uint32_t newThreadsToGenerate);
+
+      /*
+       * Wait until the threads created by other threads exist, so m_threads can be changed or joined.
        */
-      void newThreads (std::uint32_t newThreadsToGenerate);
+      void waitForThreadsToBeCreated (void);
+
+      /*
+       * Give up starting the workers of a lazy pool that are not running yet.
+       */
+      void cancelLazyThreads (void);
+
+      /*
+       * Return the number of workers a lazy pool did not start yet.
+       */
+      std::uint32_t numberOfLazyThreads (void) const ;
+
+      /*
+       * Start one of the workers a lazy pool did not start yet, if any.
+       * The caller holds extendingMutex.
+       * Returns true if a worker has been started.
+       */
+      bool startLazyThread (void);
 
       /*
        * Wait for threads.
@@ -117,12 +261,134 @@ namespace arcana::virgil {
        */
       virtual void workerFunction (std::atomic_bool *availability, std::uint32_t thread) = 0;
 
+      /*
+       * Return the histogram where futures of the tasks of this pool record the time spent waiting for results.
+       * Futures share its ownership, so they can outlive the pool.
+       * Return nullptr unless VIRGIL_LATENCY_HISTOGRAMS is defined.
+       */
+      std::shared_ptr<LatencyHistogram> futureWaitHistogram (void);
+
+      /*
+       * Return how long an idle worker keeps polling its queue.
+       */
+      std::chrono::nanoseconds idleSpinPeriod (void) const ;
+
+      /*
+       * Sleep while the pool is paused, unless the pool is being destroyed or @leave is set.
+       * Workers invoke it before fetching a task and before executing the task they fetched.
+       */
+      void workerMayPause (const std::atomic_bool *leave = nullptr);
+
+      /*
+       * The worker that owns @availability fetched a task, so it is not idle anymore.
+       * Workers invoke it right after fetching a task, before anything else.
+       */
+      void workerDidTakeTask (std::atomic_bool *availability);
+
+      /*
+       * Wake up the paused workers so they check their @leave flag.
+       */
+      void wakeUpPausedWorkers (void);
+
+      /*
+       * Events of the worker that invokes them.
+       * They update the counters, the histograms, and the trace of the worker.
+       * They are no-ops unless VIRGIL_STATISTICS, VIRGIL_LATENCY_HISTOGRAMS, VIRGIL_PERFORMANCE_COUNTERS, or VIRGIL_TRACING are defined.
+       *
+       * workerWillWait: the worker is about to wait for a task.
+       * workerDidWakeUp: the worker stopped waiting; @task is nullptr if no task has been fetched.
+       * workerWillExecute: the worker is about to execute the task it fetched.
+       * workerDidExecute: the worker completed the execution of the task it fetched.
+       *
+       * Tasks are either C++ tasks or descriptors of C tasks.
+       * Other kinds of tasks pass what identifies them in traces, the time they have been submitted (0 if unknown), and their profiling key.
+       */
+      void workerWillWait (void);
+      void workerDidWakeUp (std::nullptr_t noTask);
+      void workerDidWakeUp (const IThreadTask *task);
+      void workerDidWakeUp (const virgil_task_t *task);
+      void workerDidWakeUp (const void *task, std::uint64_t submissionTime);
+      void workerWillExecute (const IThreadTask *task);
+      void workerWillExecute (const virgil_task_t *task);
+      void workerWillExecute (const void *task, std::uint64_t submissionTime);
+      void workerDidExecute (const IThreadTask *task);
+      void workerDidExecute (const virgil_task_t *task);
+      void workerDidExecute (const void *task, TaskProfilingKey profilingKey);
+
     private:
 
+      /*
+       * Implementation of SharedExecutor::Client.
+       */
+      bool hasTasks (void) const override ;
+      bool runTask (std::uint32_t worker) override ;
+
+      /*
+       * Instrumentation owned by a single worker.
+       */
+      struct alignas(64) WorkerInstrumentation {
+        WorkerCounters counters;
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+        WorkerLatencies latencies;
+        std::uint64_t executionStart = 0;
+#endif
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+        PerformanceCounters performanceCounters;
+        bool performanceCountersOpen = false;
+#endif
+      };
+
       /*
        * Object fields
        */
-      static void workerFunctionTrampoline (ThreadPoolInterface *p, std::atomic_bool *availability, std::uint32_t thread) ;
+      std::vector<WorkerInstrumentation *> workerInstrumentation;
+      inline static thread_local WorkerInstrumentation *localInstrumentation = nullptr;
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+      std::shared_ptr<LatencyHistogram> futureWait{std::make_shared<LatencyHistogram>()};
+#endif
+
+      alignas(64) std::atomic<std::int64_t> spinPeriod{0};
+      std::atomic_bool paused{false};
+      EventCount resumed;
+
+      /*
+       * Tasks queued for the workers of the executor, if any.
+       * The executor reads this count while it holds the lock of its clients, so it does not take the lock of the queue there.
+       * It can be negative for a moment, because a task can be popped before its submission is accounted.
+       */
+      alignas(64) std::atomic<std::int64_t> tasksForTheExecutor{0};
+
+      /*
+       * Workers not started yet by a lazy pool, workers that still have to be created by other workers, and workers that started running.
+       * spawnFirst and spawnCount identify the threads created by each other.
+       */
+      std::atomic<std::uint32_t> threadsToStartLazily{0};
+      std::atomic<std::uint32_t> threadsBeingCreated{0};
+      std::atomic<std::uint32_t> threadsStarted{0};
+      std::uint32_t spawnFirst = 0;
+      std::uint32_t spawnCount = 0;
+
+      /*
+       * Tasks submitted to a lazy pool that no worker took yet.
+       * Unlike the size of the queues, this count drops only after the worker that took the task stopped being idle.
+       * It is meaningless once every worker started.
+       */
+      std::atomic<std::int64_t> lazyWaitingTasks{0};
+
+      inline static std::atomic<std::uint32_t> workersCreated{0};
+
+      /*
+       * Create the thread of the worker @thread, whose slot in m_threads already exists.
+       * With @createChildren, the new thread creates the next ones of its batch.
+       */
+      void internal_createThread (std::uint32_t thread, bool createChildren);
+
+      /*
+       * Account the task just submitted to a lazy pool, and, if @start is true, start a worker if the idle workers cannot take every waiting task.
+       */
+      void internal_startLazyThread (bool start);
+
+      static void workerFunctionTrampoline (ThreadPoolInterface *p, std::atomic_bool *availability, WorkerInstrumentation *instrumentation, std::uint32_t thread, bool createChildren) ;
   };
 
 }
@@ -132,9 +398,9 @@ arcana::virgil::ThreadPoolInterface::ThreadPoolInterface(void)
   {
 
   /*
-   * Always create at least one thread.  If hardware_concurrency() returns 0,
-   * subtracting one would turn it to UINT_MAX, so get the maximum of
-   * hardware_concurrency() and 2 before subtracting 1.
+   * Always create at least one thread.  The default number of threads
+   * leaves one of the CPUs available to the process (see CPUBudget) to
+   * the thread that submits tasks, but it is never 0.
    */
 
   return ;
@@ -143,11 +409,13 @@ arcana::virgil::ThreadPoolInterface::ThreadPoolInterface(void)
 arcana::virgil::ThreadPoolInterface::ThreadPoolInterface (
   const bool extendible,
   const std::uint32_t numThreads,
-  std::function <void (void)> codeToExecuteAtDeconstructor)
+  std::function <void (void)> codeToExecuteAtDeconstructor,
+  const WorkerConfiguration &configuration)
   :
   m_done{false},
   m_threads{},
-  codeToExecuteByTheDeconstructor{}
+  codeToExecuteByTheDeconstructor{},
+  configuration{configuration}
   {
 
   /*
@@ -155,6 +423,13 @@ arcana::virgil::ThreadPoolInterface::ThreadPoolInterface (
    */
   this->extendible = extendible;
 
+  /*
+   * Calibrate the clock now rather than when the first task gets timed.
+   */
+#if defined(VIRGIL_STATISTICS) || defined(VIRGIL_LATENCY_HISTOGRAMS)
+  TimestampCounter::ticksPerSecond();
+#endif
+
   if (codeToExecuteAtDeconstructor != nullptr){
     this->codeToExecuteByTheDeconstructor.push(codeToExecuteAtDeconstructor);
   }
@@ -162,15 +437,78 @@ arcana::virgil::ThreadPoolInterface::ThreadPoolInterface (
   return ;
 }
 
+arcana::virgil::ThreadPoolInterface::ThreadPoolInterface (
+  SharedExecutor &executor,
+  std::function <void (void)> codeToExecuteAtDeconstructor)
+  : ThreadPoolInterface{false, 0, codeToExecuteAtDeconstructor}
+  {
+  this->executor = &executor;
+
+  /*
+   * Every worker of the executor keeps its own counters of the tasks of this pool.
+   */
+  for (std::uint32_t i = 0; i < executor.numberOfThreads(); i++){
+    this->workerInstrumentation.push_back(new WorkerInstrumentation());
+  }
+
+  return ;
+}
+
 void arcana::virgil::ThreadPoolInterface::appendCodeToDeconstructor (std::function<void ()> codeToExecuteAtDeconstructor){
   this->codeToExecuteByTheDeconstructor.push(codeToExecuteAtDeconstructor);
 
   return ;
 }
 
+void arcana::virgil::ThreadPoolInterface::startThreads (std::uint32_t numThreads){
+
+  /*
+   * Real-time policies need privileges the process might lack.
+   * Check them with a worker that ends right away, so the constructor of the pool fails before the pool has workers.
+   */
+  if (  this->configuration.isRealTime()
+        && (numThreads > 0)
+     ){
+    try {
+      WorkerThread probe{this->configuration, this->configuration.namePrefix, [](void){}};
+      probe.join();
+    } catch (...){
+      this->m_done = true;
+      throw ;
+    }
+  }
+
+  if (  (this->configuration.startMode != StartMode::Lazy)
+        || (numThreads <= 1)
+     ){
+    this->newThreads(numThreads);
+    return ;
+  }
+
+  /*
+   * Start a single worker, and reserve the room of the others so starting them does not move the fields of the workers that run.
+   */
+  this->m_threads.reserve(numThreads);
+  this->threadAvailability.reserve(numThreads);
+  this->workerInstrumentation.reserve(numThreads);
+  this->threadsToStartLazily = numThreads - 1;
+  this->newThreads(1);
+
+  return ;
+}
+
 void arcana::virgil::ThreadPoolInterface::newThreads (std::uint32_t newThreadsToGenerate){
   assert(!this->m_done);
+  if (newThreadsToGenerate == 0){
+    return ;
+  }
+
+  /*
+   * The threads of the previous batch might still be filling m_threads.
+   */
+  this->waitForThreadsToBeCreated();
 
+  std::uint32_t first = this->m_threads.size();
   for (auto i = 0; i < newThreadsToGenerate; i++){
 
     /*
@@ -180,15 +518,157 @@ void arcana::virgil::ThreadPoolInterface::newThreads (std::uint32_t newThreadsTo
     this->threadAvailability.push_back(flag);
 
     /*
-     * Create a new thread.
+     * Create the instrumentation of the new thread.
+     */
+    auto instrumentation = new WorkerInstrumentation();
+    this->workerInstrumentation.push_back(instrumentation);
+
+    /*
+     * Create the slot of the new thread.
      */
-    this->m_threads.emplace_back(&this->workerFunctionTrampoline, this, flag, i);
+    this->m_threads.emplace_back();
+  }
+
+  /*
+   * Create the new threads.
+   */
+  if (  (this->configuration.startMode == StartMode::Parallel)
+        && (newThreadsToGenerate > 1)
+     ){
+    this->spawnFirst = first;
+    this->spawnCount = newThreadsToGenerate;
+    this->threadsBeingCreated.store(newThreadsToGenerate, std::memory_order_release);
+    this->internal_createThread(first, true);
+    return ;
+  }
+  for (auto i = 0; i < newThreadsToGenerate; i++){
+    this->internal_createThread(first + i, false);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::internal_createThread (std::uint32_t thread, bool createChildren){
+  auto availability = this->threadAvailability[thread];
+  auto instrumentation = this->workerInstrumentation[thread];
+  auto name = this->configuration.namePrefix + "-" + std::to_string(workersCreated++);
+  this->m_threads[thread] = WorkerThread{this->configuration, name, [this, availability, instrumentation, thread, createChildren](void){
+    workerFunctionTrampoline(this, availability, instrumentation, thread, createChildren);
+  }};
+  if (createChildren){
+    this->threadsBeingCreated.fetch_sub(1, std::memory_order_release);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::waitForThreadsToBeCreated (void){
+  while (this->threadsBeingCreated.load(std::memory_order_acquire) != 0){
+    std::this_thread::yield();
   }
 
   return ;
 }
 
-void arcana::virgil::ThreadPoolInterface::workerFunctionTrampoline (ThreadPoolInterface *p, std::atomic_bool *availability, std::uint32_t thread) {
+void arcana::virgil::ThreadPoolInterface::cancelLazyThreads (void){
+  this->threadsToStartLazily = 0;
+
+  return ;
+}
+
+std::uint32_t arcana::virgil::ThreadPoolInterface::numberOfLazyThreads (void) const {
+  return this->threadsToStartLazily.load(std::memory_order_relaxed);
+}
+
+bool arcana::virgil::ThreadPoolInterface::startLazyThread (void){
+  auto threadsToStart = this->threadsToStartLazily.load();
+  if (threadsToStart == 0){
+    return false;
+  }
+  this->threadsToStartLazily = threadsToStart - 1;
+  this->newThreads(1);
+
+  return true;
+}
+
+void arcana::virgil::ThreadPoolInterface::internal_startLazyThread (bool start){
+
+  /*
+   * Idle workers will take the waiting tasks.
+   * The waiting tasks are counted before the idle workers, and a worker stops being idle before its task stops being waiting (see workerDidTakeTask).
+   * So a worker that just fetched a task but did not clear its availability yet is not counted as idle for the new task.
+   */
+  auto waitingTasks = this->lazyWaitingTasks.fetch_add(1, std::memory_order_seq_cst) + 1;
+  if (  (!start)
+        || (static_cast<std::int64_t>(this->numberOfIdleThreads()) >= waitingTasks)
+     ){
+    return ;
+  }
+
+  std::lock_guard<std::mutex> lock{this->extendingMutex};
+  this->startLazyThread();
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::warmup (std::size_t stackBytes){
+  std::lock_guard<std::mutex> lock{this->extendingMutex};
+
+  /*
+   * Start every worker.
+   */
+  auto threadsToStart = this->threadsToStartLazily.exchange(0);
+  this->newThreads(threadsToStart);
+  this->waitForThreadsToBeCreated();
+  while (this->threadsStarted.load(std::memory_order_acquire) < this->m_threads.size()){
+    std::this_thread::yield();
+  }
+
+  /*
+   * Pre-fault the top of the stacks, where workers run.
+   * MADV_POPULATE_WRITE maps the pages without changing their content, so the workers can run meanwhile; kernels older than 5.14 reject it.
+   */
+  auto pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+  for (auto &thread : this->m_threads){
+    if (!thread.joinable()){
+      continue ;
+    }
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(thread.native_handle(), &attributes) != 0){
+      continue ;
+    }
+    void *stack = nullptr;
+    std::size_t stackSize = 0;
+    pthread_attr_getstack(&attributes, &stack, &stackSize);
+    pthread_attr_destroy(&attributes);
+    auto top = reinterpret_cast<std::uintptr_t>(stack) + stackSize;
+    auto bottom = (top - std::min(stackBytes, stackSize)) & ~(pageSize - 1);
+    madvise(reinterpret_cast<void *>(bottom), top - bottom, MADV_POPULATE_WRITE);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerFunctionTrampoline (ThreadPoolInterface *p, std::atomic_bool *availability, WorkerInstrumentation *instrumentation, std::uint32_t thread, bool createChildren) {
+
+  /*
+   * Create the next threads of the batch: the i-th thread of the batch creates the (2i+1)-th and the (2i+2)-th ones.
+   */
+  if (createChildren){
+    auto index = thread - p->spawnFirst;
+    for (auto child = (2 * index) + 1; child <= (2 * index) + 2; child++){
+      if (child < p->spawnCount){
+        p->internal_createThread(p->spawnFirst + child, true);
+      }
+    }
+  }
+
+  localInstrumentation = instrumentation;
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  instrumentation->performanceCounters.open();
+#endif
+  p->threadsStarted.fetch_add(1, std::memory_order_release);
+
   if (p->m_done){
     (*availability) = false;
     return ;
@@ -212,9 +692,339 @@ std::uint32_t arcana::virgil::ThreadPoolInterface::numberOfIdleThreads (void) co
   return n;
 }
 
-void arcana::virgil::ThreadPoolInterface::expandPool (void) {
+arcana::virgil::ThreadPoolStatistics arcana::virgil::ThreadPoolInterface::stats (void) const {
+  ThreadPoolStatistics s;
+
+#ifdef VIRGIL_STATISTICS
+  s.enabled = true;
+
+  /*
+   * Aggregate the counters of all workers.
+   */
+  std::lock_guard<std::mutex> lock{this->extendingMutex};
+  for (auto instrumentation : this->workerInstrumentation){
+    auto w = instrumentation->counters.snapshot();
+    s.total += w;
+    s.workers.push_back(w);
+  }
+#endif
+
+  return s;
+}
+
+arcana::virgil::ThreadPoolLatencies arcana::virgil::ThreadPoolInterface::latencies (void) const {
+  ThreadPoolLatencies l;
+
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+  l.enabled = true;
+
+  /*
+   * Merge the histograms of all workers.
+   */
+  std::lock_guard<std::mutex> lock{this->extendingMutex};
+  l.workers.reserve(this->workerInstrumentation.size());
+  for (auto instrumentation : this->workerInstrumentation){
+    auto &w = instrumentation->latencies;
+    l.queueResidence.merge(w.queueResidence);
+    l.execution.merge(w.execution);
+    l.workers.push_back(w);
+  }
+  l.futureWait = *this->futureWait;
+#endif
+
+  return l;
+}
+
+arcana::virgil::ThreadPoolPerformanceCounters arcana::virgil::ThreadPoolInterface::performanceCounters (void) const {
+  ThreadPoolPerformanceCounters c;
+
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  c.enabled = true;
+
+  /*
+   * Merge the counters of all workers.
+   */
+  std::lock_guard<std::mutex> lock{this->extendingMutex};
+  for (auto instrumentation : this->workerInstrumentation){
+    instrumentation->performanceCounters.read(c);
+  }
+  std::sort(c.tasks.begin(), c.tasks.end(), [](const TaskPerformanceCounters &a, const TaskPerformanceCounters &b){
+    return a.values[COUNTER_CYCLES] > b.values[COUNTER_CYCLES];
+  });
+#endif
+
+  return c;
+}
+
+void arcana::virgil::ThreadPoolInterface::setIdleSpinPeriod (std::chrono::microseconds period){
+  this->spinPeriod.store(std::chrono::nanoseconds{period}.count(), std::memory_order_relaxed);
+
+  return ;
+}
+
+std::chrono::microseconds arcana::virgil::ThreadPoolInterface::getIdleSpinPeriod (void) const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(this->idleSpinPeriod());
+}
+
+std::chrono::nanoseconds arcana::virgil::ThreadPoolInterface::idleSpinPeriod (void) const {
+  return std::chrono::nanoseconds{this->spinPeriod.load(std::memory_order_relaxed)};
+}
+
+void arcana::virgil::ThreadPoolInterface::pause (void){
+  this->paused.store(true, std::memory_order_seq_cst);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::resume (void){
+  this->paused.store(false, std::memory_order_seq_cst);
+  this->resumed.notifyAll();
+
+  /*
+   * The workers of the executor skip the tasks of paused pools, so they might sleep while tasks wait.
+   */
+  if (this->executor != nullptr){
+    this->executor->notify(this->numberOfTasksWaitingToBeProcessed());
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::wakeUpPausedWorkers (void){
+  this->resumed.notifyAll();
+
+  return ;
+}
+
+bool arcana::virgil::ThreadPoolInterface::isPaused (void) const {
+  return this->paused.load(std::memory_order_relaxed);
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidTakeTask (std::atomic_bool *availability){
+  (*availability) = false;
+
+  /*
+   * Stop counting the task as waiting only now that the worker is not idle (see internal_startLazyThread).
+   */
+  if (this->threadsToStartLazily.load(std::memory_order_relaxed) > 0){
+    this->lazyWaitingTasks.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerMayPause (const std::atomic_bool *leave){
+
+  /*
+   * The common case costs a single load.
+   */
+  while (  this->paused.load(std::memory_order_acquire)
+           && (!this->m_done)
+           && ((leave == nullptr) || (!leave->load()))
+        ){
+
+    /*
+     * Sleep until the pool is resumed.
+     * The flag is checked again after announcing the wait, so a resume in between is not missed.
+     */
+    auto key = this->resumed.prepareWait();
+    if (  (!this->paused.load(std::memory_order_seq_cst))
+          || this->m_done
+          || ((leave != nullptr) && leave->load())
+       ){
+      this->resumed.cancelWait();
+      break ;
+    }
+    this->resumed.wait(key);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::attachToExecutor (void){
+  if (this->executor != nullptr){
+    this->executor->attach(this);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::detachFromExecutor (void){
+  if (this->executor != nullptr){
+    this->executor->detach(this);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::tasksSubmitted (std::uint64_t tasks){
+  if (this->executor != nullptr){
+    this->tasksForTheExecutor.fetch_add(tasks, std::memory_order_seq_cst);
+    this->executor->notify(tasks);
+  }
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::taskDequeued (void){
+  this->tasksForTheExecutor.fetch_sub(1, std::memory_order_relaxed);
+
+  return ;
+}
+
+bool arcana::virgil::ThreadPoolInterface::runQueuedTask (void){
+  return false;
+}
+
+bool arcana::virgil::ThreadPoolInterface::hasTasks (void) const {
+  if (  this->isPaused()
+        || this->m_done
+     ){
+    return false;
+  }
+
+  return this->tasksForTheExecutor.load(std::memory_order_seq_cst) > 0;
+}
+
+bool arcana::virgil::ThreadPoolInterface::runTask (std::uint32_t worker){
+
+  /*
+   * Account the task to the counters of the calling worker.
+   */
+  auto instrumentation = this->workerInstrumentation.at(worker);
+  localInstrumentation = instrumentation;
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  if (!instrumentation->performanceCountersOpen){
+    instrumentation->performanceCounters.open();
+    instrumentation->performanceCountersOpen = true;
+  }
+#endif
+
+  return this->runQueuedTask();
+}
+
+std::shared_ptr<arcana::virgil::LatencyHistogram> arcana::virgil::ThreadPoolInterface::futureWaitHistogram (void){
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+  return this->futureWait;
+#else
+  return nullptr;
+#endif
+}
+
+void arcana::virgil::ThreadPoolInterface::workerWillWait (void){
+#ifdef VIRGIL_STATISTICS
+  localInstrumentation->counters.beginWait();
+#endif
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidWakeUp (std::nullptr_t noTask){
+#ifdef VIRGIL_STATISTICS
+  localInstrumentation->counters.endWait(!this->m_done, 0);
+#endif
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidWakeUp (const IThreadTask *task){
+  if (task == nullptr){
+    this->workerDidWakeUp(nullptr);
+    return ;
+  }
+  this->workerDidWakeUp(task, task->getSubmissionTime());
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidWakeUp (const virgil_task_t *task){
+  if (task == nullptr){
+    this->workerDidWakeUp(nullptr);
+    return ;
+  }
+  this->workerDidWakeUp(task, task->submission_time);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerWillExecute (const IThreadTask *task){
+  this->workerWillExecute(task, task->getSubmissionTime());
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerWillExecute (const virgil_task_t *task){
+  this->workerWillExecute(task, task->submission_time);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidExecute (const IThreadTask *task){
+  this->workerDidExecute(task, task->getProfilingKey());
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidExecute (const virgil_task_t *task){
+  this->workerDidExecute(task, CTaskDescriptor::getProfilingKey(task));
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidWakeUp (const void *task, std::uint64_t submissionTime){
+#ifdef VIRGIL_STATISTICS
+  localInstrumentation->counters.endWait(false, submissionTime);
+#endif
+  Tracer::record(TRACE_DEQUEUE, task);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerWillExecute (const void *task, std::uint64_t submissionTime){
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+  auto instrumentation = localInstrumentation;
+  auto now = TimestampCounter::read();
+  auto nowInNanoseconds = TimestampCounter::toNanoseconds(now);
+  if (  (submissionTime != 0)
+        && (submissionTime < nowInNanoseconds)
+     ){
+    instrumentation->latencies.queueResidence.record(nowInNanoseconds - submissionTime);
+  }
+  instrumentation->executionStart = now;
+#endif
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  localInstrumentation->performanceCounters.beginTask();
+#endif
+  Tracer::record(TRACE_EXECUTE_BEGIN, task);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::workerDidExecute (const void *task, TaskProfilingKey profilingKey){
+#ifdef VIRGIL_STATISTICS
+  localInstrumentation->counters.endTask();
+#endif
+#ifdef VIRGIL_LATENCY_HISTOGRAMS
+  localInstrumentation->latencies.execution.recordSince(localInstrumentation->executionStart);
+#endif
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  localInstrumentation->performanceCounters.endTask(profilingKey);
+#endif
+  Tracer::record(TRACE_EXECUTE_END, task);
+
+  return ;
+}
+
+void arcana::virgil::ThreadPoolInterface::expandPool (bool startLazyThreads) {
   assert(!this->m_done);
 
+  /*
+   * Lazy pools start their workers as tasks arrive.
+   */
+  if (this->threadsToStartLazily.load(std::memory_order_relaxed) > 0){
+    this->internal_startLazyThread(startLazyThreads);
+  }
+
   /*
    * Check whether we are allow to expand the pool or not.
    */
@@ -241,6 +1051,7 @@ void arcana::virgil::ThreadPoolInterface::expandPool (void) {
 }
       
 void arcana::virgil::ThreadPoolInterface::waitAllThreadsToBeUnavailable (void) {
+  this->waitForThreadsToBeCreated();
   for (auto i=0; i < this->threadAvailability.size(); i++){
     while (*(this->threadAvailability[i]));
   }
@@ -263,6 +1074,7 @@ arcana::virgil::ThreadPoolInterface::~ThreadPoolInterface (void){
   /*
    * Join the threads
    */
+  this->waitForThreadsToBeCreated();
   for(auto& thread : m_threads) {
     if(!thread.joinable()) {
       continue ;
@@ -272,6 +1084,9 @@ arcana::virgil::ThreadPoolInterface::~ThreadPoolInterface (void){
   for (auto flag : this->threadAvailability){
     delete flag;
   }
+  for (auto instrumentation : this->workerInstrumentation){
+    delete instrumentation;
+  }
 
   return ;
 }
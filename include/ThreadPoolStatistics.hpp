@@ -0,0 +1,203 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The WorkerCounters and ThreadPoolStatistics classes.
+ * Per-worker execution counters of a thread pool.
+ *
+ * Counters are collected only if VIRGIL_STATISTICS is defined before including any VIRGIL header.
+ * Otherwise, every counter and every update disappear at compile time.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "TimestampCounter.hpp"
+
+namespace arcana::virgil {
+
+  /*
+   * Values of the counters of a single worker.
+   */
+  struct WorkerStatistics {
+    std::uint64_t tasksExecuted = 0;
+    std::uint64_t busyNanoseconds = 0;
+    std::uint64_t idleNanoseconds = 0;
+    std::uint64_t wakeups = 0;
+    std::uint64_t spuriousWakeups = 0;
+    std::uint64_t queueWaitNanoseconds = 0;
+
+    /*
+     * Accumulate the counters of another worker.
+     */
+    WorkerStatistics & operator+= (const WorkerStatistics &other);
+  };
+
+  /*
+   * Statistics of a whole thread pool.
+   */
+  struct ThreadPoolStatistics {
+
+    /*
+     * Whether or not the counters have been compiled in.
+     */
+    bool enabled = false;
+
+    /*
+     * Sum of the counters of all workers.
+     */
+    WorkerStatistics total;
+
+    /*
+     * Counters of each worker, in order of creation.
+     */
+    std::vector<WorkerStatistics> workers;
+  };
+
+  /*
+   * Counters of a single worker.
+   *
+   * Each instance is written only by the worker it belongs to, and it fills whole cache lines to avoid false sharing between workers.
+   * Other threads can read the counters at any time through snapshot().
+   */
+  class alignas(64) WorkerCounters {
+    public:
+
+      /*
+       * Return the current time in nanoseconds.
+       */
+      static std::uint64_t now (void);
+
+      /*
+       * The worker is about to wait for a task.
+       */
+      void beginWait (void);
+
+      /*
+       * The worker woke up.
+       * @spurious is true if the worker woke up without a task while the pool is still running.
+       * @submissionTime is the time the fetched task has been submitted (0 if unknown or if there is no task).
+       */
+      void endWait (bool spurious, std::uint64_t submissionTime);
+
+      /*
+       * The worker completed the execution of a task.
+       */
+      void endTask (void);
+
+      /*
+       * Read the current values of the counters.
+       */
+      WorkerStatistics snapshot (void) const ;
+
+    private:
+#ifdef VIRGIL_STATISTICS
+      std::atomic<std::uint64_t> tasksExecuted{0};
+      std::atomic<std::uint64_t> busyNanoseconds{0};
+      std::atomic<std::uint64_t> idleNanoseconds{0};
+      std::atomic<std::uint64_t> wakeups{0};
+      std::atomic<std::uint64_t> spuriousWakeups{0};
+      std::atomic<std::uint64_t> queueWaitNanoseconds{0};
+      std::uint64_t lastTimestamp = 0;
+
+      /*
+       * Add @value to @counter.
+       * Only the owner writes the counter, so a relaxed load and store avoid the locked read-modify-write.
+       */
+      static void add (std::atomic<std::uint64_t> &counter, std::uint64_t value);
+#endif
+  };
+
+}
+
+inline arcana::virgil::WorkerStatistics & arcana::virgil::WorkerStatistics::operator+= (const WorkerStatistics &other){
+  this->tasksExecuted += other.tasksExecuted;
+  this->busyNanoseconds += other.busyNanoseconds;
+  this->idleNanoseconds += other.idleNanoseconds;
+  this->wakeups += other.wakeups;
+  this->spuriousWakeups += other.spuriousWakeups;
+  this->queueWaitNanoseconds += other.queueWaitNanoseconds;
+
+  return *this;
+}
+
+inline std::uint64_t arcana::virgil::WorkerCounters::now (void){
+#ifdef VIRGIL_STATISTICS
+  return TimestampCounter::nanoseconds();
+#else
+  return 0;
+#endif
+}
+
+inline void arcana::virgil::WorkerCounters::beginWait (void){
+#ifdef VIRGIL_STATISTICS
+
+  /*
+   * The time spent since the last event has been spent running tasks.
+   */
+  this->lastTimestamp = WorkerCounters::now();
+#endif
+
+  return ;
+}
+
+inline void arcana::virgil::WorkerCounters::endWait (bool spurious, std::uint64_t submissionTime){
+#ifdef VIRGIL_STATISTICS
+  auto t = WorkerCounters::now();
+  add(this->idleNanoseconds, t - this->lastTimestamp);
+  add(this->wakeups, 1);
+  if (spurious){
+    add(this->spuriousWakeups, 1);
+  }
+  if (  (submissionTime != 0)
+        && (submissionTime < t)
+     ){
+    add(this->queueWaitNanoseconds, t - submissionTime);
+  }
+  this->lastTimestamp = t;
+#endif
+
+  return ;
+}
+
+inline void arcana::virgil::WorkerCounters::endTask (void){
+#ifdef VIRGIL_STATISTICS
+  auto t = WorkerCounters::now();
+  add(this->busyNanoseconds, t - this->lastTimestamp);
+  add(this->tasksExecuted, 1);
+  this->lastTimestamp = t;
+#endif
+
+  return ;
+}
+
+inline arcana::virgil::WorkerStatistics arcana::virgil::WorkerCounters::snapshot (void) const {
+  WorkerStatistics s;
+#ifdef VIRGIL_STATISTICS
+  s.tasksExecuted = this->tasksExecuted.load(std::memory_order_relaxed);
+  s.busyNanoseconds = this->busyNanoseconds.load(std::memory_order_relaxed);
+  s.idleNanoseconds = this->idleNanoseconds.load(std::memory_order_relaxed);
+  s.wakeups = this->wakeups.load(std::memory_order_relaxed);
+  s.spuriousWakeups = this->spuriousWakeups.load(std::memory_order_relaxed);
+  s.queueWaitNanoseconds = this->queueWaitNanoseconds.load(std::memory_order_relaxed);
+#endif
+
+  return s;
+}
+
+#ifdef VIRGIL_STATISTICS
+inline void arcana::virgil::WorkerCounters::add (std::atomic<std::uint64_t> &counter, std::uint64_t value){
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+
+  return ;
+}
+#endif
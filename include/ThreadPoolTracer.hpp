@@ -0,0 +1,450 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The Tracer class.
+ * Records a timeline of the events of the thread pools into a binary file.
+ *
+ * Events are recorded only if VIRGIL_TRACING is defined before including any VIRGIL header and Tracer::instance().start() has been invoked.
+ * Each thread writes its events into its own lock-free ring buffer.
+ * A background thread drains these buffers into the trace file.
+ * The trace file can be converted to the Chrome trace format (which Perfetto can open too) by tools/trace2json.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TimestampCounter.hpp"
+
+namespace arcana::virgil {
+
+  /*
+   * Events that can be traced.
+   */
+  enum TraceEventType : std::uint32_t {
+    TRACE_SUBMIT = 0,
+    TRACE_DEQUEUE,
+    TRACE_EXECUTE_BEGIN,
+    TRACE_EXECUTE_END,
+    TRACE_END
+  };
+
+  /*
+   * Layout of the trace file:
+   *   TraceFileHeader
+   *   TraceEvent ...                 (all events, in no particular order)
+   *   TraceEvent with type TRACE_END
+   *   TraceFileTrailer
+   *   TraceThreadRecord ...          (TraceFileTrailer::threads of them)
+   */
+  struct TraceFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t eventSize;
+    double ticksPerSecond;
+  };
+
+  struct TraceEvent {
+    std::uint64_t timestamp;
+    std::uint64_t task;
+    std::uint32_t thread;
+    std::uint32_t type;
+  };
+
+  struct TraceFileTrailer {
+    std::uint64_t threads;
+    std::uint64_t droppedEvents;
+  };
+
+  struct TraceThreadRecord {
+    std::uint32_t thread;
+    char name[16];
+  };
+
+  /*
+   * Single-producer single-consumer ring buffer of events.
+   * The producer is the thread that owns the buffer; the consumer is the background thread of the tracer.
+   */
+  class TraceBuffer {
+    public:
+
+      /*
+       * Constructor.
+       * @capacity must be a power of two.
+       */
+      explicit TraceBuffer (std::uint32_t capacity);
+
+      /*
+       * Append an event.
+       * If the buffer is full, the event is dropped.
+       */
+      void record (std::uint32_t type, std::uint64_t task);
+
+      /*
+       * Write all events of the buffer to @file.
+       */
+      void drain (FILE *file);
+
+      /*
+       * Discard all events of the buffer.
+       */
+      void discard (void);
+
+      ~TraceBuffer (void);
+
+      TraceBuffer (const TraceBuffer &other) = delete;
+      TraceBuffer & operator= (const TraceBuffer &other) = delete;
+
+      /*
+       * Fields.
+       */
+      std::uint32_t thread;
+      char threadName[16];
+      std::atomic_bool inUse{true};
+      std::atomic<std::uint64_t> dropped{0};
+
+    private:
+      TraceEvent *events;
+      std::uint64_t mask;
+      alignas(64) std::atomic<std::uint64_t> head{0};
+      alignas(64) std::atomic<std::uint64_t> tail{0};
+  };
+
+  /*
+   * Buffer of a thread, released when the thread exits.
+   */
+  struct TraceBufferOwner {
+    TraceBuffer *buffer = nullptr;
+    ~TraceBufferOwner (void);
+  };
+
+  class Tracer {
+    public:
+
+      /*
+       * Return the tracer of the process.
+       */
+      static Tracer & instance (void);
+
+      /*
+       * Start tracing to the file @fileName.
+       * Each thread can buffer up to @eventsPerThread events (rounded up to a power of two) before events are dropped.
+       * Return false if the tracer is already running or if the file cannot be created.
+       */
+      bool start (const std::string &fileName, std::uint32_t eventsPerThread = 1u << 14);
+
+      /*
+       * Stop tracing and close the trace file.
+       */
+      void stop (void);
+
+      /*
+       * Check whether or not events are being recorded.
+       */
+      bool isTracing (void) const ;
+
+      /*
+       * Record an event of the invoking thread.
+       * This is a no-op unless VIRGIL_TRACING is defined and the tracer is running.
+       */
+      static void record (TraceEventType type, const void *task);
+
+      ~Tracer (void);
+
+      Tracer (const Tracer &other) = delete;
+      Tracer & operator= (const Tracer &other) = delete;
+
+    private:
+      Tracer (void) = default;
+
+      /*
+       * Buffer of the invoking thread.
+       */
+      inline static thread_local TraceBufferOwner localBuffer;
+
+      /*
+       * Fields.
+       */
+      std::atomic_bool enabled{false};
+      std::atomic_bool flushing{false};
+      std::mutex buffersMutex;
+      std::vector<TraceBuffer *> buffers;
+      std::vector<TraceThreadRecord> threads;
+      std::uint32_t nextThread = 0;
+      std::uint32_t eventsPerBuffer = 0;
+      FILE *file = nullptr;
+      std::thread flusher;
+
+      /*
+       * Return the buffer of the invoking thread.
+       */
+      TraceBuffer * bufferOfThisThread (void);
+
+      /*
+       * Drain all buffers to the trace file.
+       */
+      void drainAll (void);
+      void flusherFunction (void);
+  };
+
+}
+
+inline arcana::virgil::TraceBuffer::TraceBuffer (std::uint32_t capacity)
+  : thread{0}
+  , mask{capacity - 1u}
+  {
+  this->events = new TraceEvent[capacity];
+  memset(this->threadName, 0, sizeof(this->threadName));
+
+  return ;
+}
+
+inline void arcana::virgil::TraceBuffer::record (std::uint32_t type, std::uint64_t task){
+  auto h = this->head.load(std::memory_order_relaxed);
+
+  /*
+   * Check if there is space.
+   */
+  if ((h - this->tail.load(std::memory_order_acquire)) > this->mask){
+    this->dropped.store(this->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return ;
+  }
+
+  /*
+   * Append the event.
+   */
+  auto &e = this->events[h & this->mask];
+  e.timestamp = TimestampCounter::read();
+  e.task = task;
+  e.thread = this->thread;
+  e.type = type;
+  this->head.store(h + 1, std::memory_order_release);
+
+  return ;
+}
+
+inline void arcana::virgil::TraceBuffer::drain (FILE *file){
+  auto t = this->tail.load(std::memory_order_relaxed);
+  auto h = this->head.load(std::memory_order_acquire);
+
+  /*
+   * Write the events, which can wrap around the end of the buffer.
+   */
+  while (t != h){
+    auto first = t & this->mask;
+    auto n = std::min(h - t, (this->mask + 1) - first);
+    fwrite(this->events + first, sizeof(TraceEvent), n, file);
+    t += n;
+  }
+  this->tail.store(t, std::memory_order_release);
+
+  return ;
+}
+
+inline void arcana::virgil::TraceBuffer::discard (void){
+  this->tail.store(this->head.load(std::memory_order_acquire), std::memory_order_release);
+
+  return ;
+}
+
+inline arcana::virgil::TraceBuffer::~TraceBuffer (void){
+  delete[] this->events;
+
+  return ;
+}
+
+inline arcana::virgil::Tracer & arcana::virgil::Tracer::instance (void){
+  static Tracer tracer;
+
+  return tracer;
+}
+
+inline bool arcana::virgil::Tracer::start (const std::string &fileName, std::uint32_t eventsPerThread){
+  std::lock_guard<std::mutex> lock{this->buffersMutex};
+  if (this->file != nullptr){
+    return false;
+  }
+
+  /*
+   * Create the trace file.
+   */
+  this->file = fopen(fileName.c_str(), "wb");
+  if (this->file == nullptr){
+    return false;
+  }
+  TraceFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "VIRGILT", 8);
+  header.version = 1;
+  header.eventSize = sizeof(TraceEvent);
+  header.ticksPerSecond = TimestampCounter::ticksPerSecond();
+  fwrite(&header, sizeof(header), 1, this->file);
+
+  /*
+   * Forget events recorded by a previous trace.
+   * Buffers of threads that are still alive keep their identifiers, so describe these threads again.
+   */
+  this->threads.clear();
+  for (auto buffer : this->buffers){
+    buffer->discard();
+    buffer->dropped = 0;
+    if (buffer->inUse){
+      TraceThreadRecord r;
+      r.thread = buffer->thread;
+      memcpy(r.name, buffer->threadName, sizeof(r.name));
+      this->threads.push_back(r);
+    }
+  }
+  this->eventsPerBuffer = 1;
+  while (this->eventsPerBuffer < eventsPerThread){
+    this->eventsPerBuffer <<= 1;
+  }
+
+  /*
+   * Start the background thread.
+   */
+  this->flushing = true;
+  this->flusher = std::thread(&Tracer::flusherFunction, this);
+  this->enabled = true;
+
+  return true;
+}
+
+inline void arcana::virgil::Tracer::stop (void){
+  if (!this->enabled.exchange(false)){
+    return ;
+  }
+
+  /*
+   * Stop the background thread.
+   */
+  this->flushing = false;
+  this->flusher.join();
+
+  /*
+   * Write the remaining events and the description of the threads.
+   */
+  std::lock_guard<std::mutex> lock{this->buffersMutex};
+  TraceFileTrailer trailer{this->threads.size(), 0};
+  for (auto buffer : this->buffers){
+    buffer->drain(this->file);
+    trailer.droppedEvents += buffer->dropped;
+  }
+  TraceEvent end;
+  memset(&end, 0, sizeof(end));
+  end.type = TRACE_END;
+  fwrite(&end, sizeof(end), 1, this->file);
+  fwrite(&trailer, sizeof(trailer), 1, this->file);
+  fwrite(this->threads.data(), sizeof(TraceThreadRecord), this->threads.size(), this->file);
+  fclose(this->file);
+  this->file = nullptr;
+
+  return ;
+}
+
+inline bool arcana::virgil::Tracer::isTracing (void) const {
+  return this->enabled.load(std::memory_order_relaxed);
+}
+
+inline void arcana::virgil::Tracer::record (TraceEventType type, const void *task){
+#ifdef VIRGIL_TRACING
+  auto &tracer = Tracer::instance();
+  if (!tracer.enabled.load(std::memory_order_relaxed)){
+    return ;
+  }
+  auto buffer = localBuffer.buffer;
+  if (buffer == nullptr){
+    buffer = tracer.bufferOfThisThread();
+  }
+  buffer->record(type, reinterpret_cast<std::uint64_t>(task));
+#endif
+
+  return ;
+}
+
+inline arcana::virgil::TraceBuffer * arcana::virgil::Tracer::bufferOfThisThread (void){
+  std::lock_guard<std::mutex> lock{this->buffersMutex};
+
+  /*
+   * Reuse the buffer of a thread that exited, if any.
+   */
+  TraceBuffer *buffer = nullptr;
+  for (auto b : this->buffers){
+    if (!b->inUse){
+      buffer = b;
+      break ;
+    }
+  }
+  if (buffer == nullptr){
+    buffer = new TraceBuffer(this->eventsPerBuffer);
+    this->buffers.push_back(buffer);
+  }
+  buffer->inUse = true;
+
+  /*
+   * Identify the thread.
+   */
+  buffer->thread = this->nextThread++;
+  memset(buffer->threadName, 0, sizeof(buffer->threadName));
+  pthread_getname_np(pthread_self(), buffer->threadName, sizeof(buffer->threadName));
+  TraceThreadRecord r;
+  r.thread = buffer->thread;
+  memcpy(r.name, buffer->threadName, sizeof(r.name));
+  this->threads.push_back(r);
+
+  localBuffer.buffer = buffer;
+
+  return buffer;
+}
+
+inline void arcana::virgil::Tracer::drainAll (void){
+  std::lock_guard<std::mutex> lock{this->buffersMutex};
+  for (auto buffer : this->buffers){
+    buffer->drain(this->file);
+  }
+
+  return ;
+}
+
+inline void arcana::virgil::Tracer::flusherFunction (void){
+  while (this->flushing){
+    this->drainAll();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  return ;
+}
+
+inline arcana::virgil::TraceBufferOwner::~TraceBufferOwner (void){
+  if (this->buffer != nullptr){
+    this->buffer->inUse = false;
+  }
+
+  return ;
+}
+
+inline arcana::virgil::Tracer::~Tracer (void){
+  this->stop();
+  for (auto buffer : this->buffers){
+    delete buffer;
+  }
+
+  return ;
+}
@@ -16,3 +16,4 @@
 #include "ThreadPool.hpp"
 #include "ThreadPoolForCSingleQueue.hpp"
 #include "ThreadPoolForCMultiQueues.hpp"
+#include "BasicThreadPool.hpp"
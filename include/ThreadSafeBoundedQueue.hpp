@@ -0,0 +1,638 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The ThreadSafeBoundedQueue class.
+ * Queue with a capacity fixed at construction that supports any number of producers and consumers without locks.
+ *
+ * Values are stored in an array of cells, each tagged by a sequence number that tells producers and consumers whose turn it is (D. Vyukov's bounded MPMC queue).
+ * A producer that finds the queue full sleeps on a futex until a consumer makes room, and a consumer that finds it empty sleeps until a producer pushes a value.
+ * Either side makes a system call only when the other one sleeps, so a pipeline stage that runs ahead of the next one is throttled without burning a core.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "ThreadSafeQueue.hpp"
+#include "EventCount.hpp"
+
+namespace arcana::virgil {
+
+  template <typename T>
+  class ThreadSafeBoundedQueue final : public ThreadSafeQueue<T> {
+    using Base = arcana::virgil::ThreadSafeQueue<T>;
+
+    public:
+
+      /*
+       * Default constructor
+       */
+      ThreadSafeBoundedQueue ();
+
+      /*
+       * Constructor.
+       * The queue holds at most @capacity values (rounded up to a power of two).
+       */
+      explicit ThreadSafeBoundedQueue (std::uint64_t capacity);
+
+      /*
+       * Attempt to get the first value in the queue.
+       * Returns true if a value was successfully written to the out parameter, false otherwise.
+       */
+      bool tryPop (T& out) override ;
+
+      /*
+       * Get the first value in the queue.
+       * Will block until a value is available unless clear is called or the instance is destructed.
+       * Returns true if a value was successfully written to the out parameter, false otherwise.
+       */
+      bool waitPop (T& out) override ;
+      bool waitPop (void) override ;
+
+      /*
+       * Push a new value onto the queue.
+       * Will block while the queue is full unless the queue is invalidated, in which case the value is dropped.
+       */
+      void push (T value) override ;
+
+      /*
+       * Push a new value onto the queue if it is not full.
+       * Returns true if the value has been pushed, false otherwise.
+       */
+      bool tryPush (T value);
+
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize.
+       * Otherwise, wait for it to happen and then push the new value.
+       * The capacity of the queue bounds maxSize.
+       */
+      bool waitPush (T value, int64_t maxSize) override ;
+
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      bool tryPush (T& value, int64_t maxSize) override ;
+
+      /*
+       * Push the values in [first, last) onto the queue, waiting for room as needed.
+       * Consecutive free cells are reserved with a single compare-and-swap.
+       */
+      void pushBulk (T *first, T *last) override ;
+
+      /*
+       * Pop up to max values without waiting.
+       * Returns the number of values popped.
+       */
+      std::uint64_t tryPopBulk (T *out, std::uint64_t max) override ;
+
+      /*
+       * Wait until at least min values are available, and then pop up to max of them.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       */
+      std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) override ;
+
+      /*
+       * Clear all items from the queue.
+       */
+      void clear (void) override ;
+
+      /*
+       * Invalidate the queue and wake up all threads waiting on it.
+       */
+      void invalidate (void) override ;
+
+      /*
+       * Check whether or not the queue is empty.
+       */
+      bool empty (void) const override ;
+
+      /*
+       * Return the number of elements in the queue.
+       */
+      int64_t size (void) const override ;
+
+      /*
+       * Return the maximum number of elements the queue can hold.
+       */
+      std::uint64_t capacity (void) const ;
+
+      /*
+       * Destructor.
+       */
+      ~ThreadSafeBoundedQueue(void);
+
+      /*
+       * Not copyable.
+       */
+      ThreadSafeBoundedQueue (const ThreadSafeBoundedQueue & other) = delete;
+      ThreadSafeBoundedQueue & operator= (const ThreadSafeBoundedQueue & other) = delete;
+
+      /*
+       * Not assignable.
+       */
+      ThreadSafeBoundedQueue (const ThreadSafeBoundedQueue && other) = delete;
+      ThreadSafeBoundedQueue & operator= (const ThreadSafeBoundedQueue && other) = delete;
+
+    private:
+      static constexpr std::uint64_t defaultCapacity = 1024;
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+
+      struct Cell {
+        std::atomic<std::uint64_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+      };
+
+      /*
+       * Fields.
+       */
+      Cell *cells;
+      std::uint64_t mask;
+      alignas(64) std::atomic<std::uint64_t> enqueuePosition{0};
+      alignas(64) std::atomic<std::uint64_t> dequeuePosition{0};
+      EventCount notEmpty;
+      EventCount notFull;
+
+      /*
+       * Methods.
+       */
+      std::uint64_t pushToCells (T *first, std::uint64_t n);
+      std::uint64_t popFromCells (T *out, std::uint64_t max);
+      bool waitForRoom (T *first, std::uint64_t n, std::uint64_t &pushed);
+      void notifyPushes (std::uint64_t pushed);
+      void notifyPops (std::uint64_t popped);
+  };
+}
+
+template <typename T>
+arcana::virgil::ThreadSafeBoundedQueue<T>::ThreadSafeBoundedQueue()
+  : ThreadSafeBoundedQueue{defaultCapacity}
+  {
+
+  return ;
+}
+
+template <typename T>
+arcana::virgil::ThreadSafeBoundedQueue<T>::ThreadSafeBoundedQueue (std::uint64_t capacity){
+
+  /*
+   * Allocate the cells.
+   */
+  std::uint64_t c = 2;
+  while (c < capacity){
+    c *= 2;
+  }
+  this->cells = static_cast<Cell *>(::operator new(c * sizeof(Cell), std::align_val_t{64}));
+  this->mask = c - 1;
+
+  /*
+   * Cell i is free for the producer that reserves position i.
+   */
+  for (std::uint64_t i = 0; i < c; i++){
+    new (&this->cells[i].sequence) std::atomic<std::uint64_t>(i);
+  }
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::tryPop (T& out){
+  if (!Base::m_valid){
+    return false;
+  }
+
+  auto popped = this->popFromCells(&out, 1);
+  this->notifyPops(popped);
+
+  return popped == 1;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::waitPop (T& out){
+  return this->waitPopBulk(&out, 1, 1) == 1;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::waitPop (void){
+  T out;
+  return waitPop(out);
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeBoundedQueue<T>::push (T value){
+  this->pushBulk(&value, &value + 1);
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::tryPush (T value){
+  if (!Base::m_valid){
+    return false;
+  }
+
+  auto pushed = this->pushToCells(&value, 1);
+  this->notifyPushes(pushed);
+
+  return pushed == 1;
+}
+ 
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::waitPush (T value, int64_t maxSize){
+
+  /*
+   * Wait until the queue has less elements than maxSize.
+   * A full queue is handled by pushBulk.
+   */
+  while (this->size() >= maxSize){
+    if (!Base::m_valid){
+      return false;
+    }
+    auto key = this->notFull.prepareWait();
+    if (  (this->size() < maxSize)
+          || (!Base::m_valid)
+       ){
+      this->notFull.cancelWait();
+      continue ;
+    }
+    this->notFull.wait(key);
+  }
+  if (!Base::m_valid){
+    return false;
+  }
+
+  /*
+   * Push
+   */
+  std::uint64_t pushed = 0;
+  while (pushed == 0){
+    pushed = this->pushToCells(&value, 1);
+    if (  (pushed == 0)
+          && (!this->waitForRoom(&value, 1, pushed))
+       ){
+      return false;
+    }
+  }
+  this->notifyPushes(pushed);
+
+  return true;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::tryPush (T& value, int64_t maxSize){
+
+  /*
+   * Concurrent producers can all pass the check, so the bound is approximate, but the capacity of the queue is never exceeded.
+   */
+  if (  (!Base::m_valid)
+        || (this->size() >= maxSize)
+     ){
+    return false;
+  }
+
+  auto pushed = this->pushToCells(&value, 1);
+  this->notifyPushes(pushed);
+
+  return pushed == 1;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeBoundedQueue<T>::pushBulk (T *first, T *last){
+  auto n = static_cast<std::uint64_t>(last - first);
+  std::uint64_t pushed = 0;
+  while (pushed < n){
+    if (!Base::m_valid){
+      return ;
+    }
+
+    /*
+     * Fill the free cells and let consumers start on them before waiting for more room.
+     */
+    auto p = this->pushToCells(first + pushed, n - pushed);
+    this->notifyPushes(p);
+    pushed += p;
+    if (pushed == n){
+      break ;
+    }
+    auto before = pushed;
+    if (!this->waitForRoom(first, n, pushed)){
+      return ;
+    }
+    this->notifyPushes(pushed - before);
+  }
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeBoundedQueue<T>::tryPopBulk (T *out, std::uint64_t max){
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  auto popped = this->popFromCells(out, max);
+  this->notifyPops(popped);
+
+  return popped;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeBoundedQueue<T>::waitPopBulk (T *out, std::uint64_t min, std::uint64_t max){
+  if (max == 0){
+    return 0;
+  }
+  min = std::min(std::max<std::uint64_t>(min, 1), max);
+
+  /*
+   * A full queue never satisfies a minimum larger than its capacity.
+   */
+  min = std::min(min, this->capacity());
+
+  std::uint64_t popped = 0;
+  std::uint32_t spins = 0;
+  while (true){
+    if (!Base::m_valid){
+      return 0;
+    }
+
+    /*
+     * Take what is available.
+     * Producers are notified right away, as they might be waiting for the room just made.
+     */
+    auto p = this->popFromCells(out + popped, max - popped);
+    this->notifyPops(p);
+    popped += p;
+    if (popped >= min){
+      break ;
+    }
+    if (p > 0){
+      spins = 0;
+      continue ;
+    }
+
+    /*
+     * Spin for a while before sleeping, as a value often arrives shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Sleep until a producer pushes new values.
+     * The queue is checked again after announcing the wait, so a value pushed in between is not missed.
+     */
+    auto key = this->notEmpty.prepareWait();
+    p = this->popFromCells(out + popped, max - popped);
+    this->notifyPops(p);
+    popped += p;
+    if (  (popped >= min)
+          || (p > 0)
+          || (!Base::m_valid)
+       ){
+      this->notEmpty.cancelWait();
+      continue ;
+    }
+    this->notEmpty.wait(key);
+  }
+
+  return popped;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::empty (void) const {
+  return this->size() == 0;
+}
+
+template <typename T>
+int64_t arcana::virgil::ThreadSafeBoundedQueue<T>::size (void) const {
+  auto head = this->dequeuePosition.load(std::memory_order_acquire);
+  auto tail = this->enqueuePosition.load(std::memory_order_acquire);
+
+  return (tail > head) ? static_cast<int64_t>(tail - head) : 0;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeBoundedQueue<T>::capacity (void) const {
+  return this->mask + 1;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeBoundedQueue<T>::clear (void) {
+  T out;
+  while (this->popFromCells(&out, 1) == 1){
+  }
+  this->notFull.notifyAll();
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeBoundedQueue<T>::invalidate (void) {
+  Base::m_valid = false;
+
+  /*
+   * Wake up everybody waiting.
+   */
+  this->notEmpty.notifyAll();
+  this->notFull.notifyAll();
+
+  return ;
+}
+
+template <typename T>
+arcana::virgil::ThreadSafeBoundedQueue<T>::~ThreadSafeBoundedQueue(void){
+  this->invalidate();
+
+  /*
+   * Destroy the values left in the cells.
+   */
+  auto head = this->dequeuePosition.load(std::memory_order_acquire);
+  auto tail = this->enqueuePosition.load(std::memory_order_acquire);
+  for (auto p = head; p < tail; p++){
+    auto &cell = this->cells[p & this->mask];
+    if (cell.sequence.load(std::memory_order_acquire) == (p + 1)){
+      reinterpret_cast<T *>(cell.storage)->~T();
+    }
+  }
+  ::operator delete(this->cells, std::align_val_t{64});
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeBoundedQueue<T>::pushToCells (T *first, std::uint64_t n){
+  std::uint64_t pushed = 0;
+  auto position = this->enqueuePosition.load(std::memory_order_relaxed);
+  while (pushed < n){
+
+    /*
+     * Count the consecutive cells, starting from position, that are free.
+     */
+    std::uint64_t free = 0;
+    while (  ((pushed + free) < n)
+             && (this->cells[(position + free) & this->mask].sequence.load(std::memory_order_acquire) == (position + free))
+          ){
+      free++;
+    }
+    if (free == 0){
+
+      /*
+       * Either the cells are full or another producer reserved position.
+       */
+      auto sequence = this->cells[position & this->mask].sequence.load(std::memory_order_acquire);
+      if (static_cast<std::int64_t>(sequence - position) < 0){
+        break ;
+      }
+      position = this->enqueuePosition.load(std::memory_order_relaxed);
+      continue ;
+    }
+
+    /*
+     * Reserve the free cells.
+     */
+    if (!this->enqueuePosition.compare_exchange_weak(position, position + free, std::memory_order_relaxed)){
+      continue ;
+    }
+
+    /*
+     * Store the values and hand the cells over to the consumers.
+     */
+    for (std::uint64_t i = 0; i < free; i++){
+      auto &cell = this->cells[(position + i) & this->mask];
+      new (cell.storage) T(std::move(first[pushed + i]));
+      cell.sequence.store(position + i + 1, std::memory_order_release);
+    }
+    pushed += free;
+    position += free;
+  }
+
+  return pushed;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeBoundedQueue<T>::popFromCells (T *out, std::uint64_t max){
+  std::uint64_t popped = 0;
+  auto position = this->dequeuePosition.load(std::memory_order_relaxed);
+  while (popped < max){
+
+    /*
+     * Count the consecutive cells, starting from position, that hold a value.
+     */
+    std::uint64_t full = 0;
+    while (  ((popped + full) < max)
+             && (this->cells[(position + full) & this->mask].sequence.load(std::memory_order_acquire) == (position + full + 1))
+          ){
+      full++;
+    }
+    if (full == 0){
+
+      /*
+       * Either the cells are empty or another consumer reserved position.
+       */
+      auto sequence = this->cells[position & this->mask].sequence.load(std::memory_order_acquire);
+      if (static_cast<std::int64_t>(sequence - (position + 1)) < 0){
+        break ;
+      }
+      position = this->dequeuePosition.load(std::memory_order_relaxed);
+      continue ;
+    }
+
+    /*
+     * Reserve the cells.
+     */
+    if (!this->dequeuePosition.compare_exchange_weak(position, position + full, std::memory_order_relaxed)){
+      continue ;
+    }
+
+    /*
+     * Fetch the values and hand the cells back to the producers of the next round.
+     */
+    for (std::uint64_t i = 0; i < full; i++){
+      auto &cell = this->cells[(position + i) & this->mask];
+      auto value = reinterpret_cast<T *>(cell.storage);
+      out[popped + i] = std::move(*value);
+      value->~T();
+      cell.sequence.store(position + i + this->mask + 1, std::memory_order_release);
+    }
+    popped += full;
+    position += full;
+  }
+
+  return popped;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeBoundedQueue<T>::waitForRoom (T *first, std::uint64_t n, std::uint64_t &pushed){
+  std::uint32_t spins = 0;
+  while (true){
+    if (!Base::m_valid){
+      return false;
+    }
+
+    /*
+     * Spin for a while before sleeping, as consumers often make room shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      auto p = this->pushToCells(first + pushed, n - pushed);
+      if (p > 0){
+        pushed += p;
+        return true;
+      }
+      continue ;
+    }
+
+    /*
+     * Sleep until a consumer pops a value.
+     * The queue is checked again after announcing the wait, so room made in between is not missed.
+     */
+    auto key = this->notFull.prepareWait();
+    auto p = this->pushToCells(first + pushed, n - pushed);
+    if (  (p > 0)
+          || (!Base::m_valid)
+       ){
+      this->notFull.cancelWait();
+      pushed += p;
+      return Base::m_valid || (p > 0);
+    }
+    this->notFull.wait(key);
+  }
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeBoundedQueue<T>::notifyPushes (std::uint64_t pushed){
+  if (pushed == 1){
+    this->notEmpty.notify();
+  } else if (pushed > 1){
+    this->notEmpty.notifyAll();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeBoundedQueue<T>::notifyPops (std::uint64_t popped){
+
+  /*
+   * The notification costs a single load unless a producer waits for room.
+   */
+  if (popped == 1){
+    this->notFull.notify();
+  } else if (popped > 1){
+    this->notFull.notifyAll();
+  }
+
+  return ;
+}
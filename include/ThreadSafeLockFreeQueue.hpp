@@ -1,5 +1,5 @@
 /*
- * Copyright 2017 - 2019  Simone Campanoni
+ * Copyright 2017 - 2021  Simone Campanoni
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
 
@@ -10,21 +10,23 @@
  *
  *
  * The ThreadSafeLockFreeQueue class.
- * Provides a wrapper around a basic queue to provide thread safety.
+ * Queue that supports any number of producers and consumers without locks.
+ *
+ * Values are stored in a bounded array of cells, each tagged by a sequence number that tells producers and consumers whose turn it is (D. Vyukov's bounded MPMC queue).
+ * When the array is full, values spill to an overflow buffer protected by a mutex, so push never fails nor blocks; producers go back to the array once the overflow has been drained.
+ * Consumers that find the queue empty sleep on a futex, and producers make a system call only when a consumer sleeps.
  */
 #pragma once
 
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
+#include <cstdint>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <utility>
-#include <pthread.h>
-
-#include <ThreadSafeQueue.hpp>
-#include <readerwriterqueue/readerwriterqueue.h>
 
-using namespace moodycamel ;
+#include "ThreadSafeQueue.hpp"
+#include "EventCount.hpp"
 
 namespace arcana::virgil {
 
@@ -39,6 +41,12 @@ namespace arcana::virgil {
        */
       ThreadSafeLockFreeQueue ();
 
+      /*
+       * Constructor.
+       * The lock-free array holds @capacity values (rounded up to a power of two).
+       */
+      explicit ThreadSafeLockFreeQueue (std::uint64_t capacity);
+
       /*
        * Attempt to get the first value in the queue.
        * Returns true if a value was successfully written to the out parameter, false otherwise.
@@ -64,11 +72,39 @@ namespace arcana::virgil {
        */
       bool waitPush (T value, int64_t maxSize) override ;
 
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      bool tryPush (T& value, int64_t maxSize) override ;
+
+      /*
+       * Push the values in [first, last) onto the queue reserving their cells with a single compare-and-swap.
+       */
+      void pushBulk (T *first, T *last) override ;
+
+      /*
+       * Pop up to max values without waiting.
+       * Returns the number of values popped.
+       */
+      std::uint64_t tryPopBulk (T *out, std::uint64_t max) override ;
+
+      /*
+       * Wait until at least min values are available, and then pop up to max of them.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       */
+      std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) override ;
+
       /*
        * Clear all items from the queue.
        */
       void clear (void) override ;
 
+      /*
+       * Invalidate the queue and wake up all threads waiting on it.
+       */
+      void invalidate (void) override ;
+
       /*
        * Check whether or not the queue is empty.
        */
@@ -97,57 +133,86 @@ namespace arcana::virgil {
       ThreadSafeLockFreeQueue & operator= (const ThreadSafeLockFreeQueue && other) = delete;
 
     private:
-      mutable BlockingReaderWriterQueue<T> queue;
+      static constexpr std::uint64_t defaultCapacity = 4096;
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+
+      struct Cell {
+        std::atomic<std::uint64_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+      };
+
+      /*
+       * Fields.
+       * The overflow values are stored in Base::m_queue.
+       */
+      Cell *cells;
+      std::uint64_t mask;
+      alignas(64) std::atomic<std::uint64_t> enqueuePosition{0};
+      alignas(64) std::atomic<std::uint64_t> dequeuePosition{0};
+      alignas(64) std::atomic<std::uint64_t> overflowSize{0};
+      std::mutex overflowMutex;
+      EventCount notEmpty;
+      EventCount notFull;
+
+      /*
+       * Methods.
+       */
+      std::uint64_t pushToCells (T *first, std::uint64_t n);
+      std::uint64_t popFromCells (T *out, std::uint64_t max);
+      void pushToOverflow (T *first, std::uint64_t n);
+      std::uint64_t popFromOverflow (T *out, std::uint64_t max);
+      std::uint64_t popAvailable (T *out, std::uint64_t max);
+      void notifyPushes (std::uint64_t pushed);
+      void notifyPops (std::uint64_t popped);
   };
 }
 
 template <typename T>
-arcana::virgil::ThreadSafeLockFreeQueue<T>::ThreadSafeLockFreeQueue(){
+arcana::virgil::ThreadSafeLockFreeQueue<T>::ThreadSafeLockFreeQueue()
+  : ThreadSafeLockFreeQueue{defaultCapacity}
+  {
 
   return ;
 }
 
 template <typename T>
-bool arcana::virgil::ThreadSafeLockFreeQueue<T>::tryPop (T& out){
+arcana::virgil::ThreadSafeLockFreeQueue<T>::ThreadSafeLockFreeQueue (std::uint64_t capacity){
 
   /*
-   * Check if the queue is not valid anymore.
+   * Allocate the cells.
    */
-  if (!Base::m_valid){
-    return false;
+  std::uint64_t c = 2;
+  while (c < capacity){
+    c *= 2;
   }
+  this->cells = static_cast<Cell *>(::operator new(c * sizeof(Cell), std::align_val_t{64}));
+  this->mask = c - 1;
 
   /*
-   * Try to pop.
+   * Cell i is free for the producer that reserves position i.
    */
-  auto success = queue.try_dequeue(out);
+  for (std::uint64_t i = 0; i < c; i++){
+    new (&this->cells[i].sequence) std::atomic<std::uint64_t>(i);
+  }
 
-  return success;
+  return ;
 }
 
 template <typename T>
-bool arcana::virgil::ThreadSafeLockFreeQueue<T>::waitPop (T& out){
-
-  /*
-   * Check if the queue is not valid anymore.
-   */
-  if(!Base::m_valid) {
+bool arcana::virgil::ThreadSafeLockFreeQueue<T>::tryPop (T& out){
+  if (!Base::m_valid){
     return false;
   }
 
-  /*
-   * Wait until the queue will be in a valid state and it will be not empty.
-   */
-  while (Base::m_valid){
-    if (queue.wait_dequeue_timed(out, std::chrono::milliseconds(5))){
-      break ;
-    }
-  }
+  auto popped = this->popAvailable(&out, 1);
+  this->notifyPops(popped);
 
-  /*
-   * If the queue is still valid, then a value has been popped and stored in out.
-   */
-  return Base::m_valid;
+  return popped == 1;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeLockFreeQueue<T>::waitPop (T& out){
+  return this->waitPopBulk(&out, 1, 1) == 1;
 }
 
 template <typename T>
@@ -158,7 +223,7 @@ bool arcana::virgil::ThreadSafeLockFreeQueue<T>::waitPop (void){
 
 template <typename T>
 void arcana::virgil::ThreadSafeLockFreeQueue<T>::push (T value){
-  queue.enqueue(value);
+  this->pushBulk(&value, &value + 1);
 
   return ;
 }
@@ -167,41 +232,173 @@ template <typename T>
 bool arcana::virgil::ThreadSafeLockFreeQueue<T>::waitPush (T value, int64_t maxSize){
 
   /*
-   * Wait until the queue has less elements than maxSize
+   * Wait until the queue has less elements than maxSize.
    */
-  while (queue.size_approx() > maxSize){
+  while (this->size() >= maxSize){
     if (!Base::m_valid){
       return false;
     }
+    auto key = this->notFull.prepareWait();
+    if (  (this->size() < maxSize)
+          || (!Base::m_valid)
+       ){
+      this->notFull.cancelWait();
+      continue ;
+    }
+    this->notFull.wait(key);
+  }
+  if (!Base::m_valid){
+    return false;
   }
 
   /*
    * Push
    */
-  push(value);
+  this->push(std::move(value));
 
   return true;
 }
 
 template <typename T>
-bool arcana::virgil::ThreadSafeLockFreeQueue<T>::empty (void) const {
-  auto empty = (queue.size_approx() == 0);
+bool arcana::virgil::ThreadSafeLockFreeQueue<T>::tryPush (T& value, int64_t maxSize){
+
+  /*
+   * Concurrent producers can all pass the check, so the bound is approximate.
+   */
+  if (  (!Base::m_valid)
+        || (this->size() >= maxSize)
+     ){
+    return false;
+  }
+
+  this->push(std::move(value));
+
+  return true;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeLockFreeQueue<T>::pushBulk (T *first, T *last){
+  auto n = static_cast<std::uint64_t>(last - first);
+  if (n == 0){
+    return ;
+  }
+
+  /*
+   * Use the cells unless older values wait in the overflow buffer, which would otherwise be overtaken.
+   */
+  std::uint64_t pushed = 0;
+  if (this->overflowSize.load(std::memory_order_acquire) == 0){
+    pushed = this->pushToCells(first, n);
+  }
+  if (pushed < n){
+    this->pushToOverflow(first + pushed, n - pushed);
+  }
+  this->notifyPushes(n);
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::tryPopBulk (T *out, std::uint64_t max){
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  auto popped = this->popAvailable(out, max);
+  this->notifyPops(popped);
+
+  return popped;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::waitPopBulk (T *out, std::uint64_t min, std::uint64_t max){
+  if (max == 0){
+    return 0;
+  }
+  min = std::min(std::max<std::uint64_t>(min, 1), max);
+
+  std::uint64_t popped = 0;
+  std::uint32_t spins = 0;
+  while (true){
+    if (!Base::m_valid){
+      return 0;
+    }
+
+    /*
+     * Take what is available.
+     */
+    auto p = this->popAvailable(out + popped, max - popped);
+    popped += p;
+    if (popped >= min){
+      break ;
+    }
+    if (p > 0){
+      spins = 0;
+      continue ;
+    }
+
+    /*
+     * Spin for a while before sleeping, as a value often arrives shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Sleep until a producer pushes new values.
+     * The queue is checked again after announcing the wait, so a value pushed in between is not missed.
+     */
+    auto key = this->notEmpty.prepareWait();
+    p = this->popAvailable(out + popped, max - popped);
+    popped += p;
+    if (  (popped >= min)
+          || (p > 0)
+          || (!Base::m_valid)
+       ){
+      this->notEmpty.cancelWait();
+      continue ;
+    }
+    this->notEmpty.wait(key);
+  }
+  this->notifyPops(popped);
 
-  return empty;
+  return popped;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeLockFreeQueue<T>::empty (void) const {
+  return this->size() == 0;
 }
 
 template <typename T>
 int64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::size (void) const {
-  auto s = queue.size_approx();
- 
-  return s;
+  auto head = this->dequeuePosition.load(std::memory_order_acquire);
+  auto tail = this->enqueuePosition.load(std::memory_order_acquire);
+  auto inCells = (tail > head) ? (tail - head) : 0;
+
+  return static_cast<int64_t>(inCells + this->overflowSize.load(std::memory_order_acquire));
 }
 
 template <typename T>
 void arcana::virgil::ThreadSafeLockFreeQueue<T>::clear (void) {
-  while(!empty()){
-    waitPop();
+  T out;
+  while (this->popAvailable(&out, 1) == 1){
   }
+  this->notFull.notifyAll();
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeLockFreeQueue<T>::invalidate (void) {
+  Base::m_valid = false;
+
+  /*
+   * Wake up everybody waiting.
+   */
+  this->notEmpty.notifyAll();
+  this->notFull.notifyAll();
 
   return ;
 }
@@ -210,5 +407,189 @@ template <typename T>
 arcana::virgil::ThreadSafeLockFreeQueue<T>::~ThreadSafeLockFreeQueue(void){
   this->invalidate();
 
+  /*
+   * Destroy the values left in the cells.
+   */
+  auto head = this->dequeuePosition.load(std::memory_order_acquire);
+  auto tail = this->enqueuePosition.load(std::memory_order_acquire);
+  for (auto p = head; p < tail; p++){
+    auto &cell = this->cells[p & this->mask];
+    if (cell.sequence.load(std::memory_order_acquire) == (p + 1)){
+      reinterpret_cast<T *>(cell.storage)->~T();
+    }
+  }
+  ::operator delete(this->cells, std::align_val_t{64});
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::pushToCells (T *first, std::uint64_t n){
+  std::uint64_t pushed = 0;
+  auto position = this->enqueuePosition.load(std::memory_order_relaxed);
+  while (pushed < n){
+
+    /*
+     * Count the consecutive cells, starting from position, that are free.
+     */
+    std::uint64_t free = 0;
+    while (  ((pushed + free) < n)
+             && (this->cells[(position + free) & this->mask].sequence.load(std::memory_order_acquire) == (position + free))
+          ){
+      free++;
+    }
+    if (free == 0){
+
+      /*
+       * Either the cells are full or another producer reserved position.
+       */
+      auto sequence = this->cells[position & this->mask].sequence.load(std::memory_order_acquire);
+      if (static_cast<std::int64_t>(sequence - position) < 0){
+        break ;
+      }
+      position = this->enqueuePosition.load(std::memory_order_relaxed);
+      continue ;
+    }
+
+    /*
+     * Reserve the free cells.
+     */
+    if (!this->enqueuePosition.compare_exchange_weak(position, position + free, std::memory_order_relaxed)){
+      continue ;
+    }
+
+    /*
+     * Store the values and hand the cells over to the consumers.
+     */
+    for (std::uint64_t i = 0; i < free; i++){
+      auto &cell = this->cells[(position + i) & this->mask];
+      new (cell.storage) T(std::move(first[pushed + i]));
+      cell.sequence.store(position + i + 1, std::memory_order_release);
+    }
+    pushed += free;
+    position += free;
+  }
+
+  return pushed;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::popFromCells (T *out, std::uint64_t max){
+  std::uint64_t popped = 0;
+  auto position = this->dequeuePosition.load(std::memory_order_relaxed);
+  while (popped < max){
+
+    /*
+     * Count the consecutive cells, starting from position, that hold a value.
+     */
+    std::uint64_t full = 0;
+    while (  ((popped + full) < max)
+             && (this->cells[(position + full) & this->mask].sequence.load(std::memory_order_acquire) == (position + full + 1))
+          ){
+      full++;
+    }
+    if (full == 0){
+
+      /*
+       * Either the cells are empty or another consumer reserved position.
+       */
+      auto sequence = this->cells[position & this->mask].sequence.load(std::memory_order_acquire);
+      if (static_cast<std::int64_t>(sequence - (position + 1)) < 0){
+        break ;
+      }
+      position = this->dequeuePosition.load(std::memory_order_relaxed);
+      continue ;
+    }
+
+    /*
+     * Reserve the cells.
+     */
+    if (!this->dequeuePosition.compare_exchange_weak(position, position + full, std::memory_order_relaxed)){
+      continue ;
+    }
+
+    /*
+     * Fetch the values and hand the cells back to the producers of the next round.
+     */
+    for (std::uint64_t i = 0; i < full; i++){
+      auto &cell = this->cells[(position + i) & this->mask];
+      auto value = reinterpret_cast<T *>(cell.storage);
+      out[popped + i] = std::move(*value);
+      value->~T();
+      cell.sequence.store(position + i + this->mask + 1, std::memory_order_release);
+    }
+    popped += full;
+    position += full;
+  }
+
+  return popped;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeLockFreeQueue<T>::pushToOverflow (T *first, std::uint64_t n){
+  std::lock_guard<std::mutex> lock{this->overflowMutex};
+  for (std::uint64_t i = 0; i < n; i++){
+    this->internal_push(first[i]);
+  }
+  this->overflowSize.fetch_add(n, std::memory_order_release);
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::popFromOverflow (T *out, std::uint64_t max){
+  if (this->overflowSize.load(std::memory_order_acquire) == 0){
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> lock{this->overflowMutex};
+
+  /*
+   * The cells might have been refilled since the caller found them empty, and then a producer might have spilled newer values to the overflow buffer.
+   * A producer spills only after storing its values in the cells, so the cells are drained first while holding the lock.
+   */
+  auto popped = this->popFromCells(out, max);
+  if (popped == max){
+    return popped;
+  }
+  auto fromOverflow = this->internal_popBulk(out + popped, max - popped);
+  this->overflowSize.fetch_sub(fromOverflow, std::memory_order_release);
+
+  return popped + fromOverflow;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeLockFreeQueue<T>::popAvailable (T *out, std::uint64_t max){
+
+  /*
+   * Values in the cells are older than the ones in the overflow buffer.
+   */
+  auto popped = this->popFromCells(out, max);
+  if (popped < max){
+    popped += this->popFromOverflow(out + popped, max - popped);
+  }
+
+  return popped;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeLockFreeQueue<T>::notifyPushes (std::uint64_t pushed){
+  if (pushed == 1){
+    this->notEmpty.notify();
+  } else if (pushed > 1){
+    this->notEmpty.notifyAll();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeLockFreeQueue<T>::notifyPops (std::uint64_t popped){
+  if (popped == 1){
+    this->notFull.notify();
+  } else if (popped > 1){
+    this->notFull.notifyAll();
+  }
+
   return ;
 }
@@ -14,9 +14,10 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include <queue>
 #include <utility>
 
 #include "ThreadSafeQueue.hpp"
@@ -34,6 +35,12 @@ namespace arcana::virgil {
        */
       ThreadSafeMutexQueue ();
 
+      /*
+       * Constructor.
+       * The queue holds @preallocatedElements elements before allocating more memory, and its storage is backed by huge pages if @hugePages is true.
+       */
+      explicit ThreadSafeMutexQueue (std::uint64_t preallocatedElements, bool hugePages = false);
+
       /*
        * Attempt to get the first value in the queue.
        * Returns true if a value was successfully written to the out parameter, false otherwise.
@@ -59,6 +66,29 @@ namespace arcana::virgil {
        */
       bool waitPush (T value, int64_t maxSize) override ;
 
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      bool tryPush (T& value, int64_t maxSize) override ;
+
+      /*
+       * Push the values in [first, last) onto the queue with a single synchronization.
+       */
+      void pushBulk (T *first, T *last) override ;
+
+      /*
+       * Pop up to max values without waiting.
+       * Returns the number of values popped.
+       */
+      std::uint64_t tryPopBulk (T *out, std::uint64_t max) override ;
+
+      /*
+       * Wait until at least min values are available, and then pop up to max of them.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       */
+      std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) override ;
+
       /*
        * Clear all items from the queue.
        */
@@ -108,13 +138,15 @@ namespace arcana::virgil {
       mutable std::mutex m_mutex;
       std::condition_variable empty_condition;
       std::condition_variable full_condition;
+      std::uint64_t waitingProducers = 0;
 
       /*
        * Methods.
        */
       void internal_pushAndNotify(T& value);
       void internal_popAndNotify(T& out);
-      void internal_waitWhileEmpty (std::unique_lock<std::mutex> &lock);
+      void internal_waitWhileFewerThan (std::unique_lock<std::mutex> &lock, std::uint64_t minimum);
+      void internal_notifyNotFull (std::uint64_t popped);
 
   };
 }
@@ -125,6 +157,14 @@ arcana::virgil::ThreadSafeMutexQueue<T>::ThreadSafeMutexQueue(){
   return ;
 }
 
+template <typename T>
+arcana::virgil::ThreadSafeMutexQueue<T>::ThreadSafeMutexQueue (std::uint64_t preallocatedElements, bool hugePages)
+  : Base{preallocatedElements, hugePages}
+  {
+
+  return ;
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeMutexQueue<T>::tryPop (T& out){
   std::lock_guard<std::mutex> lock{m_mutex};
@@ -158,7 +198,7 @@ bool arcana::virgil::ThreadSafeMutexQueue<T>::waitPop (T& out){
     /*
      * Wait until the queue will be in a valid state and it will be not empty.
      */
-    this->internal_waitWhileEmpty(lock);
+    this->internal_waitWhileFewerThan(lock, 1);
   }
 
   /*
@@ -195,7 +235,7 @@ bool arcana::virgil::ThreadSafeMutexQueue<T>::waitPop (void){
     /*
      * Wait until the queue will be in a valid state and it will be not empty.
      */
-    this->internal_waitWhileEmpty(lock);
+    this->internal_waitWhileFewerThan(lock, 1);
   }
 
   /*
@@ -214,7 +254,7 @@ bool arcana::virgil::ThreadSafeMutexQueue<T>::waitPop (void){
   /*
    * Notify about the fact that the queue might be not full now.
    */
-  this->full_condition.notify_one();
+  this->internal_notifyNotFull(1);
 
   return true;
 }
@@ -231,12 +271,22 @@ template <typename T>
 bool arcana::virgil::ThreadSafeMutexQueue<T>::waitPush (T value, int64_t maxSize){
   std::unique_lock<std::mutex> lock{m_mutex};
 
-  full_condition.wait(lock, 
-    [this, maxSize]()
-    {
-      return (Base::m_queue.size() < maxSize) || !Base::m_valid;
-    }
-  );
+  if (  (Base::m_queue.size() >= maxSize)
+        && Base::m_valid
+     ){
+
+    /*
+     * Let consumers know that somebody waits for room, so they notify only then.
+     */
+    this->waitingProducers++;
+    full_condition.wait(lock, 
+      [this, maxSize]()
+      {
+        return (Base::m_queue.size() < maxSize) || !Base::m_valid;
+      }
+    );
+    this->waitingProducers--;
+  }
 
   /*
    * Using the condition in the predicate ensures that spurious wakeups with a valid
@@ -251,6 +301,88 @@ bool arcana::virgil::ThreadSafeMutexQueue<T>::waitPush (T value, int64_t maxSize
   return true;
 }
 
+template <typename T>
+bool arcana::virgil::ThreadSafeMutexQueue<T>::tryPush (T& value, int64_t maxSize){
+  std::lock_guard<std::mutex> lock{m_mutex};
+  if (  (!Base::m_valid)
+        || (Base::m_queue.size() >= maxSize)
+     ){
+    return false;
+  }
+
+  internal_pushAndNotify(value);
+
+  return true;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeMutexQueue<T>::pushBulk (T *first, T *last){
+  if (first == last){
+    return ;
+  }
+  std::lock_guard<std::mutex> lock{m_mutex};
+
+  /*
+   * Push the values to the queue.
+   */
+  for (auto value = first; value != last; value++){
+    this->internal_push(*value);
+  }
+
+  /*
+   * Wake up as many consumers as the new values can keep busy.
+   */
+  if ((last - first) == 1){
+    empty_condition.notify_one();
+  } else {
+    empty_condition.notify_all();
+  }
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeMutexQueue<T>::tryPopBulk (T *out, std::uint64_t max){
+  std::lock_guard<std::mutex> lock{m_mutex};
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  auto popped = this->internal_popBulk(out, max);
+  this->internal_notifyNotFull(popped);
+
+  return popped;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeMutexQueue<T>::waitPopBulk (T *out, std::uint64_t min, std::uint64_t max){
+  if (max == 0){
+    return 0;
+  }
+  min = std::min(std::max<std::uint64_t>(min, 1), max);
+  std::unique_lock<std::mutex> lock{m_mutex};
+
+  /*
+   * Wait until the queue will be in a valid state and it will have enough values.
+   */
+  if (  Base::m_valid
+        && (Base::m_queue.size() < min)
+     ){
+    this->internal_waitWhileFewerThan(lock, min);
+  }
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  /*
+   * Drain the batch.
+   */
+  auto popped = this->internal_popBulk(out, max);
+  this->internal_notifyNotFull(popped);
+
+  return popped;
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeMutexQueue<T>::empty (void) const {
   std::lock_guard<std::mutex> lock{m_mutex};
@@ -276,7 +408,9 @@ void arcana::virgil::ThreadSafeMutexQueue<T>::clear (void) {
   /*
    * Notify
    */
-  full_condition.notify_all();
+  if (this->waitingProducers > 0){
+    full_condition.notify_all();
+  }
 
   return ;
 }
@@ -340,19 +474,38 @@ void arcana::virgil::ThreadSafeMutexQueue<T>::internal_popAndNotify (T& out){
   /*
    * Notify about the fact that the queue might be not full now.
    */
-  full_condition.notify_one();
+  this->internal_notifyNotFull(1);
 
   return ;
 }
       
 template <typename T>
-void arcana::virgil::ThreadSafeMutexQueue<T>::internal_waitWhileEmpty (std::unique_lock<std::mutex> &lock){
+void arcana::virgil::ThreadSafeMutexQueue<T>::internal_waitWhileFewerThan (std::unique_lock<std::mutex> &lock, std::uint64_t minimum){
   this->empty_condition.wait(lock, 
-    [this]()
+    [this, minimum]()
     {
-      return !Base::m_queue.empty() || !Base::m_valid;
+      return (Base::m_queue.size() >= minimum) || !Base::m_valid;
     }
     );
 
   return ;
 }
+
+template <typename T>
+void arcana::virgil::ThreadSafeMutexQueue<T>::internal_notifyNotFull (std::uint64_t popped){
+
+  /*
+   * Notify producers waiting in waitPush about the room made by popping values.
+   * Condition variables make a system call even when nobody waits, so skip them unless a producer does.
+   */
+  if (this->waitingProducers == 0){
+    return ;
+  }
+  if (popped == 1){
+    full_condition.notify_one();
+  } else if (popped > 1){
+    full_condition.notify_all();
+  }
+
+  return ;
+}
@@ -14,10 +14,10 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include <queue>
 #include <utility>
 #include <thread>  
 #include <chrono>
@@ -37,6 +37,12 @@ namespace arcana::virgil {
        */
       ThreadSafeMutexQueueSleep ();
 
+      /*
+       * Constructor.
+       * The queue holds @preallocatedElements elements before allocating more memory, and its storage is backed by huge pages if @hugePages is true.
+       */
+      explicit ThreadSafeMutexQueueSleep (std::uint64_t preallocatedElements, bool hugePages = false);
+
       /*
        * Attempt to get the first value in the queue.
        * Returns true if a value was successfully written to the out parameter, false otherwise.
@@ -62,6 +68,29 @@ namespace arcana::virgil {
        */
       bool waitPush (T value, int64_t maxSize) override ;
 
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      bool tryPush (T& value, int64_t maxSize) override ;
+
+      /*
+       * Push the values in [first, last) onto the queue with a single synchronization.
+       */
+      void pushBulk (T *first, T *last) override ;
+
+      /*
+       * Pop up to max values without waiting.
+       * Returns the number of values popped.
+       */
+      std::uint64_t tryPopBulk (T *out, std::uint64_t max) override ;
+
+      /*
+       * Wait until at least min values are available, and then pop up to max of them.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       */
+      std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) override ;
+
       /*
        * Clear all items from the queue.
        */
@@ -110,13 +139,15 @@ namespace arcana::virgil {
        */
       mutable std::mutex m_mutex;
       std::condition_variable full_condition;
+      std::uint64_t waitingProducers = 0;
 
       /*
        * Methods.
        */
       void internal_pushAndNotify(T& value);
       void internal_popAndNotify(T& out);
-      void internal_waitWhileEmpty (std::unique_lock<std::mutex> &lock);
+      void internal_waitWhileFewerThan (std::unique_lock<std::mutex> &lock, std::uint64_t minimum);
+      void internal_notifyNotFull (std::uint64_t popped);
 
   };
 }
@@ -127,6 +158,14 @@ arcana::virgil::ThreadSafeMutexQueueSleep<T>::ThreadSafeMutexQueueSleep(){
   return ;
 }
 
+template <typename T>
+arcana::virgil::ThreadSafeMutexQueueSleep<T>::ThreadSafeMutexQueueSleep (std::uint64_t preallocatedElements, bool hugePages)
+  : Base{preallocatedElements, hugePages}
+  {
+
+  return ;
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::tryPop (T& out){
   std::lock_guard<std::mutex> lock{m_mutex};
@@ -160,7 +199,7 @@ bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::waitPop (T& out){
     /*
      * Wait until the queue will be in a valid state and it will be not empty.
      */
-    this->internal_waitWhileEmpty(lock);
+    this->internal_waitWhileFewerThan(lock, 1);
   }
 
   /*
@@ -197,7 +236,7 @@ bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::waitPop (void){
     /*
      * Wait until the queue will be in a valid state and it will be not empty.
      */
-    this->internal_waitWhileEmpty(lock);
+    this->internal_waitWhileFewerThan(lock, 1);
   }
 
   /*
@@ -216,7 +255,7 @@ bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::waitPop (void){
   /*
    * Notify about the fact that the queue might be not full now.
    */
-  this->full_condition.notify_one();
+  this->internal_notifyNotFull(1);
 
   return true;
 }
@@ -233,12 +272,22 @@ template <typename T>
 bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::waitPush (T value, int64_t maxSize){
   std::unique_lock<std::mutex> lock{m_mutex};
 
-  full_condition.wait(lock, 
-    [this, maxSize]()
-    {
-      return (Base::m_queue.size() < maxSize) || !Base::m_valid;
-    }
-  );
+  if (  (Base::m_queue.size() >= maxSize)
+        && Base::m_valid
+     ){
+
+    /*
+     * Let consumers know that somebody waits for room, so they notify only then.
+     */
+    this->waitingProducers++;
+    full_condition.wait(lock, 
+      [this, maxSize]()
+      {
+        return (Base::m_queue.size() < maxSize) || !Base::m_valid;
+      }
+    );
+    this->waitingProducers--;
+  }
 
   /*
    * Using the condition in the predicate ensures that spurious wakeups with a valid
@@ -253,6 +302,79 @@ bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::waitPush (T value, int64_t ma
   return true;
 }
 
+template <typename T>
+bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::tryPush (T& value, int64_t maxSize){
+  std::lock_guard<std::mutex> lock{m_mutex};
+  if (  (!Base::m_valid)
+        || (Base::m_queue.size() >= maxSize)
+     ){
+    return false;
+  }
+
+  internal_pushAndNotify(value);
+
+  return true;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeMutexQueueSleep<T>::pushBulk (T *first, T *last){
+  if (first == last){
+    return ;
+  }
+  std::lock_guard<std::mutex> lock{m_mutex};
+
+  /*
+   * Push the values to the queue.
+   */
+  for (auto value = first; value != last; value++){
+    this->internal_push(*value);
+  }
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeMutexQueueSleep<T>::tryPopBulk (T *out, std::uint64_t max){
+  std::lock_guard<std::mutex> lock{m_mutex};
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  auto popped = this->internal_popBulk(out, max);
+  this->internal_notifyNotFull(popped);
+
+  return popped;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeMutexQueueSleep<T>::waitPopBulk (T *out, std::uint64_t min, std::uint64_t max){
+  if (max == 0){
+    return 0;
+  }
+  min = std::min(std::max<std::uint64_t>(min, 1), max);
+  std::unique_lock<std::mutex> lock{m_mutex};
+
+  /*
+   * Wait until the queue will be in a valid state and it will have enough values.
+   */
+  if (  Base::m_valid
+        && (Base::m_queue.size() < min)
+     ){
+    this->internal_waitWhileFewerThan(lock, min);
+  }
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  /*
+   * Drain the batch.
+   */
+  auto popped = this->internal_popBulk(out, max);
+  this->internal_notifyNotFull(popped);
+
+  return popped;
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeMutexQueueSleep<T>::empty (void) const {
   std::lock_guard<std::mutex> lock{m_mutex};
@@ -278,7 +400,9 @@ void arcana::virgil::ThreadSafeMutexQueueSleep<T>::clear (void) {
   /*
    * Notify
    */
-  full_condition.notify_all();
+  if (this->waitingProducers > 0){
+    full_condition.notify_all();
+  }
 
   return ;
 }
@@ -336,13 +460,13 @@ void arcana::virgil::ThreadSafeMutexQueueSleep<T>::internal_popAndNotify (T& out
   /*
    * Notify about the fact that the queue might be not full now.
    */
-  full_condition.notify_one();
+  this->internal_notifyNotFull(1);
 
   return ;
 }
       
 template <typename T>
-void arcana::virgil::ThreadSafeMutexQueueSleep<T>::internal_waitWhileEmpty (std::unique_lock<std::mutex> &lock){
+void arcana::virgil::ThreadSafeMutexQueueSleep<T>::internal_waitWhileFewerThan (std::unique_lock<std::mutex> &lock, std::uint64_t minimum){
   auto time = std::chrono::microseconds(1);
   auto iterations = 0;
   do {
@@ -358,7 +482,26 @@ void arcana::virgil::ThreadSafeMutexQueueSleep<T>::internal_waitWhileEmpty (std:
     }
     std::this_thread::sleep_for(time);
     lock.lock();
-  } while (Base::m_queue.empty() && Base::m_valid);
+  } while ((Base::m_queue.size() < minimum) && Base::m_valid);
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeMutexQueueSleep<T>::internal_notifyNotFull (std::uint64_t popped){
+
+  /*
+   * Notify producers waiting in waitPush about the room made by popping values.
+   * Condition variables make a system call even when nobody waits, so skip them unless a producer does.
+   */
+  if (this->waitingProducers == 0){
+    return ;
+  }
+  if (popped == 1){
+    full_condition.notify_one();
+  } else if (popped > 1){
+    full_condition.notify_all();
+  }
 
   return ;
 }
@@ -16,10 +16,12 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
-#include <queue>
 #include <utility>
 
+#include "RingBuffer.hpp"
+
 namespace arcana::virgil {
 
   template <typename T>
@@ -51,6 +53,33 @@ namespace arcana::virgil {
        */
       virtual bool waitPush (T value, int64_t maxSize) = 0;
 
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      virtual bool tryPush (T& value, int64_t maxSize) = 0;
+
+      /*
+       * Push the values in [first, last) onto the queue, in order, with a single synchronization.
+       * The values are moved out of the range.
+       */
+      virtual void pushBulk (T *first, T *last) = 0;
+
+      /*
+       * Pop up to max values from the queue and store them in out[0], out[1], ... without waiting.
+       * Returns the number of values popped.
+       */
+      virtual std::uint64_t tryPopBulk (T *out, std::uint64_t max) = 0;
+
+      /*
+       * Wait until the queue has at least min values, and then pop up to max of them and store them in out[0], out[1], ...
+       * The caller is woken up once for the whole batch.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       *
+       * When min is greater than 1, the caller should be the only consumer of the queue: a notification of a single new value could otherwise be absorbed by a caller that needs more.
+       */
+      virtual std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) = 0;
+
       /*
        * Clear all items from the queue.
        */
@@ -85,6 +114,12 @@ namespace arcana::virgil {
        */
       ThreadSafeQueue (void) = default;
 
+      /*
+       * Constructor.
+       * The storage of the queue holds @preallocatedElements elements before growing for the first time, and it is backed by huge pages if @hugePages is true.
+       */
+      ThreadSafeQueue (std::uint64_t preallocatedElements, bool hugePages);
+
       /*
        * Not copyable.
        */
@@ -102,7 +137,7 @@ namespace arcana::virgil {
       /*
        * Fields
        */
-      std::queue<T> m_queue;
+      RingBuffer<T> m_queue;
       std::atomic_bool m_valid{true};
 
       /*
@@ -110,9 +145,18 @@ namespace arcana::virgil {
        */
       void internal_push (T& value);
       void internal_pop (T& out);
+      std::uint64_t internal_popBulk (T *out, std::uint64_t max);
   };
 }
 
+template <typename T>
+arcana::virgil::ThreadSafeQueue<T>::ThreadSafeQueue (std::uint64_t preallocatedElements, bool hugePages)
+  : m_queue{preallocatedElements, hugePages}
+  {
+
+  return ;
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeQueue<T>::isValid (void) const {
   return m_valid;
@@ -155,3 +199,21 @@ void arcana::virgil::ThreadSafeQueue<T>::internal_pop (T& out){
 
   return ;
 }
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeQueue<T>::internal_popBulk (T *out, std::uint64_t max){
+
+  /*
+   * Pop as many elements as available, up to max.
+   */
+  std::uint64_t popped = 0;
+  while (  (popped < max)
+           && (!this->m_queue.empty())
+        ){
+    out[popped] = std::move(this->m_queue.front());
+    this->m_queue.pop();
+    popped++;
+  }
+
+  return popped;
+}
@@ -0,0 +1,407 @@
+/*
+ * Copyright 2017 - 2019  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The ThreadSafeSPSCLockFreeQueue class.
+ * Provides a wrapper around a basic queue to provide thread safety.
+ *
+ * The queue supports a single producer and a single consumer at a time, which makes it the fastest queue for channels that are one-to-one.
+ * Use ThreadSafeLockFreeQueue when there are several producers or consumers.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <utility>
+#include <pthread.h>
+
+#include <ThreadSafeQueue.hpp>
+#include "EventCount.hpp"
+#include <readerwriterqueue/readerwriterqueue.h>
+
+using namespace moodycamel ;
+
+namespace arcana::virgil {
+
+  template <typename T>
+  class ThreadSafeSPSCLockFreeQueue final : public ThreadSafeQueue<T> {
+    using Base = arcana::virgil::ThreadSafeQueue<T>;
+
+    public:
+
+      /*
+       * Default constructor
+       */
+      ThreadSafeSPSCLockFreeQueue ();
+
+      /*
+       * Attempt to get the first value in the queue.
+       * Returns true if a value was successfully written to the out parameter, false otherwise.
+       */
+      bool tryPop (T& out) override ;
+
+      /*
+       * Get the first value in the queue.
+       * Will block until a value is available unless clear is called or the instance is destructed.
+       * Returns true if a value was successfully written to the out parameter, false otherwise.
+       */
+      bool waitPop (T& out) override ;
+      bool waitPop (void) override ;
+
+      /*
+       * Push a new value onto the queue.
+       */
+      void push (T value) override ;
+
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize.
+       * Otherwise, wait for it to happen and then push the new value.
+       */
+      bool waitPush (T value, int64_t maxSize) override ;
+
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      bool tryPush (T& value, int64_t maxSize) override ;
+
+      /*
+       * Push the values in [first, last) onto the queue with a single synchronization.
+       */
+      void pushBulk (T *first, T *last) override ;
+
+      /*
+       * Pop up to max values without waiting.
+       * Returns the number of values popped.
+       */
+      std::uint64_t tryPopBulk (T *out, std::uint64_t max) override ;
+
+      /*
+       * Wait until at least min values are available, and then pop up to max of them.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       */
+      std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) override ;
+
+      /*
+       * Clear all items from the queue.
+       */
+      void clear (void) override ;
+
+      /*
+       * Invalidate the queue and wake up the producer and the consumer waiting on it.
+       */
+      void invalidate (void) override ;
+
+      /*
+       * Check whether or not the queue is empty.
+       */
+      bool empty (void) const override ;
+
+      /*
+       * Return the number of elements in the queue.
+       */
+      int64_t size (void) const override ;
+
+      /*
+       * Destructor.
+       */
+      ~ThreadSafeSPSCLockFreeQueue(void);
+
+      /*
+       * Not copyable.
+       */
+      ThreadSafeSPSCLockFreeQueue (const ThreadSafeSPSCLockFreeQueue & other) = delete;
+      ThreadSafeSPSCLockFreeQueue & operator= (const ThreadSafeSPSCLockFreeQueue & other) = delete;
+
+      /*
+       * Not assignable.
+       */
+      ThreadSafeSPSCLockFreeQueue (const ThreadSafeSPSCLockFreeQueue && other) = delete;
+      ThreadSafeSPSCLockFreeQueue & operator= (const ThreadSafeSPSCLockFreeQueue && other) = delete;
+
+    private:
+
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+
+      /*
+       * Wait until the queue holds at least @min values or it is invalidated.
+       * The consumer spins for a while and then sleeps, so an idle consumer does not burn its core.
+       */
+      void internal_waitForValues (std::uint64_t min);
+
+      /*
+       * Notify the producer waiting in waitPush about the room made by popping values.
+       */
+      void internal_notifyNotFull (std::uint64_t popped);
+
+      mutable ReaderWriterQueue<T> queue;
+
+      /*
+       * The producer blocked in waitPush sleeps here rather than spinning on the size of the queue.
+       */
+      EventCount notFull;
+
+      /*
+       * The consumer sleeps here once it spun for a while on an empty queue.
+       */
+      EventCount notEmpty;
+  };
+}
+
+template <typename T>
+arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::ThreadSafeSPSCLockFreeQueue(){
+
+  return ;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::tryPop (T& out){
+
+  /*
+   * Check if the queue is not valid anymore.
+   */
+  if (!Base::m_valid){
+    return false;
+  }
+
+  /*
+   * Try to pop.
+   */
+  auto success = queue.try_dequeue(out);
+  this->internal_notifyNotFull(success ? 1 : 0);
+
+  return success;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::waitPop (T& out){
+
+  /*
+   * Check if the queue is not valid anymore.
+   */
+  if(!Base::m_valid) {
+    return false;
+  }
+
+  /*
+   * Wait until the queue will be in a valid state and it will be not empty.
+   * The single consumer is the only one that pops, so the value it has seen is still there.
+   */
+  this->internal_waitForValues(1);
+  if (!Base::m_valid){
+    return false;
+  }
+  queue.try_dequeue(out);
+  this->internal_notifyNotFull(1);
+
+  return true;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::waitPop (void){
+  T out;
+  return waitPop(out);
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::push (T value){
+  queue.enqueue(std::move(value));
+  this->notEmpty.notify();
+
+  return ;
+}
+ 
+template <typename T>
+bool arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::waitPush (T value, int64_t maxSize){
+
+  /*
+   * Wait until the queue has less elements than maxSize.
+   * Only the consumer shrinks the queue, so the single producer never exceeds the bound.
+   */
+  while (  Base::m_valid
+           && (static_cast<int64_t>(queue.size_approx()) >= maxSize)
+        ){
+
+    /*
+     * Sleep until the consumer pops a value.
+     * The queue is checked again after announcing the wait, so a value popped in between is not missed.
+     */
+    auto key = this->notFull.prepareWait();
+    if (  Base::m_valid
+          && (static_cast<int64_t>(queue.size_approx()) >= maxSize)
+       ){
+      this->notFull.wait(key);
+    } else {
+      this->notFull.cancelWait();
+    }
+  }
+  if (!Base::m_valid){
+    return false;
+  }
+
+  /*
+   * Push
+   */
+  push(std::move(value));
+
+  return true;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::tryPush (T& value, int64_t maxSize){
+
+  /*
+   * Only the consumer shrinks the queue, so the single producer never exceeds the bound.
+   */
+  if (  (!Base::m_valid)
+        || (static_cast<int64_t>(queue.size_approx()) >= maxSize)
+     ){
+    return false;
+  }
+
+  queue.enqueue(std::move(value));
+  this->notEmpty.notify();
+
+  return true;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::pushBulk (T *first, T *last){
+
+  /*
+   * The single-producer queue does not need a lock, so values are enqueued one at a time.
+   */
+  for (auto value = first; value != last; value++){
+    queue.enqueue(std::move(*value));
+  }
+  this->notEmpty.notify();
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::tryPopBulk (T *out, std::uint64_t max){
+  if (!Base::m_valid){
+    return 0;
+  }
+
+  std::uint64_t popped = 0;
+  while (  (popped < max)
+           && queue.try_dequeue(out[popped])
+        ){
+    popped++;
+  }
+  this->internal_notifyNotFull(popped);
+
+  return popped;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::waitPopBulk (T *out, std::uint64_t min, std::uint64_t max){
+  if (max == 0){
+    return 0;
+  }
+  min = std::min(std::max<std::uint64_t>(min, 1), max);
+
+  /*
+   * Wait for the first min values, and then drain what is available.
+   */
+  this->internal_waitForValues(min);
+  auto popped = this->tryPopBulk(out, max);
+
+  return popped;
+}
+
+template <typename T>
+bool arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::empty (void) const {
+  auto empty = (queue.size_approx() == 0);
+
+  return empty;
+}
+
+template <typename T>
+int64_t arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::size (void) const {
+  auto s = queue.size_approx();
+ 
+  return s;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::clear (void) {
+  while(!empty()){
+    waitPop();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::invalidate (void) {
+  Base::m_valid = false;
+
+  /*
+   * Wake up the producer waiting in waitPush and the consumer waiting for values.
+   */
+  this->notFull.notifyAll();
+  this->notEmpty.notifyAll();
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::internal_notifyNotFull (std::uint64_t popped){
+
+  /*
+   * The notification costs a single load unless the producer waits.
+   */
+  if (popped > 0){
+    this->notFull.notify();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::internal_waitForValues (std::uint64_t min){
+  std::uint32_t spins = 0;
+  while (Base::m_valid && (queue.size_approx() < min)){
+
+    /*
+     * Spin for a while before sleeping, as a value often arrives shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Sleep until the producer pushes a value.
+     * The queue is checked again after announcing the wait, so a value pushed in between is not missed.
+     */
+    auto key = this->notEmpty.prepareWait();
+    if (Base::m_valid && (queue.size_approx() < min)){
+      this->notEmpty.wait(key);
+    } else {
+      this->notEmpty.cancelWait();
+    }
+  }
+
+  return ;
+}
+
+template <typename T>
+arcana::virgil::ThreadSafeSPSCLockFreeQueue<T>::~ThreadSafeSPSCLockFreeQueue(void){
+  this->invalidate();
+
+  return ;
+}
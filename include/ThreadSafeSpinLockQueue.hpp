@@ -14,10 +14,10 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include <queue>
 #include <utility>
 #include <pthread.h>
 #include <thread>
@@ -25,6 +25,7 @@
 
 
 #include <ThreadSafeQueue.hpp>
+#include "EventCount.hpp"
 
 namespace arcana::virgil {
 
@@ -39,6 +40,12 @@ namespace arcana::virgil {
        */
       ThreadSafeSpinLockQueue ();
 
+      /*
+       * Constructor.
+       * The queue holds @preallocatedElements elements before allocating more memory, and its storage is backed by huge pages if @hugePages is true.
+       */
+      explicit ThreadSafeSpinLockQueue (std::uint64_t preallocatedElements, bool hugePages = false);
+
       /*
        * Attempt to get the first value in the queue.
        * Returns true if a value was successfully written to the out parameter, false otherwise.
@@ -64,11 +71,39 @@ namespace arcana::virgil {
        */
       bool waitPush (T value, int64_t maxSize) override ;
 
+      /*
+       * Push a new value onto the queue if the queue size is less than maxSize, without waiting.
+       * Returns true if the value has been moved onto the queue, false otherwise (@value is then left untouched).
+       */
+      bool tryPush (T& value, int64_t maxSize) override ;
+
+      /*
+       * Push the values in [first, last) onto the queue with a single synchronization.
+       */
+      void pushBulk (T *first, T *last) override ;
+
+      /*
+       * Pop up to max values without waiting.
+       * Returns the number of values popped.
+       */
+      std::uint64_t tryPopBulk (T *out, std::uint64_t max) override ;
+
+      /*
+       * Wait until at least min values are available, and then pop up to max of them.
+       * Returns the number of values popped, which is 0 if the queue has been invalidated.
+       */
+      std::uint64_t waitPopBulk (T *out, std::uint64_t min, std::uint64_t max) override ;
+
       /*
        * Clear all items from the queue.
        */
       void clear (void) override ;
 
+      /*
+       * Invalidate the queue and wake up all producers waiting on it.
+       */
+      void invalidate (void) override ;
+
       /*
        * Check whether or not the queue is empty.
        */
@@ -97,7 +132,38 @@ namespace arcana::virgil {
       ThreadSafeSpinLockQueue & operator= (const ThreadSafeSpinLockQueue && other) = delete;
 
     private:
+
+      static constexpr std::uint32_t spinsBeforeSleeping = 64;
+
+      /*
+       * Notify producers waiting in waitPush about the room made by popping values.
+       */
+      void internal_notifyNotFull (std::uint64_t popped);
+
+      /*
+       * Notify consumers about the values pushed.
+       */
+      void internal_notifyNotEmpty (std::uint64_t pushed);
+
+      /*
+       * Wait until the queue holds at least @min values or it is invalidated.
+       * The consumer spins for a while and then sleeps, so idle consumers do not burn their cores.
+       */
+      void internal_waitForValues (std::uint64_t min);
+
       mutable pthread_spinlock_t spinLock;
+
+      /*
+       * Producers blocked in waitPush sleep here rather than spinning on the lock, which would delay the consumers that make room.
+       */
+      EventCount notFull;
+
+      /*
+       * Consumers sleep here once they spun for a while on an empty queue.
+       * bulkWaiters counts the consumers waiting for more than one value, which a single notification might not satisfy.
+       */
+      EventCount notEmpty;
+      std::atomic<std::uint32_t> bulkWaiters{0};
   };
 }
 
@@ -108,6 +174,15 @@ arcana::virgil::ThreadSafeSpinLockQueue<T>::ThreadSafeSpinLockQueue(){
   return ;
 }
 
+template <typename T>
+arcana::virgil::ThreadSafeSpinLockQueue<T>::ThreadSafeSpinLockQueue (std::uint64_t preallocatedElements, bool hugePages)
+  : Base{preallocatedElements, hugePages}
+  {
+  pthread_spin_init(&this->spinLock, 0);
+
+  return ;
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeSpinLockQueue<T>::tryPop (T& out){
   pthread_spin_lock(&this->spinLock);
@@ -119,6 +194,7 @@ bool arcana::virgil::ThreadSafeSpinLockQueue<T>::tryPop (T& out){
   this->internal_pop(out);
 
   pthread_spin_unlock(&this->spinLock);
+  this->notFull.notify();
   return true;
 }
 
@@ -132,26 +208,31 @@ bool arcana::virgil::ThreadSafeSpinLockQueue<T>::waitPop (T& out){
     return false;
   }
 
-  /*
-   * Wait until the queue will be in a valid state and it will be not empty.
-   */
-  while (Base::m_valid && Base::m_queue.empty()){
-  }
+  while (true){
 
-  pthread_spin_lock(&this->spinLock);
-  /*
-   * Using the condition in the predicate ensures that spurious wakeups with a valid
-   * but empty queue will not proceed, so only need to check for validity before proceeding.
-   */
-  if(!Base::m_valid) {
+    /*
+     * Wait until the queue will be in a valid state and it will be not empty.
+     */
+    this->internal_waitForValues(1);
+
+    pthread_spin_lock(&this->spinLock);
+    if(!Base::m_valid) {
+      pthread_spin_unlock(&this->spinLock);
+      return false;
+    }
+
+    /*
+     * Another consumer might have popped the element we have seen.
+     * In this case, wait again.
+     */
+    if (!Base::m_queue.empty()){
+      this->internal_pop(out);
+      pthread_spin_unlock(&this->spinLock);
+      this->notFull.notify();
+      return true;
+    }
     pthread_spin_unlock(&this->spinLock);
-    return false;
   }
-
-  this->internal_pop(out);
-
-  pthread_spin_unlock(&this->spinLock);
-  return true;
 }
 
 template <typename T>
@@ -164,29 +245,30 @@ bool arcana::virgil::ThreadSafeSpinLockQueue<T>::waitPop (void){
     return false;
   }
 
-  /*
-   * Wait until the queue will be in a valid state and it will be not empty.
-   */
-  while (Base::m_valid && Base::m_queue.empty()){
-  }
+  while (true){
 
-  pthread_spin_lock(&this->spinLock);
-  /*
-   * Using the condition in the predicate ensures that spurious wakeups with a valid
-   * but empty queue will not proceed, so only need to check for validity before proceeding.
-   */
-  if(!Base::m_valid) {
+    /*
+     * Wait until the queue will be in a valid state and it will be not empty.
+     */
+    this->internal_waitForValues(1);
+
+    pthread_spin_lock(&this->spinLock);
+    if(!Base::m_valid) {
+      pthread_spin_unlock(&this->spinLock);
+      return false;
+    }
+
+    /*
+     * Pop the top element from the queue unless another consumer did it first.
+     */
+    if (!Base::m_queue.empty()){
+      this->Base::m_queue.pop();
+      pthread_spin_unlock(&this->spinLock);
+      this->notFull.notify();
+      return true;
+    }
     pthread_spin_unlock(&this->spinLock);
-    return false;
   }
-
-  /*
-   * Pop the top element from the queue.
-   */
-  this->Base::m_queue.pop();
-
-  pthread_spin_unlock(&this->spinLock);
-  return true;
 }
 
 template <typename T>
@@ -194,22 +276,39 @@ void arcana::virgil::ThreadSafeSpinLockQueue<T>::push (T value){
   pthread_spin_lock(&this->spinLock);
   this->internal_push(value);
   pthread_spin_unlock(&this->spinLock);
+  this->internal_notifyNotEmpty(1);
 
   return ;
 }
  
 template <typename T>
 bool arcana::virgil::ThreadSafeSpinLockQueue<T>::waitPush (T value, int64_t maxSize){
-  pthread_spin_lock(&this->spinLock);
-
-  while (Base::m_queue.size() >= maxSize && Base::m_valid){
+  while (true){
+    pthread_spin_lock(&this->spinLock);
+    if (  (Base::m_queue.size() < maxSize)
+          || (!Base::m_valid)
+       ){
+      break ;
+    }
     pthread_spin_unlock(&this->spinLock);
+
+    /*
+     * Sleep until a consumer pops a value.
+     * The queue is checked again after announcing the wait, so a value popped in between is not missed.
+     */
+    auto key = this->notFull.prepareWait();
     pthread_spin_lock(&this->spinLock);
+    auto mustWait = (Base::m_queue.size() >= maxSize) && Base::m_valid;
+    pthread_spin_unlock(&this->spinLock);
+    if (!mustWait){
+      this->notFull.cancelWait();
+      continue ;
+    }
+    this->notFull.wait(key);
   }
 
   /*
-   * Using the condition in the predicate ensures that spurious wakeups with a valid
-   * but empty queue will not proceed, so only need to check for validity before proceeding.
+   * The spinlock is held.
    */
   if(!Base::m_valid) {
     pthread_spin_unlock(&this->spinLock);
@@ -219,9 +318,87 @@ bool arcana::virgil::ThreadSafeSpinLockQueue<T>::waitPush (T value, int64_t maxS
   this->internal_push(value);
 
   pthread_spin_unlock(&this->spinLock);
+  this->internal_notifyNotEmpty(1);
   return true;
 }
 
+template <typename T>
+bool arcana::virgil::ThreadSafeSpinLockQueue<T>::tryPush (T& value, int64_t maxSize){
+  pthread_spin_lock(&this->spinLock);
+  if (  (!Base::m_valid)
+        || (Base::m_queue.size() >= maxSize)
+     ){
+    pthread_spin_unlock(&this->spinLock);
+    return false;
+  }
+
+  this->internal_push(value);
+
+  pthread_spin_unlock(&this->spinLock);
+  this->internal_notifyNotEmpty(1);
+  return true;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSpinLockQueue<T>::pushBulk (T *first, T *last){
+  pthread_spin_lock(&this->spinLock);
+  for (auto value = first; value != last; value++){
+    this->internal_push(*value);
+  }
+  pthread_spin_unlock(&this->spinLock);
+  this->internal_notifyNotEmpty(last - first);
+
+  return ;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeSpinLockQueue<T>::tryPopBulk (T *out, std::uint64_t max){
+  pthread_spin_lock(&this->spinLock);
+  if (!Base::m_valid){
+    pthread_spin_unlock(&this->spinLock);
+    return 0;
+  }
+
+  auto popped = this->internal_popBulk(out, max);
+
+  pthread_spin_unlock(&this->spinLock);
+  this->internal_notifyNotFull(popped);
+  return popped;
+}
+
+template <typename T>
+std::uint64_t arcana::virgil::ThreadSafeSpinLockQueue<T>::waitPopBulk (T *out, std::uint64_t min, std::uint64_t max){
+  if (max == 0){
+    return 0;
+  }
+  min = std::min(std::max<std::uint64_t>(min, 1), max);
+
+  while (true){
+
+    /*
+     * Wait until the queue will be in a valid state and it will have enough values.
+     */
+    this->internal_waitForValues(min);
+
+    pthread_spin_lock(&this->spinLock);
+    if(!Base::m_valid) {
+      pthread_spin_unlock(&this->spinLock);
+      return 0;
+    }
+
+    /*
+     * Drain the batch unless another consumer took the values we have seen.
+     */
+    if (Base::m_queue.size() >= min){
+      auto popped = this->internal_popBulk(out, max);
+      pthread_spin_unlock(&this->spinLock);
+      this->internal_notifyNotFull(popped);
+      return popped;
+    }
+    pthread_spin_unlock(&this->spinLock);
+  }
+}
+
 template <typename T>
 bool arcana::virgil::ThreadSafeSpinLockQueue<T>::empty (void) const {
   pthread_spin_lock(&this->spinLock);
@@ -248,6 +425,22 @@ void arcana::virgil::ThreadSafeSpinLockQueue<T>::clear (void) {
   }
 
   pthread_spin_unlock(&this->spinLock);
+  this->notFull.notifyAll();
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSpinLockQueue<T>::invalidate (void) {
+  pthread_spin_lock(&this->spinLock);
+  Base::m_valid = false;
+  pthread_spin_unlock(&this->spinLock);
+
+  /*
+   * Wake up the producers waiting in waitPush and the consumers waiting for values.
+   */
+  this->notFull.notifyAll();
+  this->notEmpty.notifyAll();
+
   return ;
 }
 
@@ -257,3 +450,68 @@ arcana::virgil::ThreadSafeSpinLockQueue<T>::~ThreadSafeSpinLockQueue(void){
 
   return ;
 }
+
+template <typename T>
+void arcana::virgil::ThreadSafeSpinLockQueue<T>::internal_notifyNotFull (std::uint64_t popped){
+
+  /*
+   * The notification costs a single load unless a producer waits.
+   */
+  if (popped == 1){
+    this->notFull.notify();
+  } else if (popped > 1){
+    this->notFull.notifyAll();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSpinLockQueue<T>::internal_notifyNotEmpty (std::uint64_t pushed){
+  if (  (pushed > 1)
+        || (this->bulkWaiters.load(std::memory_order_relaxed) > 0)
+     ){
+    this->notEmpty.notifyAll();
+  } else if (pushed == 1){
+    this->notEmpty.notify();
+  }
+
+  return ;
+}
+
+template <typename T>
+void arcana::virgil::ThreadSafeSpinLockQueue<T>::internal_waitForValues (std::uint64_t min){
+  std::uint32_t spins = 0;
+  while (Base::m_valid && (Base::m_queue.size() < min)){
+
+    /*
+     * Spin for a while before sleeping, as a value often arrives shortly.
+     */
+    if (spins < spinsBeforeSleeping){
+      spins++;
+      continue ;
+    }
+
+    /*
+     * Sleep until a producer pushes a value.
+     * The queue is checked again after announcing the wait, so a value pushed in between is not missed.
+     */
+    if (min > 1){
+      this->bulkWaiters.fetch_add(1, std::memory_order_seq_cst);
+    }
+    auto key = this->notEmpty.prepareWait();
+    pthread_spin_lock(&this->spinLock);
+    auto mustWait = Base::m_valid && (Base::m_queue.size() < min);
+    pthread_spin_unlock(&this->spinLock);
+    if (mustWait){
+      this->notEmpty.wait(key);
+    } else {
+      this->notEmpty.cancelWait();
+    }
+    if (min > 1){
+      this->bulkWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  return ;
+}
@@ -16,8 +16,15 @@
 #include <sched.h>
 #include <pthread.h>
 #include <iostream>
+#include <memory>
+
+#include "ThreadPoolStatistics.hpp"
+#include "ThreadPoolTracer.hpp"
+#include "PerformanceCounters.hpp"
+#include "BuildConfiguration.hpp"
 
 namespace arcana::virgil {
+inline namespace VIRGIL_BUILD_NAMESPACE {
 
   /*
    * Thread task interface.
@@ -35,6 +42,24 @@ namespace arcana::virgil {
        */
       virtual void execute() = 0;
 
+      /*
+       * Remember the time the task has been submitted to a pool and trace the submission.
+       * This is a no-op unless VIRGIL_STATISTICS, VIRGIL_LATENCY_HISTOGRAMS, or VIRGIL_TRACING are defined.
+       */
+      void markSubmission (void);
+
+      /*
+       * Return the time in nanoseconds the task has been submitted to a pool (0 if unknown).
+       */
+      std::uint64_t getSubmissionTime (void) const ;
+
+      /*
+       * Set and return what identifies the kind of the task when hardware performance counters are attributed to tasks.
+       * The key is kept only if VIRGIL_PERFORMANCE_COUNTERS is defined.
+       */
+      void setProfilingKey (const TaskProfilingKey &key);
+      TaskProfilingKey getProfilingKey (void) const ;
+
       /*
        * Default moving operation.
        */
@@ -51,10 +76,19 @@ namespace arcana::virgil {
        * Default deconstructor.
        */
       virtual ~IThreadTask(void) = default;
+
+    private:
+#if defined(VIRGIL_STATISTICS) || defined(VIRGIL_LATENCY_HISTOGRAMS)
+      std::uint64_t submissionTime = 0;
+#endif
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+      TaskProfilingKey profilingKey;
+#endif
   };
 
   /*
    * An implementation of the thread task interface.
+   * Most tasks can run anywhere, so the cores a task is pinned to are kept out of line.
    */
   template <typename Func>
   class ThreadTask: public IThreadTask {
@@ -90,16 +124,48 @@ namespace arcana::virgil {
 
     private:
       Func m_func;
-      cpu_set_t cores;
-      bool useAffinity;
+      std::unique_ptr<cpu_set_t> cores;
   };
 }
+}
+
+inline void arcana::virgil::IThreadTask::markSubmission (void){
+#if defined(VIRGIL_STATISTICS) || defined(VIRGIL_LATENCY_HISTOGRAMS)
+  this->submissionTime = TimestampCounter::nanoseconds();
+#endif
+  Tracer::record(TRACE_SUBMIT, this);
+
+  return ;
+}
+
+inline std::uint64_t arcana::virgil::IThreadTask::getSubmissionTime (void) const {
+#if defined(VIRGIL_STATISTICS) || defined(VIRGIL_LATENCY_HISTOGRAMS)
+  return this->submissionTime;
+#else
+  return 0;
+#endif
+}
+
+inline void arcana::virgil::IThreadTask::setProfilingKey (const TaskProfilingKey &key){
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  this->profilingKey = key;
+#endif
+
+  return ;
+}
+
+inline arcana::virgil::TaskProfilingKey arcana::virgil::IThreadTask::getProfilingKey (void) const {
+#ifdef VIRGIL_PERFORMANCE_COUNTERS
+  return this->profilingKey;
+#else
+  return TaskProfilingKey{};
+#endif
+}
 
 template <typename Func>
 arcana::virgil::ThreadTask<Func>::ThreadTask (Func&& func)
   :
-  m_func{std::move(func)},
-  useAffinity{false}
+  m_func{std::move(func)}
   {
   return ;
 }
@@ -108,8 +174,7 @@ template <typename Func>
 arcana::virgil::ThreadTask<Func>::ThreadTask (cpu_set_t coresToUse, Func&& func)
   :
   m_func{std::move(func)},
-  cores{coresToUse},
-  useAffinity{true}
+  cores{std::make_unique<cpu_set_t>(coresToUse)}
   {
   return ;
 }
@@ -120,13 +185,13 @@ void arcana::virgil::ThreadTask<Func>::execute (void){
   /*
    * Check if we have been asked to set the affinity of the thread that will run the task.
    */
-  if (useAffinity){
+  if (this->cores != nullptr){
 
     /*
      * Set the thread affinity.
      */
     auto self = pthread_self();
-    auto exitCode = pthread_setaffinity_np(self, sizeof(cpu_set_t), &(this->cores));
+    auto exitCode = pthread_setaffinity_np(self, sizeof(cpu_set_t), this->cores.get());
     if (exitCode != 0) {
       std::cerr << "ThreadPool: Error calling pthread_setaffinity_np: " << exitCode << std::endl;
       abort();
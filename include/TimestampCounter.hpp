@@ -0,0 +1,98 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The TimestampCounter class.
+ * Cheap timestamps based on the time stamp counter of the processor.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace arcana::virgil {
+
+  class TimestampCounter {
+    public:
+
+      /*
+       * Return the current value of the time stamp counter.
+       * On processors without one, return the time in nanoseconds of a monotonic clock.
+       */
+      static std::uint64_t read (void);
+
+      /*
+       * Return the number of ticks of the counter per second.
+       * The first invocation calibrates the counter against a monotonic clock, which takes a few milliseconds.
+       */
+      static double ticksPerSecond (void);
+
+      /*
+       * Convert a number of ticks to nanoseconds.
+       */
+      static std::uint64_t toNanoseconds (std::uint64_t ticks);
+
+      /*
+       * Return the current value of the counter converted to nanoseconds.
+       */
+      static std::uint64_t nanoseconds (void);
+
+    private:
+      static double calibrate (void);
+  };
+
+}
+
+inline std::uint64_t arcana::virgil::TimestampCounter::read (void){
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+#endif
+}
+
+inline double arcana::virgil::TimestampCounter::ticksPerSecond (void){
+  static const double ticks = TimestampCounter::calibrate();
+
+  return ticks;
+}
+
+inline std::uint64_t arcana::virgil::TimestampCounter::toNanoseconds (std::uint64_t ticks){
+  return static_cast<std::uint64_t>(static_cast<double>(ticks) * 1e9 / TimestampCounter::ticksPerSecond());
+}
+
+inline std::uint64_t arcana::virgil::TimestampCounter::nanoseconds (void){
+  return TimestampCounter::toNanoseconds(TimestampCounter::read());
+}
+
+inline double arcana::virgil::TimestampCounter::calibrate (void){
+#if defined(__x86_64__) || defined(__i386__)
+
+  /*
+   * Measure how many ticks elapse during a known amount of time.
+   */
+  auto startTime = std::chrono::steady_clock::now();
+  auto startTicks = TimestampCounter::read();
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  auto endTicks = TimestampCounter::read();
+  auto endTime = std::chrono::steady_clock::now();
+
+  auto seconds = std::chrono::duration<double>(endTime - startTime).count();
+  return static_cast<double>(endTicks - startTicks) / seconds;
+#else
+  return 1e9;
+#endif
+}
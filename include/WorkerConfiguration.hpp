@@ -0,0 +1,97 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The WorkerConfiguration struct.
+ * Describes how a thread pool creates its workers.
+ */
+#pragma once
+
+#include <sched.h>
+#include <cstddef>
+#include <string>
+
+namespace arcana::virgil {
+
+  /*
+   * How a thread pool starts its workers when it is constructed.
+   */
+  enum class StartMode {
+
+    /*
+     * The constructor creates every worker.
+     */
+    Eager,
+
+    /*
+     * The constructor creates a single worker; the others are created by submissions that find no idle worker, up to the number of workers of the pool.
+     */
+    Lazy,
+
+    /*
+     * The constructor creates a single worker, and every new worker creates up to two more, so the workers are created in about log2(workers) steps.
+     * The constructor returns before all workers exist.
+     */
+    Parallel
+  };
+
+  struct WorkerConfiguration {
+
+    /*
+     * How workers are started.
+     */
+    StartMode startMode = StartMode::Eager;
+
+    /*
+     * Size of the stack of every worker in bytes, rounded up to pages and to PTHREAD_STACK_MIN.
+     * 0 keeps the default of the system (usually 8 MiB of virtual memory per worker).
+     */
+    std::size_t stackSize = 0;
+
+    /*
+     * Size of the guard area at the end of every stack in bytes.
+     * 0 keeps the default of the system (one page).
+     */
+    std::size_t guardSize = 0;
+
+    /*
+     * Scheduling policy (e.g., SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO, or SCHED_RR) and static priority of the workers.
+     * Real-time policies need CAP_SYS_NICE or an RLIMIT_RTPRIO that allows @schedulingPriority; otherwise the constructor of the thread pool throws std::system_error.
+     */
+    int schedulingPolicy = SCHED_OTHER;
+    int schedulingPriority = 0;
+
+    /*
+     * Value added to the nice value of the workers, which start with the one of the thread that creates them.
+     * Only SCHED_OTHER and SCHED_BATCH use it. Negative values need CAP_SYS_NICE; workers that cannot change it keep the inherited one.
+     */
+    int niceIncrement = 0;
+
+    /*
+     * Workers are named "<namePrefix>-<number>" to make them recognizable in debuggers, profilers, and traces.
+     * Linux truncates names to 15 characters.
+     */
+    std::string namePrefix = "virgil";
+
+    /*
+     * Lock the stacks of the workers in memory with mlock, so they never page fault.
+     * The whole stack gets locked, so this is meant to be combined with a small @stackSize; workers whose stack exceeds RLIMIT_MEMLOCK run with an unlocked stack.
+     */
+    bool lockStacks = false;
+
+    /*
+     * Check whether or not the policy is a real-time one.
+     */
+    bool isRealTime (void) const {
+      return (schedulingPolicy == SCHED_FIFO) || (schedulingPolicy == SCHED_RR);
+    }
+  };
+
+}
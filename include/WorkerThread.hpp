@@ -0,0 +1,237 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The WorkerThread class.
+ * A thread created with the attributes of a WorkerConfiguration (stack, scheduling class, name) rather than the defaults of std::thread.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <system_error>
+
+#include "WorkerConfiguration.hpp"
+
+namespace arcana::virgil {
+
+  class WorkerThread {
+    public:
+
+      /*
+       * Constructor of a thread that does not exist (like a default-constructed std::thread).
+       */
+      WorkerThread (void) = default;
+
+      /*
+       * Create a thread named @name that runs @body with the attributes of @configuration.
+       * It throws std::system_error if the thread cannot be created, e.g., because the process cannot use the real-time policy of @configuration.
+       */
+      WorkerThread (const WorkerConfiguration &configuration, const std::string &name, std::function<void (void)> body);
+
+      /*
+       * Movable, not copyable.
+       */
+      WorkerThread (WorkerThread && other) noexcept ;
+      WorkerThread & operator= (WorkerThread && other) noexcept ;
+      WorkerThread (const WorkerThread & other) = delete;
+      WorkerThread & operator= (const WorkerThread & other) = delete;
+
+      /*
+       * Check whether or not the thread exists and has not been joined yet.
+       */
+      bool joinable (void) const ;
+
+      /*
+       * Wait for the thread to end.
+       */
+      void join (void);
+
+      pthread_t native_handle (void) const ;
+
+      /*
+       * Destructor.
+       * Like for std::thread, destroying a joinable thread terminates the program.
+       */
+      ~WorkerThread (void);
+
+    private:
+
+      /*
+       * What the new thread needs to set itself up.
+       */
+      struct Start {
+        std::string name;
+        int schedulingPolicy;
+        int schedulingPriority;
+        int niceIncrement;
+        bool lockStack;
+        std::function<void (void)> body;
+      };
+
+      pthread_t handle{};
+      bool started = false;
+
+      static void * internal_entry (void *start);
+  };
+
+}
+
+arcana::virgil::WorkerThread::WorkerThread (const WorkerConfiguration &configuration, const std::string &name, std::function<void (void)> body){
+
+  /*
+   * Set the attributes of the thread.
+   */
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  if (configuration.stackSize > 0){
+    auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto stackSize = std::max<std::size_t>(configuration.stackSize, PTHREAD_STACK_MIN);
+    stackSize = (stackSize + pageSize - 1) & ~(pageSize - 1);
+    pthread_attr_setstacksize(&attributes, stackSize);
+  }
+  if (configuration.guardSize > 0){
+    pthread_attr_setguardsize(&attributes, configuration.guardSize);
+  }
+  if (configuration.isRealTime()){
+    sched_param parameters{};
+    parameters.sched_priority = configuration.schedulingPriority;
+    pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attributes, configuration.schedulingPolicy);
+    pthread_attr_setschedparam(&attributes, &parameters);
+  }
+
+  /*
+   * Create the thread.
+   * pthread attributes accept only the POSIX policies, so the new thread switches to the other ones (e.g., SCHED_BATCH) by itself.
+   */
+  auto policy = configuration.isRealTime() ? SCHED_OTHER : configuration.schedulingPolicy;
+  auto start = new Start{name, policy, configuration.schedulingPriority, configuration.niceIncrement, configuration.lockStacks, std::move(body)};
+  auto error = pthread_create(&this->handle, &attributes, &WorkerThread::internal_entry, start);
+  pthread_attr_destroy(&attributes);
+  if (error != 0){
+    delete start;
+    throw std::system_error(error, std::generic_category(), "pthread_create");
+  }
+  this->started = true;
+
+  return ;
+}
+
+arcana::virgil::WorkerThread::WorkerThread (WorkerThread && other) noexcept
+  :
+  handle{other.handle},
+  started{other.started}
+  {
+  other.started = false;
+
+  return ;
+}
+
+arcana::virgil::WorkerThread & arcana::virgil::WorkerThread::operator= (WorkerThread && other) noexcept {
+  if (this->started){
+    std::terminate();
+  }
+  this->handle = other.handle;
+  this->started = other.started;
+  other.started = false;
+
+  return *this;
+}
+
+bool arcana::virgil::WorkerThread::joinable (void) const {
+  return this->started;
+}
+
+void arcana::virgil::WorkerThread::join (void){
+  auto error = pthread_join(this->handle, nullptr);
+  if (error != 0){
+    throw std::system_error(error, std::generic_category(), "pthread_join");
+  }
+  this->started = false;
+
+  return ;
+}
+
+pthread_t arcana::virgil::WorkerThread::native_handle (void) const {
+  return this->handle;
+}
+
+arcana::virgil::WorkerThread::~WorkerThread (void){
+  if (this->started){
+    std::terminate();
+  }
+
+  return ;
+}
+
+void * arcana::virgil::WorkerThread::internal_entry (void *argument){
+  auto start = static_cast<Start *>(argument);
+
+  /*
+   * Name the thread.
+   */
+  auto name = start->name.substr(0, 15);
+  pthread_setname_np(pthread_self(), name.c_str());
+
+  /*
+   * Switch to a policy that pthread attributes do not support.
+   */
+  if (start->schedulingPolicy != SCHED_OTHER){
+    sched_param parameters{};
+    parameters.sched_priority = start->schedulingPriority;
+    pthread_setschedparam(pthread_self(), start->schedulingPolicy, &parameters);
+  }
+
+  /*
+   * Change the nice value of the thread; on Linux, it is a property of each thread.
+   */
+  if (start->niceIncrement != 0){
+    auto thread = static_cast<id_t>(syscall(SYS_gettid));
+    errno = 0;
+    auto niceValue = getpriority(PRIO_PROCESS, thread);
+    if (errno == 0){
+      setpriority(PRIO_PROCESS, thread, niceValue + start->niceIncrement);
+    }
+  }
+
+  /*
+   * Lock the stack in memory.
+   */
+  if (start->lockStack){
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) == 0){
+      void *stack = nullptr;
+      std::size_t stackSize = 0;
+      pthread_attr_getstack(&attributes, &stack, &stackSize);
+      pthread_attr_destroy(&attributes);
+      mlock(stack, stackSize);
+    }
+  }
+
+  /*
+   * Run the thread.
+   */
+  auto body = std::move(start->body);
+  delete start;
+  body();
+
+  return nullptr;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The C interface of VIRGIL.
+ * Lets C code (e.g., code generated by compilers) create thread pools and submit tasks to them without including C++ headers.
+ *
+ * The functions are defined by ThreadPoolForCABI.hpp, which must be included by exactly one C++ translation unit of the program.
+ * This header can be included by both C and C++ code.
+ */
+#ifndef VIRGIL_POOL_H
+#define VIRGIL_POOL_H
+
+#include <stdint.h>
+
+#include "virgil_task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A thread pool.
+ */
+typedef struct virgil_pool virgil_pool_t;
+
+/*
+ * Create a thread pool with @threads workers, or with the default number of workers if @threads is 0.
+ * Returns NULL if the pool cannot be created.
+ */
+virgil_pool_t * virgil_pool_create (uint32_t threads);
+
+/*
+ * Return the number of workers of @pool.
+ */
+uint32_t virgil_pool_threads (const virgil_pool_t *pool);
+
+/*
+ * Destroy @pool.
+ * Tasks that did not start yet are dropped, so the caller must wait for the tasks it needs first.
+ */
+void virgil_pool_destroy (virgil_pool_t *pool);
+
+/*
+ * Submit f(args) to @pool.
+ * The memory args points to must stay valid until the task completes.
+ */
+void virgil_submit (virgil_pool_t *pool, void (*f) (void *args), void *args);
+
+/*
+ * Submit f on a copy of the @size bytes at @argbytes to @pool.
+ * The arguments are copied in a descriptor of the pool, so the caller can reuse their memory right away.
+ * Returns 0 on success, or -1 if the arguments are larger than VIRGIL_TASK_INLINE_ARGUMENT_BYTES.
+ */
+int virgil_submit_inline (virgil_pool_t *pool, void (*f) (void *args), const void *argbytes, uint64_t size);
+
+/*
+ * Submit the task described by @task, which is owned by the caller (see virgil_task.h).
+ */
+void virgil_submit_task (virgil_pool_t *pool, virgil_task_t *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
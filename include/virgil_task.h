@@ -0,0 +1,113 @@
+/*
+ * Copyright 2021  Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * The virgil_task_t descriptor.
+ * Describes a task submitted to the C thread pools from memory owned by the caller (e.g., a stack or static array), so submitting it does not allocate.
+ *
+ * The caller initializes a descriptor with virgil_task_init or virgil_task_init_inline, submits it, and then must not touch it until virgil_task_done returns true.
+ * A descriptor can be submitted again once it is done.
+ * This header can be included by both C and C++ code.
+ */
+#ifndef VIRGIL_TASK_H
+#define VIRGIL_TASK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Number of bytes of arguments a descriptor can hold.
+ */
+#define VIRGIL_TASK_INLINE_ARGUMENT_BYTES 48
+
+/*
+ * States of a descriptor.
+ */
+#define VIRGIL_TASK_IDLE 0
+#define VIRGIL_TASK_PENDING 1
+#define VIRGIL_TASK_DONE 2
+
+/*
+ * Flags of a descriptor.
+ */
+#define VIRGIL_TASK_FLAG_INLINE_ARGUMENTS 1u
+
+typedef struct virgil_task {
+
+  /*
+   * The fields a worker reads to dequeue and run a task come first, and descriptors are aligned to 32 bytes, so they always share a cache line.
+   * The link is reserved to the pool.
+   */
+  void *link;
+  void (*function) (void *args);
+  void *args;
+  uint32_t state;
+  uint32_t flags;
+
+  /*
+   * The task runs function(args), or function(inline_args) if flags has VIRGIL_TASK_FLAG_INLINE_ARGUMENTS.
+   * Either way, args is passed unchanged, so a NULL args reaches the function as NULL.
+   * Arguments of up to 32 bytes share the cache line of the fields above when the descriptor is aligned to 64 bytes.
+   */
+  unsigned char inline_args[VIRGIL_TASK_INLINE_ARGUMENT_BYTES] __attribute__((aligned(16)));
+
+  /*
+   * Reserved to the pool, and only used when it keeps statistics.
+   */
+  uint64_t submission_time;
+} __attribute__((aligned(32))) virgil_task_t;
+
+/*
+ * Set up @task to run f(args).
+ */
+static inline void virgil_task_init (virgil_task_t *task, void (*f) (void *args), void *args){
+  task->link = NULL;
+  task->function = f;
+  task->args = args;
+  task->state = VIRGIL_TASK_IDLE;
+  task->flags = 0;
+  task->submission_time = 0;
+
+  return ;
+}
+
+/*
+ * Set up @task to run f on a copy of the @size bytes at @argbytes stored in the descriptor.
+ * Returns 0 on success, or -1 if the arguments do not fit in the descriptor.
+ */
+static inline int virgil_task_init_inline (virgil_task_t *task, void (*f) (void *args), const void *argbytes, uint64_t size){
+  if (size > VIRGIL_TASK_INLINE_ARGUMENT_BYTES){
+    return -1;
+  }
+  virgil_task_init(task, f, NULL);
+  task->flags = VIRGIL_TASK_FLAG_INLINE_ARGUMENTS;
+  if (size > 0){
+    memcpy(task->inline_args, argbytes, size);
+  }
+
+  return 0;
+}
+
+/*
+ * Check whether or not the last submission of @task completed.
+ */
+static inline int virgil_task_done (const virgil_task_t *task){
+  return __atomic_load_n(&task->state, __ATOMIC_ACQUIRE) != VIRGIL_TASK_PENDING;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
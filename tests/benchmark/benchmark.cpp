@@ -0,0 +1,474 @@
+/*
+ * Benchmark of all thread pools.
+ *
+ * Every thread pool runs the same workloads for every combination of
+ *   - number of workers,
+ *   - task granularity (iterations of a floating point loop run by each task),
+ *   - submit pattern:
+ *       single: the main thread submits every task,
+ *       many:   several producer threads submit tasks concurrently,
+ *       nested: the main thread submits root tasks, each of which submits further tasks from within the pool,
+ *   - wait strategy of the main thread while tasks complete:
+ *       spin:  busy wait,
+ *       yield: busy wait yielding the processor,
+ *       block: sleep on a condition variable notified by the last task.
+ *
+ * Each combination reports throughput, submit latency, CPU time consumed per task, and CPU consumed by the pool while it has no work (idle burn).
+ * Results are printed as CSV or JSON.
+ */
+#include <sched.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThreadPools.hpp"
+#include "LatencyHistogram.hpp"
+#include "TimestampCounter.hpp"
+
+using namespace arcana::virgil;
+
+enum SubmitPattern { SUBMIT_SINGLE, SUBMIT_MANY, SUBMIT_NESTED };
+enum WaitStrategy { WAIT_SPIN, WAIT_YIELD, WAIT_BLOCK };
+
+static const char *patternNames[] = {"single", "many", "nested"};
+static const char *waitNames[] = {"spin", "yield", "block"};
+static const char *poolNames[] = {"ThreadPool", "ThreadPoolForCSingleQueue", "ThreadPoolForCMultiQueues", "FastThreadPoolForC"};
+
+struct Options {
+  std::vector<std::string> pools{poolNames, poolNames + 4};
+  std::vector<std::uint32_t> threads;
+  std::vector<std::uint64_t> work{0, 100, 10000};
+  std::vector<SubmitPattern> patterns{SUBMIT_SINGLE, SUBMIT_MANY, SUBMIT_NESTED};
+  std::vector<WaitStrategy> waits{WAIT_SPIN, WAIT_YIELD, WAIT_BLOCK};
+  std::uint64_t tasks = 100000;
+  std::uint32_t producers = 4;
+  std::uint32_t fanout = 8;
+  std::uint32_t repetitions = 3;
+  std::uint32_t idleMilliseconds = 100;
+  std::string format = "csv";
+  std::string output;
+};
+
+struct Result {
+  std::string pool;
+  std::uint32_t threads;
+  SubmitPattern pattern;
+  WaitStrategy wait;
+  std::uint64_t work;
+  double workNanoseconds;
+  std::uint64_t tasks;
+  double seconds;
+  double throughput;
+  LatencyHistogram submitLatency;
+  double cpuNanosecondsPerTask;
+  double idleCores;
+};
+
+/*
+ * State shared by the tasks of a single run.
+ */
+struct Run {
+  std::atomic<std::uint64_t> completed{0};
+  std::uint64_t total = 0;
+  std::uint64_t work = 0;
+  WaitStrategy wait = WAIT_SPIN;
+  std::mutex doneMutex;
+  std::condition_variable doneCondition;
+  bool done = false;
+  LatencyHistogram *submitLatency = nullptr;
+  void *pool = nullptr;
+  std::uint32_t fanout = 1;
+};
+
+static std::atomic<std::uint64_t> sink{0};
+
+static void doWork (std::uint64_t iterations){
+  double v = 1.0;
+  for (std::uint64_t i = 0; i < iterations; i++){
+    v = v * 1.0000001 + 0.0000001;
+  }
+  if (v == 0){
+    sink.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return ;
+}
+
+static void complete (Run *run){
+  auto c = run->completed.fetch_add(1, std::memory_order_acq_rel) + 1;
+  if (  (c == run->total)
+        && (run->wait == WAIT_BLOCK)
+     ){
+    std::lock_guard<std::mutex> lock{run->doneMutex};
+    run->done = true;
+    run->doneCondition.notify_one();
+  }
+
+  return ;
+}
+
+static void leafTask (void *args){
+  auto run = static_cast<Run *>(args);
+  doWork(run->work);
+  complete(run);
+
+  return ;
+}
+
+template <typename Pool>
+static void submit (Pool &pool, void (*f) (void *), Run *run){
+  auto start = TimestampCounter::read();
+  pool.submitAndDetach(f, static_cast<void *>(run));
+  run->submitLatency->recordSince(start);
+
+  return ;
+}
+
+template <typename Pool>
+static void nestedRootTask (void *args){
+  auto run = static_cast<Run *>(args);
+  auto &pool = *static_cast<Pool *>(run->pool);
+  for (auto i = 1u; i < run->fanout; i++){
+    submit(pool, leafTask, run);
+  }
+  doWork(run->work);
+  complete(run);
+
+  return ;
+}
+
+static void waitForCompletion (Run &run){
+  switch (run.wait){
+    case WAIT_SPIN:
+      while (run.completed.load(std::memory_order_acquire) < run.total){
+      }
+      break ;
+
+    case WAIT_YIELD:
+      while (run.completed.load(std::memory_order_acquire) < run.total){
+        sched_yield();
+      }
+      break ;
+
+    case WAIT_BLOCK: {
+      std::unique_lock<std::mutex> lock{run.doneMutex};
+      run.doneCondition.wait(lock, [&run](void){ return run.done; });
+      break ;
+    }
+  }
+
+  return ;
+}
+
+/*
+ * Return the CPU time consumed by the process in nanoseconds.
+ */
+static double cpuNanoseconds (void){
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  auto toNanoseconds = [](const struct timeval &t) -> double { return t.tv_sec * 1e9 + t.tv_usec * 1e3; };
+
+  return toNanoseconds(usage.ru_utime) + toNanoseconds(usage.ru_stime);
+}
+
+/*
+ * Run the workload once and return its duration in seconds.
+ */
+template <typename Pool>
+static double runOnce (Pool &pool, const Options &o, SubmitPattern pattern, WaitStrategy wait, std::uint64_t work, std::uint64_t tasks, LatencyHistogram &submitLatency){
+  Run run;
+  run.total = tasks;
+  run.work = work;
+  run.wait = wait;
+  run.submitLatency = &submitLatency;
+  run.pool = &pool;
+  run.fanout = o.fanout;
+
+  auto start = std::chrono::steady_clock::now();
+  switch (pattern){
+    case SUBMIT_SINGLE:
+      for (std::uint64_t i = 0; i < tasks; i++){
+        submit(pool, leafTask, &run);
+      }
+      break ;
+
+    case SUBMIT_MANY: {
+      std::vector<std::thread> producers;
+      for (auto p = 0u; p < o.producers; p++){
+        auto share = (tasks / o.producers) + ((p < (tasks % o.producers)) ? 1 : 0);
+        producers.emplace_back([&pool, &run, share](void){
+          for (std::uint64_t i = 0; i < share; i++){
+            submit(pool, leafTask, &run);
+          }
+        });
+      }
+      for (auto &t : producers){
+        t.join();
+      }
+      break ;
+    }
+
+    case SUBMIT_NESTED:
+      for (std::uint64_t i = 0; i < tasks / o.fanout; i++){
+        submit(pool, nestedRootTask<Pool>, &run);
+      }
+      break ;
+  }
+  waitForCompletion(run);
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double>(end - start).count();
+}
+
+/*
+ * Return the time in nanoseconds a task with @work iterations takes when run serially.
+ */
+static double measureWork (std::uint64_t work){
+  const std::uint32_t samples = 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (auto i = 0u; i < samples; i++){
+    doWork(work);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+template <typename Pool>
+static void benchmarkPool (const std::string &name, const Options &o, std::vector<Result> &results){
+  for (auto threads : o.threads){
+    Pool pool{false, threads};
+    for (auto pattern : o.patterns){
+      for (auto wait : o.waits){
+        for (auto work : o.work){
+
+          /*
+           * Nested submissions run the tasks in groups of fanout.
+           */
+          auto tasks = o.tasks;
+          if (pattern == SUBMIT_NESTED){
+            tasks = std::max<std::uint64_t>(tasks / o.fanout, 1) * o.fanout;
+          }
+
+          /*
+           * Warm the pool up.
+           */
+          LatencyHistogram warmup;
+          runOnce(pool, o, pattern, wait, work, std::min<std::uint64_t>(tasks, 1000 * o.fanout), warmup);
+
+          /*
+           * Measure.
+           */
+          Result r;
+          r.pool = name;
+          r.threads = threads;
+          r.pattern = pattern;
+          r.wait = wait;
+          r.work = work;
+          r.workNanoseconds = measureWork(work);
+          r.tasks = tasks;
+          std::vector<double> durations;
+          auto cpuStart = cpuNanoseconds();
+          for (auto i = 0u; i < o.repetitions; i++){
+            durations.push_back(runOnce(pool, o, pattern, wait, work, tasks, r.submitLatency));
+          }
+          auto cpuEnd = cpuNanoseconds();
+          std::sort(durations.begin(), durations.end());
+          r.seconds = durations[durations.size() / 2];
+          r.throughput = tasks / r.seconds;
+          r.cpuNanosecondsPerTask = (cpuEnd - cpuStart) / (static_cast<double>(tasks) * o.repetitions);
+
+          /*
+           * Measure the CPU consumed by the pool while it has nothing to do.
+           */
+          auto idleStart = cpuNanoseconds();
+          std::this_thread::sleep_for(std::chrono::milliseconds(o.idleMilliseconds));
+          auto idleEnd = cpuNanoseconds();
+          r.idleCores = (idleEnd - idleStart) / (o.idleMilliseconds * 1e6);
+
+          results.push_back(r);
+          std::cerr << name << " threads=" << threads << " pattern=" << patternNames[pattern] << " wait=" << waitNames[wait] << " work=" << work << ": " << r.throughput << " tasks/s" << std::endl;
+        }
+      }
+    }
+  }
+
+  return ;
+}
+
+static void printCSV (std::ostream &out, const std::vector<Result> &results){
+  out << "pool,threads,pattern,wait,work,work_ns,tasks,seconds,throughput,submit_mean_ns,submit_p50_ns,submit_p99_ns,submit_max_ns,cpu_ns_per_task,idle_cores" << std::endl;
+  for (auto &r : results){
+    out << r.pool << "," << r.threads << "," << patternNames[r.pattern] << "," << waitNames[r.wait] << "," << r.work << "," << r.workNanoseconds << "," << r.tasks << "," << r.seconds << "," << r.throughput << ","
+        << r.submitLatency.mean() << "," << r.submitLatency.percentile(50) << "," << r.submitLatency.percentile(99) << "," << r.submitLatency.max() << ","
+        << r.cpuNanosecondsPerTask << "," << r.idleCores << std::endl;
+  }
+
+  return ;
+}
+
+static void printJSON (std::ostream &out, const std::vector<Result> &results){
+  out << "[" << std::endl;
+  for (auto i = 0u; i < results.size(); i++){
+    auto &r = results[i];
+    out << "  {\"pool\": \"" << r.pool << "\", \"threads\": " << r.threads << ", \"pattern\": \"" << patternNames[r.pattern] << "\", \"wait\": \"" << waitNames[r.wait] << "\", "
+        << "\"work\": " << r.work << ", \"work_ns\": " << r.workNanoseconds << ", \"tasks\": " << r.tasks << ", \"seconds\": " << r.seconds << ", \"throughput\": " << r.throughput << ", "
+        << "\"submit_mean_ns\": " << r.submitLatency.mean() << ", \"submit_p50_ns\": " << r.submitLatency.percentile(50) << ", \"submit_p99_ns\": " << r.submitLatency.percentile(99) << ", \"submit_max_ns\": " << r.submitLatency.max() << ", "
+        << "\"cpu_ns_per_task\": " << r.cpuNanosecondsPerTask << ", \"idle_cores\": " << r.idleCores << "}"
+        << ((i + 1 < results.size()) ? "," : "") << std::endl;
+  }
+  out << "]" << std::endl;
+
+  return ;
+}
+
+static std::vector<std::string> split (const std::string &s){
+  std::vector<std::string> elements;
+  std::stringstream stream{s};
+  std::string e;
+  while (std::getline(stream, e, ',')){
+    elements.push_back(e);
+  }
+
+  return elements;
+}
+
+template <typename T>
+static bool parseNames (const std::string &value, const char **names, std::uint32_t numberOfNames, std::vector<T> &result){
+  result.clear();
+  for (auto &e : split(value)){
+    auto n = std::find_if(names, names + numberOfNames, [&e](const char *name){ return e == name; });
+    if (n == names + numberOfNames){
+      std::cerr << "ERROR: unknown value \"" << e << "\"" << std::endl;
+      return false;
+    }
+    result.push_back(static_cast<T>(n - names));
+  }
+
+  return true;
+}
+
+static void printUsage (const char *program){
+  std::cerr << "USAGE: " << program << " [OPTION=VALUE]..." << std::endl
+            << "  --pools=NAME,...        thread pools to run (default: all)" << std::endl
+            << "  --threads=N,...         number of workers (default: powers of two up to the number of cores)" << std::endl
+            << "  --work=N,...            iterations run by each task (default: 0,100,10000)" << std::endl
+            << "  --patterns=NAME,...     single, many, nested (default: all)" << std::endl
+            << "  --waits=NAME,...        spin, yield, block (default: all)" << std::endl
+            << "  --tasks=N               tasks per run (default: 100000)" << std::endl
+            << "  --producers=N           producers of the many pattern (default: 4)" << std::endl
+            << "  --fanout=N              tasks per root task of the nested pattern (default: 8)" << std::endl
+            << "  --repetitions=N         runs per combination; the median is reported (default: 3)" << std::endl
+            << "  --idle=MS               time the idle CPU burn is measured for (default: 100)" << std::endl
+            << "  --format=csv|json       output format (default: csv)" << std::endl
+            << "  --output=FILE           output file (default: standard output)" << std::endl;
+
+  return ;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  Options o;
+  for (auto c = std::max(std::thread::hardware_concurrency(), 1u), t = 1u; t <= c; t *= 2){
+    o.threads.push_back(t);
+  }
+  for (auto i = 1; i < argc; i++){
+    std::string arg{argv[i]};
+    auto equal = arg.find('=');
+    if (  (arg.compare(0, 2, "--") != 0)
+          || (equal == std::string::npos)
+       ){
+      printUsage(argv[0]);
+      return 1;
+    }
+    auto option = arg.substr(2, equal - 2);
+    auto value = arg.substr(equal + 1);
+    auto ok = true;
+    if (option == "pools"){
+      o.pools = split(value);
+      for (auto &p : o.pools){
+        ok &= (std::find(poolNames, poolNames + 4, p) != poolNames + 4);
+      }
+    } else if (option == "threads"){
+      o.threads.clear();
+      for (auto &e : split(value)){
+        o.threads.push_back(std::max(std::stoul(e), 1ul));
+      }
+    } else if (option == "work"){
+      o.work.clear();
+      for (auto &e : split(value)){
+        o.work.push_back(std::stoull(e));
+      }
+    } else if (option == "patterns"){
+      ok = parseNames(value, patternNames, 3, o.patterns);
+    } else if (option == "waits"){
+      ok = parseNames(value, waitNames, 3, o.waits);
+    } else if (option == "tasks"){
+      o.tasks = std::max(std::stoull(value), 1ull);
+    } else if (option == "producers"){
+      o.producers = std::max(std::stoul(value), 1ul);
+    } else if (option == "fanout"){
+      o.fanout = std::max(std::stoul(value), 1ul);
+    } else if (option == "repetitions"){
+      o.repetitions = std::max(std::stoul(value), 1ul);
+    } else if (option == "idle"){
+      o.idleMilliseconds = std::max(std::stoul(value), 1ul);
+    } else if (option == "format"){
+      o.format = value;
+      ok = (value == "csv") || (value == "json");
+    } else if (option == "output"){
+      o.output = value;
+    } else {
+      ok = false;
+    }
+    if (!ok){
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  /*
+   * Run the benchmarks.
+   */
+  TimestampCounter::ticksPerSecond();
+  std::vector<Result> results;
+  for (auto &p : o.pools){
+    if (p == "ThreadPool"){
+      benchmarkPool<ThreadPool>(p, o, results);
+    } else if (p == "ThreadPoolForCSingleQueue"){
+      benchmarkPool<ThreadPoolForCSingleQueue>(p, o, results);
+    } else if (p == "FastThreadPoolForC"){
+      benchmarkPool<FastThreadPoolForC>(p, o, results);
+    } else {
+      benchmarkPool<ThreadPoolForCMultiQueues>(p, o, results);
+    }
+  }
+
+  /*
+   * Print the results.
+   */
+  std::ofstream file;
+  if (!o.output.empty()){
+    file.open(o.output);
+  }
+  auto &out = o.output.empty() ? std::cout : file;
+  if (o.format == "csv"){
+    printCSV(out, results);
+  } else {
+    printJSON(out, results);
+  }
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <sched.h>
+
+#include "virgil_pool.h"
+
+/*
+ * Task of the generated code: store the square of a value where its arguments say, and count the tasks done.
+ */
+struct square_arguments {
+  int64_t value;
+  int64_t *result;
+  int64_t *done;
+};
+
+static void square (void *args){
+  struct square_arguments *s = (struct square_arguments *) args;
+  *(s->result) = s->value * s->value;
+  __atomic_add_fetch(s->done, 1, __ATOMIC_RELEASE);
+
+  return ;
+}
+
+/*
+ * Task submitted without arguments: count the tasks that did not receive NULL.
+ */
+static int64_t nonNullArguments = 0;
+static int64_t nullTasksDone = 0;
+
+static void checkNullArguments (void *args){
+  if (args != NULL){
+    __atomic_add_fetch(&nonNullArguments, 1, __ATOMIC_RELAXED);
+  }
+  __atomic_add_fetch(&nullTasksDone, 1, __ATOMIC_RELEASE);
+
+  return ;
+}
+
+static void waitTasks (int64_t *done, int64_t tasks){
+  while (__atomic_load_n(done, __ATOMIC_ACQUIRE) < tasks){
+    sched_yield();
+  }
+
+  return ;
+}
+
+/*
+ * Compute the squares of 0 to tasksNumber-1 into results through the C interface.
+ * Returns 0 on success.
+ */
+int squaresThroughTheCInterface (uint32_t threads, int64_t *results, int64_t tasksNumber){
+  virgil_pool_t *pool = virgil_pool_create(threads);
+  if (pool == NULL){
+    return -1;
+  }
+  if (virgil_pool_threads(pool) != threads){
+    virgil_pool_destroy(pool);
+    return -2;
+  }
+
+  /*
+   * Arguments copied in the descriptors: the same stack memory is reused by every task.
+   */
+  int64_t done = 0;
+  for (int64_t i = 0; i < tasksNumber; i++){
+    struct square_arguments args = {i, &results[i], &done};
+    if (virgil_submit_inline(pool, square, &args, sizeof(args)) != 0){
+      virgil_pool_destroy(pool);
+      return -3;
+    }
+  }
+  waitTasks(&done, tasksNumber);
+
+  /*
+   * Arguments too large for a descriptor are rejected.
+   */
+  unsigned char large[VIRGIL_TASK_INLINE_ARGUMENT_BYTES + 1] = {0};
+  if (virgil_submit_inline(pool, square, large, sizeof(large)) != -1){
+    virgil_pool_destroy(pool);
+    return -4;
+  }
+
+  /*
+   * Arguments owned by the caller, and descriptors owned by the caller.
+   */
+  struct square_arguments pointed = {3, &results[0], &done};
+  virgil_submit(pool, square, &pointed);
+  virgil_task_t task;
+  struct square_arguments described = {4, &results[1], &done};
+  virgil_task_init_inline(&task, square, &described, sizeof(described));
+  virgil_submit_task(pool, &task);
+  waitTasks(&done, tasksNumber + 2);
+  while (!virgil_task_done(&task)){
+    sched_yield();
+  }
+  if (  (results[0] != 9)
+        || (results[1] != 16)
+     ){
+    virgil_pool_destroy(pool);
+    return -5;
+  }
+  results[0] = 0;
+  results[1] = 1;
+
+  /*
+   * Tasks submitted with NULL arguments receive NULL, even in descriptors recycled from tasks with inline arguments.
+   */
+  for (int64_t i = 0; i < tasksNumber; i++){
+    virgil_submit(pool, checkNullArguments, NULL);
+  }
+  waitTasks(&nullTasksDone, tasksNumber);
+  if (nonNullArguments != 0){
+    virgil_pool_destroy(pool);
+    return -6;
+  }
+
+  virgil_pool_destroy(pool);
+
+  return 0;
+}
@@ -0,0 +1,31 @@
+#include "virgil_task.h"
+
+/*
+ * Task of the generated code: add the two integers stored in the descriptor and store the sum where the descriptor says.
+ */
+struct sum_arguments {
+  int64_t a;
+  int64_t b;
+  int64_t *result;
+};
+
+static void sum (void *args){
+  struct sum_arguments *s = (struct sum_arguments *) args;
+  *(s->result) = s->a + s->b;
+
+  return ;
+}
+
+/*
+ * Set up tasks[i] to compute i + offset into results[i].
+ */
+int prepareSums (virgil_task_t *tasks, int64_t *results, int64_t tasksNumber, int64_t offset){
+  for (int64_t i = 0; i < tasksNumber; i++){
+    struct sum_arguments args = {i, offset, &results[i]};
+    if (virgil_task_init_inline(&tasks[i], sum, &args, sizeof(args)) != 0){
+      return -1;
+    }
+  }
+
+  return 0;
+}
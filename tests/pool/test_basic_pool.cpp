@@ -0,0 +1,90 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "ThreadPools.hpp"
+
+static std::atomic<int64_t> executed{0};
+
+static void increment (void *args){
+  executed++;
+
+  return ;
+}
+
+/*
+ * A function object whose call is inlined into the worker loop.
+ */
+struct Increment {
+  int64_t amount = 1;
+
+  void operator() (void) const {
+    executed += this->amount;
+  }
+};
+
+template <typename Pool, typename Submit>
+static bool testPool (const char *name, std::uint32_t threads, int64_t tasks, Submit submit){
+  executed = 0;
+  {
+    Pool pool{false, threads};
+
+    /*
+     * Run the tasks.
+     */
+    for (auto i = 0; i < tasks; i++){
+      submit(pool);
+    }
+    while (executed < tasks){
+      std::this_thread::yield();
+    }
+
+    /*
+     * Tasks submitted while the pool is paused wait for resume.
+     */
+    pool.pause();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (auto i = 0; i < tasks; i++){
+      submit(pool);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (executed != tasks){
+      std::cerr << "ERROR: " << name << ": " << (executed - tasks) << " tasks ran while the pool was paused" << std::endl;
+      return false;
+    }
+    pool.resume();
+    while (executed < (2 * tasks)){
+      std::this_thread::yield();
+    }
+  }
+  std::cout << name << ": OK" << std::endl;
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " THREADS TASKS" << std::endl;
+    return 1;
+  }
+  std::uint32_t threads = atoi(argv[1]);
+  auto tasks = atoi(argv[2]);
+
+  using namespace arcana::virgil;
+  auto submitC = [](auto &pool){ pool.submitAndDetach(increment, nullptr); };
+  if (  (!testPool<FastThreadPoolForC>("FastThreadPoolForC", threads, tasks, submitC))
+        || (!testPool<SpinningThreadPoolForC>("SpinningThreadPoolForC", threads, tasks, submitC))
+        || (!testPool<BasicThreadPool<SpinLockQueuePolicy, YieldingWait, CFunctionTasks, PoolStatistics>>("SpinLock, yielding, statistics", threads, tasks, submitC))
+        || (!testPool<FastThreadPool>("FastThreadPool", threads, tasks, [](auto &pool){ pool.submitAndDetach([](void){ executed++; }); }))
+        || (!testPool<BasicThreadPool<MutexQueuePolicy, BlockingWait, CallableTasks<Increment>>>("Function objects", threads, tasks, [](auto &pool){ pool.submitAndDetach(Increment{1}); }))
+     ){
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 4){
+    std::cerr << "USAGE: " << argv[0] << " PRODUCERS TASKS_PER_PRODUCER BATCH_SIZE" << std::endl;
+    return 1;
+  }
+  auto producers = atoi(argv[1]);
+  auto tasks = atoi(argv[2]);
+  auto batchSize = atoi(argv[3]);
+
+  /*
+   * Create a thread pool whose submitters buffer their tasks.
+   */
+  arcana::virgil::ThreadPool pool{false, 2};
+  pool.enableSubmissionBuffers(batchSize, std::chrono::microseconds{200});
+
+  /*
+   * Submit jobs from several threads.
+   * Only half of the producers flush their buffer at the end: the timer publishes the tasks left in the buffers of the others.
+   */
+  std::atomic<int64_t> executed{0};
+  std::vector<std::thread> threads;
+  for (auto p = 0; p < producers; p++){
+    threads.emplace_back([&pool, &executed, p, tasks](void){
+      for (auto i = 0; i < tasks; i++){
+        pool.submitAndDetach([&executed](void){ executed++; });
+      }
+      if ((p % 2) == 0){
+        pool.flush();
+      }
+    });
+  }
+  for (auto &thread : threads){
+    thread.join();
+  }
+  while (executed != (producers * tasks)){
+    std::this_thread::yield();
+  }
+
+  /*
+   * A future of a buffered task is set once the timer publishes the task.
+   */
+  auto future = pool.submit([](int64_t v) -> int64_t { return v + 1; }, 41);
+  if (future.get() != 42){
+    std::cerr << "ERROR: the buffered task returned a wrong value" << std::endl;
+    return 1;
+  }
+  std::cout << executed << std::endl;
+
+  return 0;
+}
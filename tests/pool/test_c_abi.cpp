@@ -0,0 +1,41 @@
+#include <iostream>
+#include <vector>
+
+#include "ThreadPoolForCABI.hpp"
+
+extern "C" int squaresThroughTheCInterface (uint32_t threads, int64_t *results, int64_t tasksNumber);
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " TASKS THREADS" << std::endl;
+    return 1;
+  }
+  auto tasks = atoll(argv[1]);
+  auto threads = (std::uint32_t) atoi(argv[2]);
+  if (tasks < 2){
+    std::cerr << "ERROR: at least 2 tasks are needed" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Run the C code.
+   */
+  std::vector<int64_t> results(tasks, -1);
+  auto error = squaresThroughTheCInterface(threads, results.data(), tasks);
+  if (error != 0){
+    std::cerr << "ERROR: the C code failed with " << error << std::endl;
+    return 1;
+  }
+  for (int64_t i = 0; i < tasks; i++){
+    if (results[i] != (i * i)){
+      std::cerr << "ERROR: wrong result of task " << i << std::endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+#define VIRGIL_PERFORMANCE_COUNTERS
+
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+#include "ThreadPools.hpp"
+#include "work.hpp"
+
+static std::uint64_t tasksCounted (const arcana::virgil::ThreadPoolPerformanceCounters &c){
+  std::uint64_t n = 0;
+  for (auto &t : c.tasks){
+    n += t.tasks;
+  }
+
+  return n;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 4){
+    std::cerr << "USAGE: " << argv[0] << " TASKS ITERS_PER_TASK THREADS" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+  auto iters = atoi(argv[2]);
+  auto threads = (std::uint32_t) atoi(argv[3]);
+
+  /*
+   * Run two kinds of tasks: a function and a lambda.
+   */
+  arcana::virgil::ThreadPool pool{false, threads};
+  std::vector<arcana::virgil::TaskFuture<double>> results;
+  for (auto i=0; i < tasks; i++){
+    results.push_back(pool.submit(myF, iters));
+    results.push_back(pool.submit([iters](void) -> double { return myF(iters / 2); }));
+  }
+  for (auto& f : results){
+    f.get();
+  }
+
+  /*
+   * Check which events could be counted.
+   */
+  static const char *names[arcana::virgil::COUNTER_EVENTS] = {"cycles", "instructions", "LLC misses", "context switches"};
+  auto c = pool.performanceCounters();
+  if (!c.enabled){
+    std::cerr << "ERROR: the counters have not been compiled in" << std::endl;
+    return 1;
+  }
+  auto anyAvailable = false;
+  for (auto e = 0u; e < arcana::virgil::COUNTER_EVENTS; e++){
+    if (!c.available[e]){
+      std::cout << "The event \"" << names[e] << "\" is not available (check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+      continue ;
+    }
+    anyAvailable = true;
+  }
+  if (!anyAvailable){
+    return 0;
+  }
+
+  /*
+   * The counters of a worker are updated right after the task completes, so wait for the workers to catch up.
+   */
+  while (tasksCounted(c) < results.size()){
+    c = pool.performanceCounters();
+  }
+
+  /*
+   * Print the counters of each kind of task.
+   */
+  for (auto &t : c.tasks){
+    std::cout << t.name << ": " << t.tasks << " tasks" << std::endl;
+    for (auto e = 0u; e < arcana::virgil::COUNTER_EVENTS; e++){
+      if (c.available[e]){
+        std::cout << "  " << names[e] << ": " << t.values[e] << std::endl;
+      }
+    }
+    if (  (c.available[arcana::virgil::COUNTER_CYCLES])
+          && (c.available[arcana::virgil::COUNTER_INSTRUCTIONS])
+       ){
+      std::cout << "  IPC: " << t.instructionsPerCycle() << std::endl;
+    }
+  }
+  if (  (c.tasks.size() != 2)
+        || (tasksCounted(c) != results.size())
+     ){
+    std::cerr << "ERROR: tasks have not been attributed to their function" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
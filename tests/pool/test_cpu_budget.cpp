@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cmath>
+#include <thread>
+#include <sched.h>
+
+#include "ThreadPools.hpp"
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Detect the budget of the process.
+   */
+  auto budget = arcana::virgil::CPUBudget::detect();
+  std::cout << "Affinity: " << budget.affinity << " CPUs" << std::endl;
+  std::cout << "Cpuset: " << budget.cpuset << " CPUs" << std::endl;
+  std::cout << "Quota: " << budget.quota << " CPUs" << std::endl;
+  std::cout << "Budget: " << budget.cpus << " CPUs" << std::endl;
+  if (  (budget.cpus < 1)
+        || (budget.cpus > budget.affinity)
+        || ((budget.cpuset > 0) && (budget.cpus > budget.cpuset))
+        || ((budget.quota > 0) && (budget.cpus > std::ceil(budget.quota)))
+     ){
+    std::cerr << "ERROR: the budget exceeds the limits of the process" << std::endl;
+    return 1;
+  }
+
+  /*
+   * The budget follows the affinity mask.
+   */
+  if (budget.affinity > 1){
+    cpu_set_t original;
+    sched_getaffinity(0, sizeof(original), &original);
+    cpu_set_t single;
+    CPU_ZERO(&single);
+    for (auto cpu = 0; cpu < CPU_SETSIZE; cpu++){
+      if (CPU_ISSET(cpu, &original)){
+        CPU_SET(cpu, &single);
+        break ;
+      }
+    }
+    sched_setaffinity(0, sizeof(single), &single);
+    if (arcana::virgil::CPUBudget::refresh() != 1){
+      std::cerr << "ERROR: the budget ignores the affinity mask" << std::endl;
+      return 1;
+    }
+    sched_setaffinity(0, sizeof(original), &original);
+    arcana::virgil::CPUBudget::refresh();
+  }
+
+  /*
+   * Pools create one worker less than the budget by default.
+   */
+  auto expected = std::max(arcana::virgil::CPUBudget::available(), 2u) - 1u;
+  if (arcana::virgil::CPUBudget::defaultNumberOfThreads() != expected){
+    std::cerr << "ERROR: the default number of workers is " << arcana::virgil::CPUBudget::defaultNumberOfThreads() << " rather than " << expected << std::endl;
+    return 1;
+  }
+  arcana::virgil::ThreadPoolForCMultiQueues pool{true};
+  if (pool.numberOfThreads() != expected){
+    std::cerr << "ERROR: the pool has " << pool.numberOfThreads() << " workers rather than " << expected << std::endl;
+    return 1;
+  }
+
+  /*
+   * A pool that follows the budget adopts it right away.
+   */
+  arcana::virgil::ThreadPoolForCMultiQueues following{true, expected + 2};
+  following.followCPUBudget(std::chrono::milliseconds{5});
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  if (following.numberOfThreads() != expected){
+    std::cerr << "ERROR: the pool that follows the budget has " << following.numberOfThreads() << " workers rather than " << expected << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <vector>
+
+#include "ThreadPools.hpp"
+#include "work.hpp"
+
+extern "C" int prepareSums (virgil_task_t *tasks, int64_t *results, int64_t tasksNumber, int64_t offset);
+
+static std::atomic<int64_t> nullArguments{0};
+static std::atomic<int64_t> otherArguments{0};
+
+static void countNullArguments (void *args){
+  if (args == nullptr){
+    nullArguments++;
+  } else {
+    otherArguments++;
+  }
+
+  return ;
+}
+
+/*
+ * Tasks submitted with NULL arguments receive NULL, even when they run in descriptors that held inline arguments before.
+ */
+template <class Pool>
+static bool testNullArguments (const char *name, Pool &pool, int64_t tasks){
+  nullArguments = 0;
+  otherArguments = 0;
+
+  std::vector<virgil_task_t> descriptors(tasks);
+  for (auto &d : descriptors){
+    virgil_task_init(&d, countNullArguments, nullptr);
+    pool.submitAndDetach(&d);
+    pool.submitAndDetach(countNullArguments, nullptr);
+  }
+  while ((nullArguments + otherArguments) < (2 * tasks)){
+    std::this_thread::yield();
+  }
+  for (auto &d : descriptors){
+    while (!virgil_task_done(&d)){
+      std::this_thread::yield();
+    }
+  }
+  if (otherArguments != 0){
+    std::cerr << "ERROR: " << name << ": " << otherArguments << " tasks submitted with NULL arguments did not receive NULL" << std::endl;
+    return false;
+  }
+  std::cout << name << " (NULL arguments): OK" << std::endl;
+
+  return true;
+}
+
+/*
+ * Submit descriptors owned by the caller and set up by C code, wait for them, and check their results.
+ */
+template <class Pool>
+static bool testPool (const char *name, Pool &pool, int64_t tasks, int64_t rounds){
+  std::vector<virgil_task_t> descriptors(tasks);
+  std::vector<int64_t> results(tasks);
+  for (int64_t r = 0; r < rounds; r++){
+
+    /*
+     * Reuse the same descriptors every round.
+     */
+    if (prepareSums(descriptors.data(), results.data(), tasks, r) != 0){
+      std::cerr << "ERROR: " << name << ": the arguments do not fit in the descriptors" << std::endl;
+      return false;
+    }
+    for (auto &d : descriptors){
+      pool.submitAndDetach(&d);
+    }
+    for (auto &d : descriptors){
+      while (!virgil_task_done(&d)){
+        std::this_thread::yield();
+      }
+    }
+    for (int64_t i = 0; i < tasks; i++){
+      if (results[i] != (i + r)){
+        std::cerr << "ERROR: " << name << ": wrong result of task " << i << std::endl;
+        return false;
+      }
+    }
+  }
+  std::cout << name << ": OK" << std::endl;
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 4){
+    std::cerr << "USAGE: " << argv[0] << " TASKS ROUNDS THREADS" << std::endl;
+    return 1;
+  }
+  auto tasks = atoll(argv[1]);
+  auto rounds = atoll(argv[2]);
+  auto threads = (std::uint32_t) atoi(argv[3]);
+
+  /*
+   * Descriptors and tasks owned by the pool can be mixed.
+   */
+  arcana::virgil::ThreadPoolForCSingleQueue singleQueue{false, threads};
+  arcana::virgil::ThreadPoolForCMultiQueues multiQueues{false, threads};
+  if (  !testPool("ThreadPoolForCSingleQueue", singleQueue, tasks, rounds)
+        || !testPool("ThreadPoolForCMultiQueues", multiQueues, tasks, rounds)
+     ){
+    return 1;
+  }
+
+  /*
+   * Every placement policy delivers the tasks.
+   */
+  multiQueues.setPlacementPolicy(arcana::virgil::PlacementPolicy::PowerOfTwoChoices);
+  if (!testPool("ThreadPoolForCMultiQueues (power of two choices)", multiQueues, tasks, rounds)){
+    return 1;
+  }
+  multiQueues.setPlacementPolicy(arcana::virgil::PlacementPolicy::LeastLoadedInNode);
+  if (!testPool("ThreadPoolForCMultiQueues (least loaded in node)", multiQueues, tasks, rounds)){
+    return 1;
+  }
+  if (  !testNullArguments("ThreadPoolForCSingleQueue", singleQueue, tasks)
+        || !testNullArguments("ThreadPoolForCMultiQueues", multiQueues, tasks)
+     ){
+    return 1;
+  }
+
+  pthread_spinlock_t lock;
+  pthread_spin_init(&lock, 0);
+  pthread_spin_lock(&lock);
+  singleQueue.submitAndDetach(myFInC, (void *)&lock);
+  pthread_spin_lock(&lock);
+
+  return 0;
+}
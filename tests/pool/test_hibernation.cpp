@@ -0,0 +1,114 @@
+#include <iostream>
+#include <thread>
+#include <time.h>
+
+#include "ThreadPools.hpp"
+
+static std::atomic<int64_t> executed{0};
+
+static void increment (void *args){
+  executed++;
+
+  return ;
+}
+
+static double processCPUMilliseconds (void){
+  struct timespec t;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+
+  return (t.tv_sec * 1000.0) + (t.tv_nsec / 1000000.0);
+}
+
+static void waitFor (int64_t tasks){
+  while (executed < tasks){
+    std::this_thread::yield();
+  }
+
+  return ;
+}
+
+template <typename Pool, typename Submit>
+static bool testPool (Pool &pool, Submit submit, int64_t tasks, const char *name){
+  pool.setIdleSpinPeriod(std::chrono::microseconds{500});
+
+  /*
+   * Submit tasks to wake up the workers.
+   */
+  executed = 0;
+  for (auto i = 0; i < tasks; i++){
+    submit(pool);
+  }
+  waitFor(tasks);
+
+  /*
+   * Idle workers stop polling their queue after the spin period.
+   */
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto before = processCPUMilliseconds();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto idleCPU = processCPUMilliseconds() - before;
+  if (idleCPU > 50){
+    std::cerr << "ERROR: " << name << ": the idle pool burned " << idleCPU << " ms of CPU in 100 ms" << std::endl;
+    return false;
+  }
+
+  /*
+   * Tasks submitted to a paused pool wait until it is resumed.
+   */
+  pool.pause();
+  for (auto i = 0; i < tasks; i++){
+    submit(pool);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  if (executed != tasks){
+    std::cerr << "ERROR: " << name << ": " << (executed - tasks) << " tasks have been executed while the pool was paused" << std::endl;
+    return false;
+  }
+  pool.resume();
+  waitFor(2 * tasks);
+  if (executed != (2 * tasks)){
+    std::cerr << "ERROR: " << name << ": " << executed << " tasks have been executed rather than " << (2 * tasks) << std::endl;
+    return false;
+  }
+  std::cout << name << ": idle CPU " << idleCPU << " ms: OK" << std::endl;
+
+  /*
+   * The pool is destroyed while it is paused.
+   */
+  pool.pause();
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " TASKS" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+
+  {
+    arcana::virgil::ThreadPoolForCMultiQueues pool{false, 2};
+    if (!testPool(pool, [](auto &p){ p.submitAndDetach(increment, nullptr); }, tasks, "ThreadPoolForCMultiQueues")){
+      return 1;
+    }
+  }
+  {
+    arcana::virgil::ThreadPoolForCSingleQueue pool{false, 2};
+    if (!testPool(pool, [](auto &p){ p.submitAndDetach(increment, nullptr); }, tasks, "ThreadPoolForCSingleQueue")){
+      return 1;
+    }
+  }
+  {
+    arcana::virgil::ThreadPool pool{false, 2};
+    if (!testPool(pool, [](auto &p){ p.submitAndDetach([](void){ executed++; }); }, tasks, "ThreadPool")){
+      return 1;
+    }
+  }
+
+  return 0;
+}
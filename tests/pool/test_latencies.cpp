@@ -0,0 +1,99 @@
+#define VIRGIL_LATENCY_HISTOGRAMS
+
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+#include "ThreadPools.hpp"
+#include "work.hpp"
+
+static void printHistogram (const char *name, const arcana::virgil::LatencyHistogram &h){
+  std::cout << "  " << name << ": " << h.count() << " samples, "
+            << "mean " << h.mean() << " ns, "
+            << "p50 " << h.percentile(50) << " ns, "
+            << "p99 " << h.percentile(99) << " ns, "
+            << "p99.9 " << h.percentile(99.9) << " ns, "
+            << "max " << h.max() << " ns" << std::endl;
+
+  return ;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 4){
+    std::cerr << "USAGE: " << argv[0] << " TASKS ITERS_PER_TASK THREADS" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+  auto iters = atoi(argv[2]);
+  auto threads = (std::uint32_t) atoi(argv[3]);
+
+  /*
+   * Check the precision of the histogram.
+   */
+  arcana::virgil::LatencyHistogram h;
+  for (std::uint64_t v = 1; v <= 100000; v++){
+    h.record(v);
+  }
+  auto p99 = h.percentile(99);
+  if (  (h.count() != 100000)
+        || (p99 < 99000)
+        || (p99 > 99000 * 1.04)
+     ){
+    std::cerr << "ERROR: the histogram returned " << p99 << " as the 99th percentile of 1..100000" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Run tasks.
+   */
+  arcana::virgil::ThreadPool pool{false, threads};
+  std::vector<arcana::virgil::TaskFuture<double>> results;
+  for (auto i=0; i < tasks; i++){
+    results.push_back(pool.submit(myF, iters));
+  }
+  for (auto& f : results){
+    f.get();
+  }
+
+  /*
+   * Print the latencies.
+   * The histograms of a worker are updated right after the task completes, so wait for the workers to catch up.
+   */
+  auto l = pool.latencies();
+  while (l.execution.count() < tasks){
+    l = pool.latencies();
+  }
+  std::cout << "ThreadPool:" << std::endl;
+  printHistogram("Queue residence", l.queueResidence);
+  printHistogram("Execution", l.execution);
+  printHistogram("Future wait", l.futureWait);
+  if (  (!l.enabled)
+        || (l.workers.size() != threads)
+        || (l.queueResidence.count() != tasks)
+        || (l.futureWait.count() != tasks)
+     ){
+    std::cerr << "ERROR: wrong latencies" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Futures can outlive their pool: they keep the histogram where get() records its wait.
+   */
+  std::atomic_bool executed{false};
+  std::unique_ptr<arcana::virgil::ThreadPool> shortLived = std::make_unique<arcana::virgil::ThreadPool>(false, 1);
+  auto orphan = shortLived->submit([&executed](void) -> int64_t { executed = true; return 7; });
+  while (!executed){
+    std::this_thread::yield();
+  }
+  shortLived.reset();
+  if (orphan.get() != 7){
+    std::cerr << "ERROR: the future that outlived its pool returned a wrong value" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
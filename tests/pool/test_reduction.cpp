@@ -0,0 +1,145 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include "ThreadPools.hpp"
+
+using namespace arcana::virgil;
+
+/*
+ * A value that is not arithmetic.
+ */
+struct Range {
+  int64_t minimum;
+  int64_t maximum;
+};
+
+static Range combineRanges (const Range &a, const Range &b){
+  return Range{std::min(a.minimum, b.minimum), std::max(a.maximum, b.maximum)};
+}
+
+static bool testReductions (ThreadPool &pool, int64_t elements){
+  for (auto mode : {ReductionMode::Fast, ReductionMode::Deterministic}){
+
+    /*
+     * Integers.
+     */
+    auto sum = pool.parallelReduce<int64_t>(0, elements, 0, [](int64_t i){ return i; }, std::plus<int64_t>{}, mode);
+    if (sum != ((elements * (elements - 1)) / 2)){
+      std::cerr << "ERROR: the sum is " << sum << std::endl;
+      return false;
+    }
+
+    /*
+     * Values that are not arithmetic.
+     */
+    auto range = pool.parallelReduce(0, elements, Range{INT64_MAX, INT64_MIN}, [elements](int64_t i){ return Range{elements - 1 - i, elements - 1 - i}; }, combineRanges, mode);
+    if (  (range.minimum != 0)
+          || (range.maximum != (elements - 1))
+       ){
+      std::cerr << "ERROR: the range is [" << range.minimum << ", " << range.maximum << "]" << std::endl;
+      return false;
+    }
+
+    /*
+     * Empty iteration spaces.
+     */
+    if (pool.parallelReduce<int64_t>(5, 5, 42, [](int64_t i){ return i; }, std::plus<int64_t>{}, mode) != 42){
+      std::cerr << "ERROR: the reduction of an empty iteration space is not its identity" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool testScans (ThreadPool &pool, int64_t elements){
+  std::vector<int64_t> input(elements);
+  for (auto i = 0; i < elements; i++){
+    input[i] = (i % 13) - 6;
+  }
+  std::vector<int64_t> expected(elements);
+  std::vector<int64_t> output(elements);
+
+  for (auto mode : {ReductionMode::Fast, ReductionMode::Deterministic}){
+
+    /*
+     * Inclusive scan.
+     */
+    std::inclusive_scan(input.begin(), input.end(), expected.begin());
+    auto end = pool.parallelInclusiveScan(input.begin(), input.end(), output.begin(), std::plus<int64_t>{}, mode);
+    if (  (end != output.end())
+          || (output != expected)
+       ){
+      std::cerr << "ERROR: the inclusive scan is wrong" << std::endl;
+      return false;
+    }
+
+    /*
+     * Exclusive scan in place.
+     */
+    std::exclusive_scan(input.begin(), input.end(), expected.begin(), int64_t{100});
+    output = input;
+    pool.parallelExclusiveScan(output.begin(), output.end(), output.begin(), int64_t{100}, std::plus<int64_t>{}, mode);
+    if (output != expected){
+      std::cerr << "ERROR: the exclusive scan is wrong" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static double sumOfInverses (ThreadPool &pool, int64_t elements, ReductionMode mode){
+  return pool.parallelReduce(0, elements, 0.0, [](int64_t i){ return 1.0 / (i + 1); }, std::plus<double>{}, mode);
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " THREADS ELEMENTS" << std::endl;
+    return 1;
+  }
+  std::uint32_t threads = atoi(argv[1]);
+  int64_t elements = atoll(argv[2]);
+
+  ThreadPool pool{false, threads};
+  if (  (!testReductions(pool, elements))
+        || (!testScans(pool, elements))
+     ){
+    return 1;
+  }
+
+  /*
+   * Deterministic reductions of floating point values do not depend on the number of workers.
+   */
+  ThreadPool single{false, 1};
+  auto reference = sumOfInverses(single, elements, ReductionMode::Deterministic);
+  for (auto i = 0; i < 10; i++){
+    auto value = sumOfInverses(pool, elements, ReductionMode::Deterministic);
+    if (std::memcmp(&value, &reference, sizeof(double)) != 0){
+      std::cerr << "ERROR: the deterministic sum is " << value << " rather than " << reference << std::endl;
+      return 1;
+    }
+  }
+
+  /*
+   * Tasks of the pool can reduce on the pool itself.
+   */
+  auto nested = pool.submit([&pool, elements](void){
+    return pool.parallelReduce<int64_t>(0, elements, 0, [](int64_t i){ return 1; }, std::plus<int64_t>{});
+  }).get();
+  if (nested != elements){
+    std::cerr << "ERROR: the nested reduction counted " << nested << " elements" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Sum of inverses: " << reference << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ThreadPools.hpp"
+
+static std::atomic<int64_t> executed{0};
+static std::atomic_bool release{false};
+
+static void increment (void *args){
+  executed++;
+
+  return ;
+}
+
+static void block (void *args){
+  auto started = (std::atomic_bool *)args;
+  *started = true;
+  while (!release){
+    std::this_thread::yield();
+  }
+
+  return ;
+}
+
+static bool waitFor (int64_t tasks, const char *phase){
+  while (executed < tasks){
+    std::this_thread::yield();
+  }
+  if (executed != tasks){
+    std::cerr << "ERROR: " << phase << ": " << executed << " tasks have been executed rather than " << tasks << std::endl;
+    return false;
+  }
+  std::cout << phase << ": OK" << std::endl;
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " TASKS RESIZES" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+  auto resizes = atoi(argv[2]);
+  int64_t expected = 0;
+
+  /*
+   * Growing the pool adds workers with their own queues.
+   */
+  arcana::virgil::ThreadPoolForCMultiQueues pool{true, 2};
+  pool.resize(4);
+  if (pool.numberOfThreads() != 4){
+    std::cerr << "ERROR: the pool has " << pool.numberOfThreads() << " workers rather than 4" << std::endl;
+    return 1;
+  }
+  for (auto i = 0; i < tasks; i++){
+    pool.submitAndDetach(increment, nullptr, i % 4);
+  }
+  expected += tasks;
+  if (!waitFor(expected, "Grow")){
+    return 1;
+  }
+
+  /*
+   * Shrinking the pool moves the tasks queued to the removed workers.
+   */
+  pool.resize(4);
+  std::atomic_bool started{false};
+  pool.submitAndDetach(block, &started, 3);
+  while (!started){
+    std::this_thread::yield();
+  }
+  for (auto i = 0; i < tasks; i++){
+    pool.submitAndDetach(increment, nullptr, 3);
+  }
+  expected += tasks;
+  std::thread releaser{[](void){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    release = true;
+  }};
+  pool.resize(1);
+  releaser.join();
+  if (pool.numberOfThreads() != 1){
+    std::cerr << "ERROR: the pool has " << pool.numberOfThreads() << " workers rather than 1" << std::endl;
+    return 1;
+  }
+  if (!waitFor(expected, "Shrink")){
+    return 1;
+  }
+
+  /*
+   * Submitters are not affected by concurrent resizes.
+   */
+  pool.setPlacementPolicy(arcana::virgil::PlacementPolicy::PowerOfTwoChoices);
+  std::vector<std::thread> producers;
+  for (auto p = 0; p < 2; p++){
+    producers.emplace_back([&pool, tasks](void){
+      for (auto i = 0; i < tasks; i++){
+        if ((i % 2) == 0){
+          pool.submitAndDetach(increment, nullptr);
+        } else {
+          pool.submitAndDetach(increment, nullptr, i);
+        }
+      }
+    });
+  }
+  for (auto r = 0; r < resizes; r++){
+    pool.resize(1 + (r % 4));
+  }
+  for (auto &producer : producers){
+    producer.join();
+  }
+  expected += 2 * tasks;
+  if (!waitFor(expected, "Concurrent resizes")){
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+/*
+ * Block the only worker of @pool until @release is set, and wait for the worker to pick the blocking task.
+ */
+static void occupyWorker (arcana::virgil::ThreadPool &pool, std::atomic_bool &release){
+  std::atomic_bool started{false};
+  pool.submitAndDetach([&started, &release](void){
+    started = true;
+    while (!release){
+      std::this_thread::yield();
+    }
+  });
+  while (!started){
+    std::this_thread::yield();
+  }
+
+  return ;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " TASKS MAXIMUM_QUEUE_DEPTH" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+  auto depth = atoi(argv[2]);
+
+  /*
+   * Reject: the queue holds at most depth tasks while the worker is busy.
+   */
+  {
+    arcana::virgil::ThreadPool pool{false, 1};
+    pool.setSaturationPolicy(depth, arcana::virgil::SaturationPolicy::Reject);
+    std::atomic_bool release{false};
+    occupyWorker(pool, release);
+    std::atomic<int64_t> executed{0};
+    std::vector<arcana::virgil::TaskFuture<void>> results;
+    auto rejected = 0;
+    for (auto i = 0; i < tasks; i++){
+      results.push_back(pool.submit([&executed](void){ executed++; }));
+      if (!results.back().valid()){
+        rejected++;
+      }
+    }
+    if (  (rejected != (tasks - depth))
+          || (pool.numberOfTasksWaitingToBeProcessed() != depth)
+          || pool.submitAndDetach([](void){})
+       ){
+      std::cerr << "ERROR: Reject: the queue of the pool exceeded its maximum depth" << std::endl;
+      return 1;
+    }
+    release = true;
+    for (auto &result : results){
+      if (result.valid()){
+        result.get();
+      }
+    }
+    if (executed != depth){
+      std::cerr << "ERROR: Reject: " << executed << " tasks have been executed rather than " << depth << std::endl;
+      return 1;
+    }
+    std::cout << "Reject: OK" << std::endl;
+  }
+
+  /*
+   * CallerRuns: tasks that do not fit run on the submitting thread.
+   */
+  {
+    arcana::virgil::ThreadPool pool{false, 1};
+    pool.setSaturationPolicy(depth, arcana::virgil::SaturationPolicy::CallerRuns);
+    std::atomic_bool release{false};
+    occupyWorker(pool, release);
+    auto caller = std::this_thread::get_id();
+    std::atomic<int64_t> onCaller{0};
+    std::atomic<int64_t> executed{0};
+    std::vector<arcana::virgil::TaskFuture<void>> results;
+    for (auto i = 0; i < tasks; i++){
+      results.push_back(pool.submit([&executed, &onCaller, caller](void){
+        executed++;
+        if (std::this_thread::get_id() == caller){
+          onCaller++;
+        }
+      }));
+    }
+    if (  (onCaller != (tasks - depth))
+          || (pool.numberOfTasksWaitingToBeProcessed() > depth)
+       ){
+      std::cerr << "ERROR: CallerRuns: " << onCaller << " tasks ran on the caller rather than " << (tasks - depth) << std::endl;
+      return 1;
+    }
+    release = true;
+    for (auto &result : results){
+      result.get();
+    }
+    if (executed != tasks){
+      std::cerr << "ERROR: CallerRuns: tasks have been lost" << std::endl;
+      return 1;
+    }
+    std::cout << "CallerRuns: OK" << std::endl;
+  }
+
+  /*
+   * Block: producers wait for room, so every task runs and the queue stays within its maximum depth.
+   */
+  {
+    arcana::virgil::ThreadPool pool{false, 2};
+    pool.setSaturationPolicy(depth, arcana::virgil::SaturationPolicy::Block);
+    std::atomic<int64_t> executed{0};
+    std::atomic_bool bounded{true};
+    std::vector<std::thread> producers;
+    for (auto p = 0; p < 2; p++){
+      producers.emplace_back([&pool, &executed, &bounded, tasks, depth](void){
+        for (auto i = 0; i < tasks; i++){
+          pool.submitAndDetach([&executed](void){ executed++; });
+          if (pool.numberOfTasksWaitingToBeProcessed() > depth){
+            bounded = false;
+          }
+        }
+      });
+    }
+    for (auto &producer : producers){
+      producer.join();
+    }
+    while (executed != (2 * tasks)){
+      std::this_thread::yield();
+    }
+    if (!bounded){
+      std::cerr << "ERROR: Block: the queue of the pool exceeded its maximum depth" << std::endl;
+      return 1;
+    }
+    std::cout << "Block: OK" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <dirent.h>
+
+#include "ThreadPools.hpp"
+
+static std::atomic<int64_t> executed{0};
+
+static void increment (void *args){
+  executed++;
+
+  return ;
+}
+
+static int64_t numberOfThreadsOfTheProcess (void){
+  int64_t threads = 0;
+  auto directory = opendir("/proc/self/task");
+  if (directory == nullptr){
+    return -1;
+  }
+  while (auto entry = readdir(directory)){
+    if (entry->d_name[0] != '.'){
+      threads++;
+    }
+  }
+  closedir(directory);
+
+  return threads;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " POOLS TASKS_PER_POOL" << std::endl;
+    return 1;
+  }
+  auto pools = atoi(argv[1]);
+  auto tasks = atoi(argv[2]);
+
+  /*
+   * Create several pools on top of the same executor.
+   * They do not create threads.
+   */
+  arcana::virgil::SharedExecutor executor{2};
+  auto threadsBefore = numberOfThreadsOfTheProcess();
+  std::vector<std::unique_ptr<arcana::virgil::ThreadPool>> cppPools;
+  std::vector<std::unique_ptr<arcana::virgil::ThreadPoolForCSingleQueue>> cPools;
+  for (auto p = 0; p < pools; p++){
+    cppPools.push_back(std::make_unique<arcana::virgil::ThreadPool>(executor));
+    cPools.push_back(std::make_unique<arcana::virgil::ThreadPoolForCSingleQueue>(executor));
+  }
+  auto threadsAfter = numberOfThreadsOfTheProcess();
+  if (threadsAfter != threadsBefore){
+    std::cerr << "ERROR: the pools created " << (threadsAfter - threadsBefore) << " threads" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Submit tasks to all pools from several threads.
+   * Tasks of the C++ pools submit tasks to the C pools.
+   */
+  std::vector<std::thread> producers;
+  for (auto p = 0; p < pools; p++){
+    producers.emplace_back([&cppPools, &cPools, p, tasks](void){
+      auto &cPool = *cPools[p];
+      for (auto i = 0; i < tasks; i++){
+        cppPools[p]->submitAndDetach([&cPool](void){
+
+          /*
+           * Count the task once its submission returned, so the pools are not destroyed while it submits.
+           */
+          cPool.submitAndDetach(increment, nullptr);
+          executed++;
+        });
+      }
+    });
+  }
+  for (auto &producer : producers){
+    producer.join();
+  }
+  while (executed < (2 * pools * tasks)){
+    std::this_thread::yield();
+  }
+  if (executed != (2 * pools * tasks)){
+    std::cerr << "ERROR: " << executed << " tasks have been executed rather than " << (2 * pools * tasks) << std::endl;
+    return 1;
+  }
+
+  /*
+   * Futures work as with pools that have their own threads.
+   */
+  auto future = cppPools[0]->submit([](int64_t v) -> int64_t { return v + 1; }, 41);
+  if (future.get() != 42){
+    std::cerr << "ERROR: the task returned a wrong value" << std::endl;
+    return 1;
+  }
+
+  /*
+   * A paused pool does not prevent the executor from serving the others.
+   */
+  cppPools[0]->pause();
+  auto paused = cppPools[0]->submit([](void) -> int64_t { return 1; });
+  auto running = cppPools[pools - 1]->submit([](void) -> int64_t { return 2; });
+  if (  (running.get() != 2)
+        || (cppPools[0]->numberOfTasksWaitingToBeProcessed() != 1)
+     ){
+    std::cerr << "ERROR: the executor did not skip the paused pool" << std::endl;
+    return 1;
+  }
+  cppPools[0]->resume();
+  if (paused.get() != 1){
+    std::cerr << "ERROR: the task of the resumed pool returned a wrong value" << std::endl;
+    return 1;
+  }
+
+  /*
+   * The process-wide executor is created at its first use.
+   */
+  arcana::virgil::ThreadPool shared{arcana::virgil::SharedExecutor::instance()};
+  if (shared.submit([](void) -> int64_t { return 3; }).get() != 3){
+    std::cerr << "ERROR: the task of the process-wide executor returned a wrong value" << std::endl;
+    return 1;
+  }
+  std::cout << executed << std::endl;
+
+  return 0;
+}
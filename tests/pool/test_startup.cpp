@@ -0,0 +1,183 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <dirent.h>
+
+#include "ThreadPools.hpp"
+
+static std::atomic<int64_t> executed{0};
+
+static void increment (void *args){
+  executed++;
+
+  return ;
+}
+
+/*
+ * Tasks that wait for each other: they complete only if each of them gets a worker of its own.
+ * A task gives up after a while, so a pool that serializes them fails rather than hangs.
+ */
+static std::atomic<std::uint32_t> arrived{0};
+static std::atomic<std::uint32_t> gaveUp{0};
+static std::uint32_t tasksWaitingForEachOther = 0;
+
+static void waitForTheOthers (void *args){
+  arrived++;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (arrived < tasksWaitingForEachOther){
+    if (std::chrono::steady_clock::now() > deadline){
+      gaveUp++;
+      break ;
+    }
+    std::this_thread::yield();
+  }
+  executed++;
+
+  return ;
+}
+
+static int64_t numberOfThreadsOfTheProcess (void){
+  int64_t threads = 0;
+  auto directory = opendir("/proc/self/task");
+  if (directory == nullptr){
+    return -1;
+  }
+  while (auto entry = readdir(directory)){
+    if (entry->d_name[0] != '.'){
+      threads++;
+    }
+  }
+  closedir(directory);
+
+  return threads;
+}
+
+static const char * nameOf (arcana::virgil::StartMode mode){
+  switch (mode){
+    case arcana::virgil::StartMode::Eager:
+      return "Eager";
+    case arcana::virgil::StartMode::Lazy:
+      return "Lazy";
+    case arcana::virgil::StartMode::Parallel:
+      return "Parallel";
+  }
+
+  return "";
+}
+
+template <typename Pool, typename Submit>
+static bool testMode (arcana::virgil::StartMode mode, std::uint32_t threads, int64_t tasks, Submit submit){
+  arcana::virgil::WorkerConfiguration configuration;
+  configuration.startMode = mode;
+  executed = 0;
+
+  /*
+   * Create the pool.
+   */
+  auto threadsBefore = numberOfThreadsOfTheProcess();
+  auto start = std::chrono::steady_clock::now();
+  {
+    Pool pool{false, threads, nullptr, configuration};
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    /*
+     * A lazy pool starts a single worker.
+     */
+    if (  (mode == arcana::virgil::StartMode::Lazy)
+          && (numberOfThreadsOfTheProcess() != (threadsBefore + 1))
+       ){
+      std::cerr << "ERROR: the lazy pool started " << (numberOfThreadsOfTheProcess() - threadsBefore) << " workers" << std::endl;
+      return false;
+    }
+
+    /*
+     * Submit tasks.
+     */
+    for (auto i = 0; i < tasks; i++){
+      submit(pool);
+    }
+    while (executed < tasks){
+      std::this_thread::yield();
+    }
+
+    /*
+     * Once warmed up, the pool has all its workers.
+     */
+    pool.warmup();
+    if (numberOfThreadsOfTheProcess() != (threadsBefore + threads)){
+      std::cerr << "ERROR: " << nameOf(mode) << ": the pool has " << (numberOfThreadsOfTheProcess() - threadsBefore) << " workers rather than " << threads << std::endl;
+      return false;
+    }
+    std::cout << nameOf(mode) << ": construction took " << elapsed << " us" << std::endl;
+  }
+  if (executed != tasks){
+    std::cerr << "ERROR: " << nameOf(mode) << ": " << executed << " tasks have been executed rather than " << tasks << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+template <typename Pool, typename Submit>
+static bool testTasksWaitingForEachOther (arcana::virgil::StartMode mode, std::uint32_t threads, Submit submit){
+  arcana::virgil::WorkerConfiguration configuration;
+  configuration.startMode = mode;
+  tasksWaitingForEachOther = threads;
+
+  for (auto round = 0; round < 20; round++){
+    executed = 0;
+    arrived = 0;
+    gaveUp = 0;
+    {
+      Pool pool{false, threads, nullptr, configuration};
+      for (std::uint32_t i = 0; i < threads; i++){
+        submit(pool);
+      }
+      while (executed < threads){
+        std::this_thread::yield();
+      }
+    }
+    if (gaveUp > 0){
+      std::cerr << "ERROR: " << nameOf(mode) << ": " << gaveUp << " out of " << threads << " tasks waiting for each other did not run at the same time" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " THREADS TASKS" << std::endl;
+    return 1;
+  }
+  std::uint32_t threads = atoi(argv[1]);
+  auto tasks = atoi(argv[2]);
+
+  for (auto mode : {arcana::virgil::StartMode::Eager, arcana::virgil::StartMode::Lazy, arcana::virgil::StartMode::Parallel}){
+    auto submitC = [](auto &pool){ pool.submitAndDetach(increment, nullptr); };
+    if (  (!testMode<arcana::virgil::ThreadPoolForCSingleQueue>(mode, threads, tasks, submitC))
+          || (!testMode<arcana::virgil::ThreadPoolForCMultiQueues>(mode, threads, tasks, submitC))
+          || (!testMode<arcana::virgil::ThreadPool>(mode, threads, tasks, [](auto &pool){ pool.submitAndDetach([](void){ executed++; }); }))
+       ){
+      return 1;
+    }
+
+    /*
+     * Workers started lazily take the tasks that wait for the busy workers.
+     */
+    auto submitWaiting = [](auto &pool){ pool.submitAndDetach(waitForTheOthers, nullptr); };
+    if (  (!testTasksWaitingForEachOther<arcana::virgil::ThreadPoolForCSingleQueue>(mode, threads, submitWaiting))
+          || (!testTasksWaitingForEachOther<arcana::virgil::ThreadPoolForCMultiQueues>(mode, threads, submitWaiting))
+          || (!testTasksWaitingForEachOther<arcana::virgil::ThreadPool>(mode, threads, [](auto &pool){ pool.submitAndDetach(waitForTheOthers, nullptr); }))
+       ){
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+#define VIRGIL_STATISTICS
+
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+#include "ThreadPools.hpp"
+#include "work.hpp"
+
+static void printStatistics (const char *name, const arcana::virgil::ThreadPoolStatistics &s){
+  std::cout << name << ": " << s.total.tasksExecuted << " tasks, "
+            << s.total.busyNanoseconds << " ns busy, "
+            << s.total.idleNanoseconds << " ns idle, "
+            << s.total.wakeups << " wakeups ("
+            << s.total.spuriousWakeups << " spurious), "
+            << s.total.queueWaitNanoseconds << " ns waiting in the queue" << std::endl;
+  for (auto i=0; i < s.workers.size(); i++){
+    std::cout << "  Worker " << i << ": " << s.workers[i].tasksExecuted << " tasks" << std::endl;
+  }
+
+  return ;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 4){
+    std::cerr << "USAGE: " << argv[0] << " TASKS ITERS_PER_TASK THREADS" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+  auto iters = atoi(argv[2]);
+  auto threads = (std::uint32_t) atoi(argv[3]);
+
+  /*
+   * Run tasks through the C++ thread pool.
+   */
+  {
+    arcana::virgil::ThreadPool pool{false, threads};
+    std::vector<arcana::virgil::TaskFuture<double>> results;
+    for (auto i=0; i < tasks; i++){
+      results.push_back(pool.submit(myF, iters));
+    }
+    for (auto& f : results){
+      f.get();
+    }
+
+    /*
+     * Check the counters.
+     * The counter of a worker is updated right after the task completes, so wait for the workers to catch up.
+     */
+    auto s = pool.stats();
+    while (s.total.tasksExecuted < tasks){
+      s = pool.stats();
+    }
+    printStatistics("ThreadPool", s);
+    if (  (!s.enabled)
+          || (s.workers.size() != threads)
+          || (s.total.tasksExecuted != tasks)
+       ){
+      std::cerr << "ERROR: wrong statistics" << std::endl;
+      return 1;
+    }
+  }
+
+  /*
+   * Run tasks through the C thread pool.
+   */
+  {
+    arcana::virgil::ThreadPoolForCSingleQueue pool{false, threads};
+    auto locks = new pthread_spinlock_t[tasks];
+    for (auto i=0; i < tasks; i++){
+      auto &lock = locks[i];
+      pthread_spin_init(&lock, 0);
+      pthread_spin_lock(&lock);
+      pool.submitAndDetach(myFInC, (void *)&lock);
+    }
+    for (auto i=0; i < tasks; i++){
+      pthread_spin_lock(&locks[i]);
+    }
+
+    auto s = pool.stats();
+    while (s.total.tasksExecuted < tasks){
+      s = pool.stats();
+    }
+    printStatistics("ThreadPoolForCSingleQueue", s);
+    if (s.total.tasksExecuted != tasks){
+      std::cerr << "ERROR: wrong statistics" << std::endl;
+      return 1;
+    }
+    delete[] locks;
+  }
+
+  return 0;
+}
@@ -0,0 +1,66 @@
+#define VIRGIL_TRACING
+
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+#include "ThreadPools.hpp"
+#include "work.hpp"
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 5){
+    std::cerr << "USAGE: " << argv[0] << " TASKS ITERS_PER_TASK THREADS TRACE_FILE" << std::endl;
+    return 1;
+  }
+  auto tasks = atoi(argv[1]);
+  auto iters = atoi(argv[2]);
+  auto threads = (std::uint32_t) atoi(argv[3]);
+  auto traceFile = argv[4];
+
+  /*
+   * Trace a thread pool.
+   */
+  auto &tracer = arcana::virgil::Tracer::instance();
+  if (!tracer.start(traceFile)){
+    std::cerr << "ERROR: cannot trace to " << traceFile << std::endl;
+    return 1;
+  }
+  {
+    arcana::virgil::ThreadPool pool{false, threads};
+    std::vector<arcana::virgil::TaskFuture<double>> results;
+    for (auto i=0; i < tasks; i++){
+      results.push_back(pool.submit(myF, iters));
+    }
+  }
+  tracer.stop();
+
+  /*
+   * Check the trace: every task has been submitted, dequeued, started, and completed.
+   */
+  auto f = fopen(traceFile, "rb");
+  arcana::virgil::TraceFileHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1){
+    std::cerr << "ERROR: the trace is empty" << std::endl;
+    return 1;
+  }
+  std::uint64_t counts[arcana::virgil::TRACE_END] = {0};
+  arcana::virgil::TraceEvent e;
+  while ((fread(&e, sizeof(e), 1, f) == 1) && (e.type != arcana::virgil::TRACE_END)){
+    counts[e.type]++;
+  }
+  fclose(f);
+  for (auto i=0; i < arcana::virgil::TRACE_END; i++){
+    if (counts[i] != tasks){
+      std::cerr << "ERROR: event " << i << " has been traced " << counts[i] << " times instead of " << tasks << std::endl;
+      return 1;
+    }
+  }
+  std::cout << "Trace written to " << traceFile << std::endl;
+
+  return 0;
+}
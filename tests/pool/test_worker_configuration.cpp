@@ -0,0 +1,146 @@
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ThreadPools.hpp"
+
+/*
+ * What a worker sees of itself.
+ */
+struct WorkerProperties {
+  std::string name;
+  std::size_t stackSize = 0;
+  std::size_t guardSize = 0;
+  int policy = -1;
+  int niceValue = 0;
+};
+
+static WorkerProperties propertiesOfTheCurrentThread (void){
+  WorkerProperties properties;
+
+  char name[16] = {};
+  pthread_getname_np(pthread_self(), name, sizeof(name));
+  properties.name = name;
+
+  pthread_attr_t attributes;
+  pthread_getattr_np(pthread_self(), &attributes);
+  pthread_attr_getstacksize(&attributes, &properties.stackSize);
+  pthread_attr_getguardsize(&attributes, &properties.guardSize);
+  pthread_attr_destroy(&attributes);
+
+  sched_param parameters;
+  pthread_getschedparam(pthread_self(), &properties.policy, &parameters);
+  properties.niceValue = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+
+  return properties;
+}
+
+static bool check (arcana::virgil::ThreadPool &pool, const arcana::virgil::WorkerConfiguration &configuration, int expectedNice){
+  auto properties = pool.submit(propertiesOfTheCurrentThread).get();
+
+  if (properties.name.rfind(configuration.namePrefix + "-", 0) != 0){
+    std::cerr << "ERROR: the worker is named " << properties.name << std::endl;
+    return false;
+  }
+  if (  (configuration.stackSize > 0)
+        && ((properties.stackSize < configuration.stackSize) || (properties.stackSize > (configuration.stackSize + configuration.guardSize + 65536)))
+     ){
+    std::cerr << "ERROR: the stack of the worker has " << properties.stackSize << " bytes rather than " << configuration.stackSize << std::endl;
+    return false;
+  }
+  if (  (configuration.guardSize > 0)
+        && (properties.guardSize < configuration.guardSize)
+     ){
+    std::cerr << "ERROR: the guard of the worker has " << properties.guardSize << " bytes rather than " << configuration.guardSize << std::endl;
+    return false;
+  }
+  if (properties.policy != configuration.schedulingPolicy){
+    std::cerr << "ERROR: the worker uses the policy " << properties.policy << " rather than " << configuration.schedulingPolicy << std::endl;
+    return false;
+  }
+  if (properties.niceValue != expectedNice){
+    std::cerr << "ERROR: the nice value of the worker is " << properties.niceValue << " rather than " << expectedNice << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " THREADS" << std::endl;
+    return 1;
+  }
+  std::uint32_t threads = atoi(argv[1]);
+  auto niceValue = getpriority(PRIO_PROCESS, 0);
+
+  /*
+   * Small stacks, a batch class, a lower priority, and locked stacks.
+   */
+  arcana::virgil::WorkerConfiguration configuration;
+  configuration.stackSize = 128 * 1024;
+  configuration.guardSize = 16 * 1024;
+  configuration.schedulingPolicy = SCHED_BATCH;
+  configuration.niceIncrement = 2;
+  configuration.namePrefix = "lane";
+  configuration.lockStacks = true;
+  {
+    arcana::virgil::ThreadPool pool{false, threads, nullptr, configuration};
+    if (!check(pool, configuration, std::min(niceValue + 2, 19))){
+      return 1;
+    }
+  }
+
+  /*
+   * Every start mode applies the configuration.
+   */
+  configuration.startMode = arcana::virgil::StartMode::Parallel;
+  configuration.lockStacks = false;
+  {
+    arcana::virgil::ThreadPool pool{false, threads, nullptr, configuration};
+    pool.warmup();
+    if (!check(pool, configuration, std::min(niceValue + 2, 19))){
+      return 1;
+    }
+  }
+
+  /*
+   * The workers of a shared executor use it too.
+   */
+  {
+    arcana::virgil::SharedExecutor executor{2, configuration};
+    arcana::virgil::ThreadPool pool{executor};
+    auto properties = pool.submit(propertiesOfTheCurrentThread).get();
+    if (properties.name.rfind("lane-shared-", 0) != 0){
+      std::cerr << "ERROR: the worker of the executor is named " << properties.name << std::endl;
+      return 1;
+    }
+  }
+
+  /*
+   * A real-time class either applies or makes the constructor fail.
+   */
+  arcana::virgil::WorkerConfiguration realTime;
+  realTime.schedulingPolicy = SCHED_FIFO;
+  realTime.schedulingPriority = sched_get_priority_min(SCHED_FIFO);
+  try {
+    arcana::virgil::ThreadPool pool{false, threads, nullptr, realTime};
+    if (!check(pool, realTime, niceValue)){
+      return 1;
+    }
+    std::cout << "SCHED_FIFO: applied" << std::endl;
+  } catch (const std::system_error &error){
+    std::cout << "SCHED_FIFO: not allowed (" << error.what() << ")" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,505 @@
+/*
+ * Benchmark of all thread-safe queues.
+ *
+ * Every queue moves payloads of 8 to 64 bytes (a cache line) in four configurations:
+ *   spsc: one producer, one consumer,
+ *   mpsc: several producers, one consumer,
+ *   spmc: one producer, several consumers,
+ *   mpmc: several producers, several consumers.
+ * Each configuration reports throughput and the last-level cache misses per operation.
+ * A ping-pong between two threads through a pair of queues reports the round-trip latency percentiles.
+ *
+ * The plain moodycamel::BlockingReaderWriterQueue, which ThreadSafeSPSCLockFreeQueue wraps, is included as a reference point.
+ * Queues that do not support multiple producers or consumers are measured only in the configurations they support.
+ */
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThreadSafeMutexQueue.hpp"
+#include "ThreadSafeMutexQueueSleep.hpp"
+#include "ThreadSafeSpinLockQueue.hpp"
+#include "ThreadSafeLockFreeQueue.hpp"
+#include "ThreadSafeSPSCLockFreeQueue.hpp"
+#include "ThreadSafeBoundedQueue.hpp"
+#include "LatencyHistogram.hpp"
+
+using namespace arcana::virgil;
+
+/*
+ * Element moved through the queues.
+ */
+template <std::uint32_t Bytes>
+struct Payload {
+  std::uint64_t values[Bytes / sizeof(std::uint64_t)];
+};
+
+static constexpr std::uint64_t sentinel = ~std::uint64_t(0);
+
+/*
+ * The queue ThreadSafeSPSCLockFreeQueue is built on.
+ */
+template <typename T>
+class ReferenceQueue {
+  public:
+    void push (T value){
+      queue.enqueue(value);
+    }
+
+    bool waitPop (T& out){
+      queue.wait_dequeue(out);
+      return true;
+    }
+
+  private:
+    moodycamel::BlockingReaderWriterQueue<T> queue;
+};
+
+/*
+ * Configurations supported by each queue.
+ */
+template <typename Queue>
+struct QueueTraits {
+  static constexpr bool multipleProducers = true;
+  static constexpr bool multipleConsumers = true;
+};
+
+template <typename T>
+struct QueueTraits<ThreadSafeSPSCLockFreeQueue<T>> {
+  static constexpr bool multipleProducers = false;
+  static constexpr bool multipleConsumers = false;
+};
+
+template <typename T>
+struct QueueTraits<ReferenceQueue<T>> {
+  static constexpr bool multipleProducers = false;
+  static constexpr bool multipleConsumers = false;
+};
+
+struct Options {
+  std::vector<std::string> queues{"ThreadSafeMutexQueue", "ThreadSafeMutexQueueSleep", "ThreadSafeSpinLockQueue", "ThreadSafeLockFreeQueue", "ThreadSafeSPSCLockFreeQueue", "ThreadSafeBoundedQueue", "ReaderWriterQueue"};
+  std::vector<std::uint32_t> payloads{8, 16, 32, 64};
+  std::vector<std::string> configurations{"spsc", "mpsc", "spmc", "mpmc", "pingpong"};
+  std::uint64_t operations = 1000000;
+  std::uint64_t roundTrips = 100000;
+  std::uint32_t producers = 2;
+  std::uint32_t consumers = 2;
+  std::string format = "csv";
+  std::string output;
+};
+
+struct Result {
+  std::string queue;
+  std::string configuration;
+  std::uint32_t producers;
+  std::uint32_t consumers;
+  std::uint32_t payload;
+  std::uint64_t operations;
+  double seconds;
+  double cacheMissesPerOperation;
+  LatencyHistogram roundTrip;
+};
+
+/*
+ * Last-level cache misses of the process, including the threads it creates after start().
+ */
+class CacheMisses {
+  public:
+    CacheMisses (void){
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = 1;
+      attr.disabled = 1;
+      fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    void start (void){
+      if (fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+
+    /*
+     * Return the misses since start(), or a negative number if they cannot be counted.
+     */
+    double stop (void){
+      std::uint64_t misses = 0;
+      if (  (fd < 0)
+            || (ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) != 0)
+            || (::read(fd, &misses, sizeof(misses)) != sizeof(misses))
+         ){
+        return -1;
+      }
+
+      return static_cast<double>(misses);
+    }
+
+    ~CacheMisses (void){
+      if (fd >= 0){
+        close(fd);
+      }
+    }
+
+  private:
+    int fd = -1;
+};
+
+/*
+ * Move @operations payloads from @producers threads to @consumers threads.
+ */
+template <typename Queue, std::uint32_t Bytes>
+static bool measureThroughput (Result &r){
+  using T = Payload<Bytes>;
+  Queue queue;
+  std::atomic_bool go{false};
+  std::atomic<std::uint64_t> sum{0};
+
+  /*
+   * Create the consumers.
+   * Each of them stops at the first sentinel.
+   */
+  std::vector<std::thread> threads;
+  for (auto c = 0u; c < r.consumers; c++){
+    threads.emplace_back([&queue, &go, &sum](void){
+      while (!go.load(std::memory_order_acquire)){
+      }
+      std::uint64_t localSum = 0;
+      T p;
+      while (queue.waitPop(p)){
+        if (p.values[0] == sentinel){
+          break ;
+        }
+        localSum += p.values[0];
+      }
+      sum.fetch_add(localSum);
+    });
+  }
+
+  /*
+   * Create the producers.
+   */
+  std::vector<std::thread> producers;
+  for (auto i = 0u; i < r.producers; i++){
+    auto first = (r.operations * i) / r.producers;
+    auto last = (r.operations * (i + 1)) / r.producers;
+    producers.emplace_back([&queue, &go, first, last](void){
+      while (!go.load(std::memory_order_acquire)){
+      }
+      T p;
+      memset(&p, 0, sizeof(p));
+      for (auto v = first; v < last; v++){
+        p.values[0] = v;
+        queue.push(p);
+      }
+    });
+  }
+
+  /*
+   * Run.
+   */
+  CacheMisses misses;
+  misses.start();
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto &t : producers){
+    t.join();
+  }
+  T stop;
+  memset(&stop, 0, sizeof(stop));
+  stop.values[0] = sentinel;
+  for (auto c = 0u; c < r.consumers; c++){
+    queue.push(stop);
+  }
+  for (auto &t : threads){
+    t.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto m = misses.stop();
+
+  r.seconds = std::chrono::duration<double>(end - start).count();
+  r.cacheMissesPerOperation = (m < 0) ? m : (m / r.operations);
+
+  return sum.load() == (r.operations * (r.operations - 1)) / 2;
+}
+
+/*
+ * Bounce a payload between two threads through a pair of queues.
+ */
+template <typename Queue, std::uint32_t Bytes>
+static bool measureRoundTrip (Result &r){
+  using T = Payload<Bytes>;
+  Queue requests;
+  Queue replies;
+
+  std::thread echo{[&requests, &replies, &r](void){
+    T p;
+    for (std::uint64_t i = 0; i < r.operations; i++){
+      requests.waitPop(p);
+      replies.push(p);
+    }
+  }};
+
+  CacheMisses misses;
+  misses.start();
+  auto start = std::chrono::steady_clock::now();
+  T p;
+  memset(&p, 0, sizeof(p));
+  auto correct = true;
+  for (std::uint64_t i = 0; i < r.operations; i++){
+    auto sent = TimestampCounter::read();
+    p.values[0] = i;
+    requests.push(p);
+    replies.waitPop(p);
+    r.roundTrip.recordSince(sent);
+    correct &= (p.values[0] == i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto m = misses.stop();
+  echo.join();
+
+  r.seconds = std::chrono::duration<double>(end - start).count();
+  r.cacheMissesPerOperation = (m < 0) ? m : (m / r.operations);
+
+  return correct;
+}
+
+template <typename Queue, std::uint32_t Bytes>
+static bool benchmarkPayload (const std::string &name, const Options &o, std::vector<Result> &results){
+  for (auto &c : o.configurations){
+    Result r;
+    r.queue = name;
+    r.configuration = c;
+    r.payload = Bytes;
+    r.producers = ((c == "mpsc") || (c == "mpmc")) ? o.producers : 1;
+    r.consumers = ((c == "spmc") || (c == "mpmc")) ? o.consumers : 1;
+    if (  ((r.producers > 1) && (!QueueTraits<Queue>::multipleProducers))
+          || ((r.consumers > 1) && (!QueueTraits<Queue>::multipleConsumers))
+       ){
+      continue ;
+    }
+
+    bool correct;
+    if (c == "pingpong"){
+      r.operations = o.roundTrips;
+      correct = measureRoundTrip<Queue, Bytes>(r);
+    } else {
+      r.operations = o.operations;
+      correct = measureThroughput<Queue, Bytes>(r);
+    }
+    if (!correct){
+      std::cerr << "ERROR: " << name << " lost or corrupted payloads in the " << c << " configuration" << std::endl;
+      return false;
+    }
+    std::cerr << name << " " << c << " payload=" << Bytes << ": " << (r.operations / r.seconds) << " ops/s" << std::endl;
+    results.push_back(r);
+  }
+
+  return true;
+}
+
+template <template <typename> class Queue>
+static bool benchmarkQueue (const std::string &name, const Options &o, std::vector<Result> &results){
+  for (auto bytes : o.payloads){
+    auto correct = true;
+    switch (bytes){
+      case 8:
+        correct = benchmarkPayload<Queue<Payload<8>>, 8>(name, o, results);
+        break ;
+      case 16:
+        correct = benchmarkPayload<Queue<Payload<16>>, 16>(name, o, results);
+        break ;
+      case 32:
+        correct = benchmarkPayload<Queue<Payload<32>>, 32>(name, o, results);
+        break ;
+      case 64:
+        correct = benchmarkPayload<Queue<Payload<64>>, 64>(name, o, results);
+        break ;
+    }
+    if (!correct){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void printCSV (std::ostream &out, const std::vector<Result> &results){
+  out << "queue,configuration,producers,consumers,payload_bytes,operations,seconds,ops_per_second,rtt_p50_ns,rtt_p99_ns,rtt_p999_ns,llc_misses_per_op" << std::endl;
+  for (auto &r : results){
+    out << r.queue << "," << r.configuration << "," << r.producers << "," << r.consumers << "," << r.payload << "," << r.operations << "," << r.seconds << "," << (r.operations / r.seconds) << ",";
+    if (r.roundTrip.count() > 0){
+      out << r.roundTrip.percentile(50) << "," << r.roundTrip.percentile(99) << "," << r.roundTrip.percentile(99.9) << ",";
+    } else {
+      out << ",,,";
+    }
+    if (r.cacheMissesPerOperation >= 0){
+      out << r.cacheMissesPerOperation;
+    }
+    out << std::endl;
+  }
+
+  return ;
+}
+
+static void printJSON (std::ostream &out, const std::vector<Result> &results){
+  out << "[" << std::endl;
+  for (auto i = 0u; i < results.size(); i++){
+    auto &r = results[i];
+    out << "  {\"queue\": \"" << r.queue << "\", \"configuration\": \"" << r.configuration << "\", \"producers\": " << r.producers << ", \"consumers\": " << r.consumers << ", "
+        << "\"payload_bytes\": " << r.payload << ", \"operations\": " << r.operations << ", \"seconds\": " << r.seconds << ", \"ops_per_second\": " << (r.operations / r.seconds);
+    if (r.roundTrip.count() > 0){
+      out << ", \"rtt_p50_ns\": " << r.roundTrip.percentile(50) << ", \"rtt_p99_ns\": " << r.roundTrip.percentile(99) << ", \"rtt_p999_ns\": " << r.roundTrip.percentile(99.9);
+    }
+    if (r.cacheMissesPerOperation >= 0){
+      out << ", \"llc_misses_per_op\": " << r.cacheMissesPerOperation;
+    }
+    out << "}" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+  }
+  out << "]" << std::endl;
+
+  return ;
+}
+
+static std::vector<std::string> split (const std::string &s){
+  std::vector<std::string> elements;
+  std::stringstream stream{s};
+  std::string e;
+  while (std::getline(stream, e, ',')){
+    elements.push_back(e);
+  }
+
+  return elements;
+}
+
+static void printUsage (const char *program){
+  std::cerr << "USAGE: " << program << " [OPTION=VALUE]..." << std::endl
+            << "  --queues=NAME,...          queues to run (default: all)" << std::endl
+            << "  --payloads=BYTES,...       8, 16, 32, 64 (default: all)" << std::endl
+            << "  --configurations=NAME,...  spsc, mpsc, spmc, mpmc, pingpong (default: all)" << std::endl
+            << "  --operations=N             payloads moved per configuration (default: 1000000)" << std::endl
+            << "  --roundtrips=N             round trips of the ping-pong (default: 100000)" << std::endl
+            << "  --producers=N              producers of mpsc and mpmc (default: 2)" << std::endl
+            << "  --consumers=N              consumers of spmc and mpmc (default: 2)" << std::endl
+            << "  --format=csv|json          output format (default: csv)" << std::endl
+            << "  --output=FILE              output file (default: standard output)" << std::endl;
+
+  return ;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  Options o;
+  for (auto i = 1; i < argc; i++){
+    std::string arg{argv[i]};
+    auto equal = arg.find('=');
+    if (  (arg.compare(0, 2, "--") != 0)
+          || (equal == std::string::npos)
+       ){
+      printUsage(argv[0]);
+      return 1;
+    }
+    auto option = arg.substr(2, equal - 2);
+    auto value = arg.substr(equal + 1);
+    auto ok = true;
+    if (option == "queues"){
+      o.queues = split(value);
+    } else if (option == "payloads"){
+      o.payloads.clear();
+      for (auto &e : split(value)){
+        auto bytes = std::stoul(e);
+        ok &= (bytes == 8) || (bytes == 16) || (bytes == 32) || (bytes == 64);
+        o.payloads.push_back(bytes);
+      }
+    } else if (option == "configurations"){
+      o.configurations = split(value);
+      for (auto &c : o.configurations){
+        ok &= (c == "spsc") || (c == "mpsc") || (c == "spmc") || (c == "mpmc") || (c == "pingpong");
+      }
+    } else if (option == "operations"){
+      o.operations = std::max(std::stoull(value), 1ull);
+    } else if (option == "roundtrips"){
+      o.roundTrips = std::max(std::stoull(value), 1ull);
+    } else if (option == "producers"){
+      o.producers = std::max(std::stoul(value), 1ul);
+    } else if (option == "consumers"){
+      o.consumers = std::max(std::stoul(value), 1ul);
+    } else if (option == "format"){
+      o.format = value;
+      ok = (value == "csv") || (value == "json");
+    } else if (option == "output"){
+      o.output = value;
+    } else {
+      ok = false;
+    }
+    if (!ok){
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  /*
+   * Run the benchmarks.
+   */
+  TimestampCounter::ticksPerSecond();
+  std::vector<Result> results;
+  for (auto &q : o.queues){
+    auto correct = true;
+    if (q == "ThreadSafeMutexQueue"){
+      correct = benchmarkQueue<ThreadSafeMutexQueue>(q, o, results);
+    } else if (q == "ThreadSafeMutexQueueSleep"){
+      correct = benchmarkQueue<ThreadSafeMutexQueueSleep>(q, o, results);
+    } else if (q == "ThreadSafeSpinLockQueue"){
+      correct = benchmarkQueue<ThreadSafeSpinLockQueue>(q, o, results);
+    } else if (q == "ThreadSafeLockFreeQueue"){
+      correct = benchmarkQueue<ThreadSafeLockFreeQueue>(q, o, results);
+    } else if (q == "ThreadSafeSPSCLockFreeQueue"){
+      correct = benchmarkQueue<ThreadSafeSPSCLockFreeQueue>(q, o, results);
+    } else if (q == "ThreadSafeBoundedQueue"){
+      correct = benchmarkQueue<ThreadSafeBoundedQueue>(q, o, results);
+    } else if (q == "ReaderWriterQueue"){
+      correct = benchmarkQueue<ReferenceQueue>(q, o, results);
+    } else {
+      std::cerr << "ERROR: unknown queue \"" << q << "\"" << std::endl;
+      return 1;
+    }
+    if (!correct){
+      return 1;
+    }
+  }
+
+  /*
+   * Print the results.
+   */
+  std::ofstream file;
+  if (!o.output.empty()){
+    file.open(o.output);
+  }
+  auto &out = o.output.empty() ? std::cout : file;
+  if (o.format == "csv"){
+    printCSV(out, results);
+  } else {
+    printJSON(out, results);
+  }
+
+  return 0;
+}
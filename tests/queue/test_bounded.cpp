@@ -0,0 +1,228 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ThreadSafeMutexQueue.hpp"
+#include "ThreadSafeMutexQueueSleep.hpp"
+#include "ThreadSafeSpinLockQueue.hpp"
+#include "ThreadSafeLockFreeQueue.hpp"
+#include "ThreadSafeSPSCLockFreeQueue.hpp"
+#include "ThreadSafeBoundedQueue.hpp"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define CAPACITY 8
+
+/*
+ * Check that values pushed by several producers to a small bounded queue reach several consumers exactly once and in order, and that the queue never holds more values than its capacity.
+ */
+static bool testBoundedQueue (int64_t pushes){
+  arcana::virgil::ThreadSafeBoundedQueue<int64_t> queue{CAPACITY};
+  std::vector<std::thread> threads;
+
+  /*
+   * Each producer pushes the values producer, producer + PRODUCERS, producer + 2*PRODUCERS, ...
+   */
+  for (auto p = 0; p < PRODUCERS; p++){
+    threads.emplace_back([&queue, p, pushes](void){
+      std::vector<int64_t> batch;
+      for (int64_t v = p; v < pushes; v += PRODUCERS){
+        if ((v % 5) != 0){
+          queue.push(v);
+          continue ;
+        }
+
+        /*
+         * Push batches larger than the capacity from time to time.
+         */
+        batch.push_back(v);
+        if (batch.size() == (CAPACITY + 3)){
+          queue.pushBulk(batch.data(), batch.data() + batch.size());
+          batch.clear();
+        }
+      }
+      queue.pushBulk(batch.data(), batch.data() + batch.size());
+    });
+  }
+
+  /*
+   * Consumers stop at the first negative value.
+   */
+  std::atomic<int64_t> sum{0};
+  std::atomic_bool ordered{true};
+  std::atomic_bool bounded{true};
+  for (auto c = 0; c < CONSUMERS; c++){
+    threads.emplace_back([&queue, &sum, &ordered, &bounded](void){
+      int64_t last[PRODUCERS];
+      for (auto p = 0; p < PRODUCERS; p++){
+        last[p] = -1;
+      }
+      int64_t localSum = 0;
+      int64_t v;
+      while (queue.waitPop(v) && (v >= 0)){
+        localSum += v;
+
+        /*
+         * Batched values are pushed later than the single ones that follow them.
+         */
+        auto p = v % PRODUCERS;
+        if ((v % 5) != 0){
+          if (v <= last[p]){
+            ordered = false;
+          }
+          last[p] = v;
+        }
+        if (queue.size() > CAPACITY){
+          bounded = false;
+        }
+      }
+      sum += localSum;
+    });
+  }
+
+  /*
+   * Wait for the producers and then stop the consumers.
+   */
+  for (auto p = 0; p < PRODUCERS; p++){
+    threads[p].join();
+  }
+  for (auto c = 0; c < CONSUMERS; c++){
+    queue.push(-1);
+  }
+  for (auto c = 0; c < CONSUMERS; c++){
+    threads[PRODUCERS + c].join();
+  }
+
+  if (sum != (pushes * (pushes - 1)) / 2){
+    std::cerr << "ERROR: values have been lost or duplicated" << std::endl;
+    return false;
+  }
+  if (!ordered){
+    std::cerr << "ERROR: the values of a producer have been popped out of order" << std::endl;
+    return false;
+  }
+  if (!bounded){
+    std::cerr << "ERROR: the queue exceeded its capacity" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/*
+ * Check that waitPush keeps the queue within its bound, and that invalidating the queue wakes up a blocked producer.
+ */
+template <class Queue>
+static bool testWaitPush (const char *name, int64_t pushes){
+  Queue queue;
+  std::thread producer{[&queue, pushes](void){
+    for (int64_t v = 0; v < pushes; v++){
+      queue.waitPush(v, 4);
+    }
+  }};
+  int64_t sum = 0;
+  for (int64_t i = 0; i < pushes; i++){
+    int64_t v;
+    queue.waitPop(v);
+    sum += v;
+    if (queue.size() > 4){
+      std::cerr << "ERROR: " << name << ": waitPush exceeded its bound" << std::endl;
+      return false;
+    }
+  }
+  producer.join();
+  if (sum != (pushes * (pushes - 1)) / 2){
+    std::cerr << "ERROR: " << name << ": values have been lost or duplicated" << std::endl;
+    return false;
+  }
+
+  /*
+   * Block a producer and then invalidate the queue.
+   */
+  for (int64_t v = 0; v < 4; v++){
+    queue.push(v);
+  }
+  std::atomic_bool pushed{true};
+  std::thread blocked{[&queue, &pushed](void){
+    pushed = queue.waitPush(4, 4);
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  queue.invalidate();
+  blocked.join();
+  if (pushed){
+    std::cerr << "ERROR: " << name << ": waitPush succeeded on a full invalidated queue" << std::endl;
+    return false;
+  }
+  std::cout << name << ": OK" << std::endl;
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " NUMBER_OF_PUSHES" << std::endl;
+    return 1;
+  }
+  auto pushes = atoll(argv[1]);
+
+  /*
+   * A bounded queue accepts values up to its capacity.
+   */
+  arcana::virgil::ThreadSafeBoundedQueue<int64_t> small{4};
+  for (int64_t v = 0; v < 4; v++){
+    if (!small.tryPush(v)){
+      std::cerr << "ERROR: tryPush failed on a queue with room" << std::endl;
+      return 1;
+    }
+  }
+  int64_t v;
+  if (  (small.capacity() != 4)
+        || small.tryPush(4)
+        || !small.tryPop(v)
+        || (v != 0)
+        || !small.tryPush(4)
+     ){
+    std::cerr << "ERROR: tryPush ignored the capacity of the queue" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Producers block while the queue is full.
+   */
+  if (!testBoundedQueue(pushes)){
+    return 1;
+  }
+
+  /*
+   * Every queue bounds waitPush.
+   */
+  auto waitPushes = pushes / 10;
+  if (  !testWaitPush<arcana::virgil::ThreadSafeMutexQueue<int64_t>>("ThreadSafeMutexQueue", waitPushes)
+        || !testWaitPush<arcana::virgil::ThreadSafeMutexQueueSleep<int64_t>>("ThreadSafeMutexQueueSleep", waitPushes)
+        || !testWaitPush<arcana::virgil::ThreadSafeSpinLockQueue<int64_t>>("ThreadSafeSpinLockQueue", waitPushes)
+        || !testWaitPush<arcana::virgil::ThreadSafeLockFreeQueue<int64_t>>("ThreadSafeLockFreeQueue", waitPushes)
+        || !testWaitPush<arcana::virgil::ThreadSafeSPSCLockFreeQueue<int64_t>>("ThreadSafeSPSCLockFreeQueue", waitPushes)
+        || !testWaitPush<arcana::virgil::ThreadSafeBoundedQueue<int64_t>>("ThreadSafeBoundedQueue", waitPushes)
+     ){
+    return 1;
+  }
+
+  /*
+   * Invalidating a full bounded queue wakes up its producers.
+   */
+  arcana::virgil::ThreadSafeBoundedQueue<int64_t> full{2};
+  full.push(0);
+  full.push(1);
+  std::thread producer{[&full](void){
+    full.push(2);
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  full.invalidate();
+  producer.join();
+
+  return 0;
+}
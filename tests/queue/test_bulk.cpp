@@ -0,0 +1,131 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ThreadSafeMutexQueue.hpp"
+#include "ThreadSafeMutexQueueSleep.hpp"
+#include "ThreadSafeSpinLockQueue.hpp"
+#include "ThreadSafeLockFreeQueue.hpp"
+#include "ThreadSafeSPSCLockFreeQueue.hpp"
+
+#define BATCH 32
+
+/*
+ * Move the values 0..pushes-1 from a producer that pushes batches to a consumer that pops batches.
+ */
+static bool testQueue (const char *name, arcana::virgil::ThreadSafeQueue<int64_t> &queue, int64_t pushes){
+  std::thread producer{[&queue, pushes](void){
+    int64_t batch[BATCH];
+    for (int64_t i = 0; i < pushes; i += BATCH){
+      auto n = std::min<int64_t>(BATCH, pushes - i);
+      for (auto j = 0; j < n; j++){
+        batch[j] = i + j;
+      }
+      queue.pushBulk(batch, batch + n);
+    }
+  }};
+
+  /*
+   * Pop in batches and check the FIFO order.
+   */
+  int64_t next = 0;
+  int64_t batches = 0;
+  auto correct = true;
+  while (next < pushes){
+    int64_t batch[BATCH];
+    auto n = queue.waitPopBulk(batch, 1, BATCH);
+    for (auto j = 0u; j < n; j++){
+      correct &= (batch[j] == next);
+      next++;
+    }
+    batches++;
+  }
+  producer.join();
+
+  /*
+   * Nothing is left.
+   */
+  int64_t leftover;
+  correct &= (queue.tryPopBulk(&leftover, 1) == 0);
+  std::cout << name << ": " << pushes << " values in " << batches << " batches" << std::endl;
+  if (!correct){
+    std::cerr << "ERROR: " << name << " returned values out of order" << std::endl;
+  }
+
+  return correct;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " NUMBER_OF_PUSHES" << std::endl;
+    return 1;
+  }
+  auto pushes = atoll(argv[1]);
+
+  /*
+   * Test all queues.
+   */
+  arcana::virgil::ThreadSafeMutexQueue<int64_t> mutexQueue;
+  arcana::virgil::ThreadSafeMutexQueueSleep<int64_t> sleepQueue;
+  arcana::virgil::ThreadSafeSpinLockQueue<int64_t> spinQueue;
+  arcana::virgil::ThreadSafeLockFreeQueue<int64_t> lockFreeQueue{64};
+  arcana::virgil::ThreadSafeSPSCLockFreeQueue<int64_t> spscQueue;
+  if (  !testQueue("ThreadSafeMutexQueue", mutexQueue, pushes)
+        || !testQueue("ThreadSafeMutexQueueSleep", sleepQueue, pushes)
+        || !testQueue("ThreadSafeSpinLockQueue", spinQueue, pushes)
+        || !testQueue("ThreadSafeLockFreeQueue", lockFreeQueue, pushes)
+        || !testQueue("ThreadSafeSPSCLockFreeQueue", spscQueue, pushes)
+     ){
+    return 1;
+  }
+
+  /*
+   * A consumer that needs several values waits for all of them.
+   */
+  int64_t values[4] = {1, 2, 3, 4};
+  int64_t out[8];
+  mutexQueue.pushBulk(values, values + 2);
+  std::thread late{[&mutexQueue, &values](void){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    mutexQueue.pushBulk(values + 2, values + 4);
+  }};
+  auto n = mutexQueue.waitPopBulk(out, 3, 8);
+  late.join();
+  if (n < 3){
+    std::cerr << "ERROR: waitPopBulk returned " << n << " values instead of at least 3" << std::endl;
+    return 1;
+  }
+
+  /*
+   * The consumer of a single-producer queue sleeps until the values it needs arrive, and invalidating the queue wakes it up.
+   */
+  spscQueue.pushBulk(values, values + 2);
+  std::thread lateProducer{[&spscQueue, &values](void){
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    spscQueue.pushBulk(values + 2, values + 4);
+  }};
+  n = spscQueue.waitPopBulk(out, 3, 8);
+  lateProducer.join();
+  if (n != 4){
+    std::cerr << "ERROR: ThreadSafeSPSCLockFreeQueue: waitPopBulk returned " << n << " values instead of 4" << std::endl;
+    return 1;
+  }
+  std::atomic_bool popped{true};
+  std::thread consumer{[&spscQueue, &popped](void){
+    int64_t v;
+    popped = spscQueue.waitPop(v);
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  spscQueue.invalidate();
+  consumer.join();
+  if (popped){
+    std::cerr << "ERROR: ThreadSafeSPSCLockFreeQueue: waitPop succeeded on an empty invalidated queue" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
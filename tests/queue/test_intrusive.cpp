@@ -0,0 +1,138 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "IntrusiveQueue.hpp"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+
+struct Item : public arcana::virgil::IntrusiveQueueNode {
+  int64_t value;
+};
+
+/*
+ * Check that the items pushed by several producers reach the consumers exactly once, and that the items of a producer are popped in order.
+ * Each producer reuses its items as soon as the consumers are done with them.
+ */
+template <class Queue>
+static bool testQueue (const char *name, std::uint32_t consumers, int64_t pushes){
+  Queue queue;
+  Queue recycled[PRODUCERS];
+  Item items[PRODUCERS][16];
+  std::vector<std::thread> threads;
+
+  /*
+   * Each producer pushes the values producer, producer + PRODUCERS, producer + 2*PRODUCERS, ...
+   */
+  for (auto p = 0; p < PRODUCERS; p++){
+    threads.emplace_back([&queue, &recycled, &items, p, pushes](void){
+      std::uint32_t fresh = 0;
+      for (int64_t v = p; v < pushes; v += PRODUCERS){
+        Item *item;
+        if (fresh < 16){
+          item = &items[p][fresh++];
+        } else {
+          recycled[p].waitPop(item);
+        }
+        item->value = v;
+        queue.push(item);
+      }
+    });
+  }
+
+  /*
+   * Consumers stop at the first negative value.
+   */
+  std::atomic<int64_t> sum{0};
+  std::atomic_bool ordered{true};
+  for (auto c = 0; c < consumers; c++){
+    threads.emplace_back([&queue, &recycled, &sum, &ordered](void){
+      int64_t last[PRODUCERS];
+      for (auto p = 0; p < PRODUCERS; p++){
+        last[p] = -1;
+      }
+      int64_t localSum = 0;
+      Item *item;
+      while (queue.waitPop(item) && (item->value >= 0)){
+        auto v = item->value;
+        auto p = v % PRODUCERS;
+        if (v <= last[p]){
+          ordered = false;
+        }
+        last[p] = v;
+        localSum += v;
+        recycled[p].push(item);
+      }
+      sum += localSum;
+    });
+  }
+
+  /*
+   * Wait for the producers and then stop the consumers.
+   */
+  for (auto p = 0; p < PRODUCERS; p++){
+    threads[p].join();
+  }
+  std::vector<Item> stops(consumers);
+  for (auto &stop : stops){
+    stop.value = -1;
+    queue.push(&stop);
+  }
+  for (auto c = 0; c < consumers; c++){
+    threads[PRODUCERS + c].join();
+  }
+
+  if (sum != (pushes * (pushes - 1)) / 2){
+    std::cerr << "ERROR: " << name << ": items have been lost or duplicated" << std::endl;
+    return false;
+  }
+  if (!ordered){
+    std::cerr << "ERROR: " << name << ": the items of a producer have been popped out of order" << std::endl;
+    return false;
+  }
+  if (!queue.empty()){
+    std::cerr << "ERROR: " << name << ": the queue is not empty" << std::endl;
+    return false;
+  }
+
+  /*
+   * Invalidating the queue wakes up its consumers.
+   */
+  std::thread consumer{[&queue, name](void){
+    Item *item;
+    if (queue.waitPop(item)){
+      std::cerr << "ERROR: " << name << ": popped from an empty queue" << std::endl;
+      abort();
+    }
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  queue.invalidate();
+  consumer.join();
+  std::cout << name << ": OK" << std::endl;
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " NUMBER_OF_PUSHES" << std::endl;
+    return 1;
+  }
+  auto pushes = atoll(argv[1]);
+
+  /*
+   * An item cannot be in two queues at once, so the recycling queues of the producers get the items only after the consumer is done with them.
+   */
+  if (  !testQueue<arcana::virgil::IntrusiveMPSCQueue<Item>>("IntrusiveMPSCQueue", 1, pushes)
+        || !testQueue<arcana::virgil::IntrusiveMPMCQueue<Item>>("IntrusiveMPMCQueue", CONSUMERS, pushes)
+     ){
+    return 1;
+  }
+
+  return 0;
+}
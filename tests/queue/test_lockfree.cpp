@@ -0,0 +1,146 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "ThreadSafeLockFreeQueue.hpp"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+
+/*
+ * Check that values pushed by several producers reach several consumers exactly once, and that the values of a producer are popped in order.
+ */
+static bool testQueue (arcana::virgil::ThreadSafeLockFreeQueue<int64_t> &queue, int64_t pushes){
+  std::vector<std::thread> threads;
+
+  /*
+   * Each producer pushes the values producer, producer + PRODUCERS, producer + 2*PRODUCERS, ...
+   */
+  for (auto p = 0; p < PRODUCERS; p++){
+    threads.emplace_back([&queue, p, pushes](void){
+      for (int64_t v = p; v < pushes; v += PRODUCERS){
+        if ((v % 7) == 0){
+          int64_t batch[3] = {v, -1, -1};
+          queue.pushBulk(batch, batch + 1);
+        } else {
+          queue.push(v);
+        }
+      }
+    });
+  }
+
+  /*
+   * Consumers stop at the first negative value.
+   */
+  std::atomic<int64_t> sum{0};
+  std::atomic_bool ordered{true};
+  for (auto c = 0; c < CONSUMERS; c++){
+    threads.emplace_back([&queue, &sum, &ordered](void){
+      int64_t last[PRODUCERS];
+      for (auto p = 0; p < PRODUCERS; p++){
+        last[p] = -1;
+      }
+      int64_t localSum = 0;
+      int64_t v;
+      while (queue.waitPop(v) && (v >= 0)){
+        auto p = v % PRODUCERS;
+        if (v <= last[p]){
+          ordered = false;
+        }
+        last[p] = v;
+        localSum += v;
+      }
+      sum += localSum;
+    });
+  }
+
+  /*
+   * Wait for the producers and then stop the consumers.
+   */
+  for (auto p = 0; p < PRODUCERS; p++){
+    threads[p].join();
+  }
+  for (auto c = 0; c < CONSUMERS; c++){
+    queue.push(-1);
+  }
+  for (auto c = 0; c < CONSUMERS; c++){
+    threads[PRODUCERS + c].join();
+  }
+
+  if (sum != (pushes * (pushes - 1)) / 2){
+    std::cerr << "ERROR: values have been lost or duplicated" << std::endl;
+    return false;
+  }
+  if (!ordered){
+    std::cerr << "ERROR: the values of a producer have been popped out of order" << std::endl;
+    return false;
+  }
+  if (!queue.empty()){
+    std::cerr << "ERROR: the queue is not empty" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " NUMBER_OF_PUSHES" << std::endl;
+    return 1;
+  }
+  auto pushes = atoll(argv[1]);
+
+  /*
+   * A large queue never spills, while a tiny one spills to its overflow buffer most of the time.
+   */
+  arcana::virgil::ThreadSafeLockFreeQueue<int64_t> large;
+  arcana::virgil::ThreadSafeLockFreeQueue<int64_t> tiny{2};
+  if (  !testQueue(large, pushes)
+        || !testQueue(tiny, pushes)
+     ){
+    return 1;
+  }
+
+  /*
+   * waitPush blocks while the queue holds too many values.
+   */
+  arcana::virgil::ThreadSafeLockFreeQueue<int64_t> bounded{8};
+  std::thread producer{[&bounded, pushes](void){
+    for (int64_t v = 0; v < pushes; v++){
+      bounded.waitPush(v, 4);
+    }
+  }};
+  int64_t sum = 0;
+  for (int64_t i = 0; i < pushes; i++){
+    int64_t v;
+    bounded.waitPop(v);
+    sum += v;
+    if (bounded.size() > 4){
+      std::cerr << "ERROR: waitPush exceeded its bound" << std::endl;
+      return 1;
+    }
+  }
+  producer.join();
+  std::cout << sum << std::endl;
+
+  /*
+   * Invalidating the queue wakes up its consumers.
+   */
+  arcana::virgil::ThreadSafeLockFreeQueue<int64_t> invalidated;
+  std::thread consumer{[&invalidated](void){
+    int64_t v;
+    if (invalidated.waitPop(v)){
+      std::cerr << "ERROR: popped from an empty queue" << std::endl;
+      abort();
+    }
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  invalidated.invalidate();
+  consumer.join();
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <memory>
+
+#include "RingBuffer.hpp"
+#include "ThreadSafeMutexQueue.hpp"
+#include "ThreadSafeSpinLockQueue.hpp"
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 2){
+    std::cerr << "USAGE: " << argv[0] << " NUMBER_OF_PUSHES" << std::endl;
+    return 1;
+  }
+  auto pushes = atoll(argv[1]);
+
+  /*
+   * Check the FIFO order while the buffer wraps around and grows.
+   */
+  arcana::virgil::RingBuffer<std::unique_ptr<int64_t>> buffer;
+  int64_t next = 0;
+  for (auto i = 0; i < pushes; i++){
+    buffer.push(std::make_unique<int64_t>(i));
+    if ((i % 3) == 0){
+      if (*buffer.front() != next){
+        std::cerr << "ERROR: popped " << *buffer.front() << " instead of " << next << std::endl;
+        return 1;
+      }
+      buffer.pop();
+      next++;
+    }
+  }
+  if (buffer.size() != (pushes - next)){
+    std::cerr << "ERROR: wrong size" << std::endl;
+    return 1;
+  }
+  while (!buffer.empty()){
+    if (*buffer.front() != next){
+      std::cerr << "ERROR: popped " << *buffer.front() << " instead of " << next << std::endl;
+      return 1;
+    }
+    buffer.pop();
+    next++;
+  }
+
+  /*
+   * A preallocated buffer does not grow while its size stays within the preallocation.
+   */
+  arcana::virgil::RingBuffer<int64_t> preallocated{1000, true};
+  auto capacity = preallocated.capacity();
+  for (auto i = 0; i < pushes; i++){
+    preallocated.push(i);
+    if (preallocated.size() == 1000){
+      while (!preallocated.empty()){
+        preallocated.pop();
+      }
+    }
+  }
+  if (  (capacity < 1000)
+        || (preallocated.capacity() != capacity)
+     ){
+    std::cerr << "ERROR: the preallocated buffer grew" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Queues built on top of the buffer.
+   */
+  arcana::virgil::ThreadSafeMutexQueue<int64_t> mutexQueue{1 << 20, true};
+  arcana::virgil::ThreadSafeSpinLockQueue<int64_t> spinQueue{16};
+  int64_t sum = 0;
+  for (auto i = 0; i < pushes; i++){
+    mutexQueue.push(i);
+    spinQueue.push(i);
+  }
+  for (auto i = 0; i < pushes; i++){
+    int64_t a, b;
+    mutexQueue.waitPop(a);
+    spinQueue.waitPop(b);
+    if (a != b){
+      std::cerr << "ERROR: the queues disagree" << std::endl;
+      return 1;
+    }
+    sum += a;
+  }
+  std::cout << sum << std::endl;
+
+  return 0;
+}
@@ -4,7 +4,7 @@
 #include "ThreadPool.hpp"
 #include "ThreadSafeLockFreeQueue.hpp"
 
-void pushFunction (int64_t pushes, MARC::ThreadSafeQueue<int64_t> *queue){
+void pushFunction (int64_t pushes, arcana::virgil::ThreadSafeQueue<int64_t> *queue){
   for (auto i=0; i < pushes; i++){
     queue->push(i);
   }
@@ -12,7 +12,7 @@ void pushFunction (int64_t pushes, MARC::ThreadSafeQueue<int64_t> *queue){
   return ;
 }
 
-void pullFunction (int64_t pushes, MARC::ThreadSafeQueue<int64_t> *queue){
+void pullFunction (int64_t pushes, arcana::virgil::ThreadSafeQueue<int64_t> *queue){
   int64_t finalSum = 0;
   for (auto i=0; i < pushes; i++){
     int64_t tmpValue;
@@ -38,17 +38,17 @@ int main (int argc, char *argv[]){
   /*
    * Create a thread pool.
    */
-  MARC::ThreadPool pool(2);
+  arcana::virgil::ThreadPool pool{false, 2};
   
   /*
    * Create the queue.
    */
-  MARC::ThreadSafeLockFreeQueue<int64_t> queue{};
+  arcana::virgil::ThreadSafeLockFreeQueue<int64_t> queue{};
 
   /*
    * Work
    */
-  std::vector<MARC::TaskFuture<void>> results;
+  std::vector<arcana::virgil::TaskFuture<void>> results;
   results.push_back(pool.submit(pushFunction, pushes, &queue));
   results.push_back(pool.submit(pullFunction, pushes, &queue));
 
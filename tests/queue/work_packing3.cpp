@@ -10,7 +10,7 @@ typedef struct {
   int64_t values[PACKAGE_LENGTH];
 } package_t;
 
-void pushFunction (int64_t pushes, MARC::ThreadSafeQueue<package_t> *queue){
+void pushFunction (int64_t pushes, arcana::virgil::ThreadSafeQueue<package_t> *queue){
   auto packageIndex = 0;
 
   package_t package;
@@ -30,7 +30,7 @@ void pushFunction (int64_t pushes, MARC::ThreadSafeQueue<package_t> *queue){
   return ;
 }
 
-void pullFunction (int64_t pushes, MARC::ThreadSafeQueue<package_t> *queue){
+void pullFunction (int64_t pushes, arcana::virgil::ThreadSafeQueue<package_t> *queue){
   int64_t finalSum = 0;
   for (auto i=0; i < pushes; i += PACKAGE_LENGTH){
     package_t tmpValues;
@@ -58,17 +58,17 @@ int main (int argc, char *argv[]){
   /*
    * Create a thread pool.
    */
-  MARC::ThreadPool pool(2);
+  arcana::virgil::ThreadPool pool{false, 2};
   
   /*
    * Create the queue.
    */
-  MARC::ThreadSafeLockFreeQueue<package_t> queue;
+  arcana::virgil::ThreadSafeLockFreeQueue<package_t> queue;
 
   /*
    * Work
    */
-  std::vector<MARC::TaskFuture<void>> results;
+  std::vector<arcana::virgil::TaskFuture<void>> results;
   results.push_back(pool.submit(pushFunction, pushes, &queue));
   results.push_back(pool.submit(pullFunction, pushes, &queue));
 
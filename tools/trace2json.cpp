@@ -0,0 +1,146 @@
+/*
+ * Copyright 2021 Simone Campanoni
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * Convert a trace generated by arcana::virgil::Tracer to the Chrome trace format.
+ * The output can be opened by chrome://tracing and by https://ui.perfetto.dev
+ */
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "ThreadPoolTracer.hpp"
+
+using namespace arcana::virgil;
+
+int main (int argc, char *argv[]){
+
+  /*
+   * Fetch the inputs.
+   */
+  if (argc < 3){
+    std::cerr << "USAGE: " << argv[0] << " TRACE_FILE JSON_FILE" << std::endl;
+    return 1;
+  }
+  auto in = fopen(argv[1], "rb");
+  if (in == nullptr){
+    std::cerr << "ERROR: cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  /*
+   * Read the header.
+   */
+  TraceFileHeader header;
+  if (  (fread(&header, sizeof(header), 1, in) != 1)
+        || (memcmp(header.magic, "VIRGILT", 8) != 0)
+        || (header.eventSize != sizeof(TraceEvent))
+     ){
+    std::cerr << "ERROR: " << argv[1] << " is not a VIRGIL trace" << std::endl;
+    return 1;
+  }
+
+  /*
+   * Read the events.
+   */
+  std::vector<TraceEvent> events;
+  TraceEvent e;
+  auto completed = false;
+  while (fread(&e, sizeof(e), 1, in) == 1){
+    if (e.type == TRACE_END){
+      completed = true;
+      break ;
+    }
+    events.push_back(e);
+  }
+  if (!completed){
+    std::cerr << "WARNING: the trace has been truncated" << std::endl;
+  }
+
+  /*
+   * Read the threads.
+   */
+  TraceFileTrailer trailer{0, 0};
+  std::vector<TraceThreadRecord> threads;
+  if (  completed
+        && (fread(&trailer, sizeof(trailer), 1, in) == 1)
+     ){
+    threads.resize(trailer.threads);
+    auto n = fread(threads.data(), sizeof(TraceThreadRecord), threads.size(), in);
+    threads.resize(n);
+  }
+  fclose(in);
+  if (trailer.droppedEvents > 0){
+    std::cerr << "WARNING: " << trailer.droppedEvents << " events have been dropped while tracing" << std::endl;
+  }
+
+  /*
+   * Sort the events by time; the trace stores them in the order buffers have been drained.
+   */
+  std::stable_sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b){ return a.timestamp < b.timestamp; });
+  auto start = events.empty() ? 0 : events.front().timestamp;
+  auto ticksPerMicrosecond = header.ticksPerSecond / 1e6;
+
+  /*
+   * Write the JSON file.
+   */
+  auto out = fopen(argv[2], "w");
+  if (out == nullptr){
+    std::cerr << "ERROR: cannot create " << argv[2] << std::endl;
+    return 1;
+  }
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  auto first = true;
+  auto separator = [&first, out](void){
+    if (!first){
+      fprintf(out, ",\n");
+    }
+    first = false;
+  };
+  for (auto &t : threads){
+    char name[17];
+    memcpy(name, t.name, 16);
+    name[16] = '\0';
+    separator();
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", t.thread, name);
+  }
+  for (auto &ev : events){
+    auto ts = static_cast<double>(ev.timestamp - start) / ticksPerMicrosecond;
+    separator();
+    switch (ev.type){
+      case TRACE_SUBMIT:
+        fprintf(out, "{\"name\":\"submit\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"task\":\"0x%lx\"}},\n", ts, ev.thread, (unsigned long)ev.task);
+        fprintf(out, "{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"s\",\"id\":\"0x%lx\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", (unsigned long)ev.task, ts, ev.thread);
+        break ;
+      case TRACE_DEQUEUE:
+        fprintf(out, "{\"name\":\"dequeue\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"task\":\"0x%lx\"}}", ts, ev.thread, (unsigned long)ev.task);
+        break ;
+      case TRACE_EXECUTE_BEGIN:
+        fprintf(out, "{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"f\",\"bp\":\"e\",\"id\":\"0x%lx\",\"ts\":%.3f,\"pid\":1,\"tid\":%u},\n", (unsigned long)ev.task, ts, ev.thread);
+        fprintf(out, "{\"name\":\"execute\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"task\":\"0x%lx\"}}", ts, ev.thread, (unsigned long)ev.task);
+        break ;
+      case TRACE_EXECUTE_END:
+        fprintf(out, "{\"name\":\"execute\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, ev.thread);
+        break ;
+      default:
+        fprintf(out, "{\"name\":\"unknown\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", ts, ev.thread);
+        break ;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+
+  std::cout << events.size() << " events of " << threads.size() << " threads converted" << std::endl;
+
+  return 0;
+}